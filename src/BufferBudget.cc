@@ -0,0 +1,250 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "BufferBudget.h"
+
+#include <algorithm>
+
+#include "Conn.h"
+#include "Net.h"
+#include "NetVar.h"
+#include "util.h"
+
+#include "3rdparty/doctest.h"
+
+BufferBudget buffer_budget;
+
+void BufferHolder::SetBuffered(uint64_t bytes)
+	{
+	if ( bytes == buffered )
+		return;
+
+	if ( ! buffered )
+		{
+		buffer_conn = BufferConn();
+		buffered_since = network_time;
+		}
+
+	uint64_t old_bytes = buffered;
+	buffered = bytes;
+	buffer_budget.Update(this, old_bytes, bytes);
+
+	if ( ! buffered )
+		buffer_conn = nullptr;
+	}
+
+void BufferBudget::Update(BufferHolder* h, uint64_t old_bytes, uint64_t new_bytes)
+	{
+	// Unsigned arithmetic wraps around correctly for decreases.
+	total += new_bytes - old_bytes;
+	by_type[h->buffer_type] += new_bytes - old_bytes;
+
+	if ( ! h->buffer_conn )
+		return;
+
+	auto it = conns.find(h->buffer_conn);
+
+	if ( it == conns.end() )
+		it = conns.emplace(h->buffer_conn, ConnBuffers()).first;
+
+	ConnBuffers& cb = it->second;
+	cb.bytes += new_bytes - old_bytes;
+
+	if ( ! old_bytes )
+		cb.holders.push_back(h);
+
+	else if ( ! new_bytes )
+		{
+		cb.holders.erase(std::find(cb.holders.begin(), cb.holders.end(), h));
+
+		if ( cb.holders.empty() )
+			{
+			conns.erase(it);
+			return;
+			}
+		}
+
+	if ( buffer_memory_limit_per_conn && ! cb.over_limit &&
+	     cb.bytes > buffer_memory_limit_per_conn )
+		{
+		cb.over_limit = true;
+		over_limit.push_back(h->buffer_conn);
+		}
+	}
+
+void BufferBudget::Enforce()
+	{
+	if ( ! over_limit.empty() )
+		{
+		std::vector<Connection*> to_check;
+		to_check.swap(over_limit);
+
+		for ( auto c : to_check )
+			{
+			auto it = conns.find(c);
+
+			if ( it == conns.end() )
+				continue;
+
+			it->second.over_limit = false;
+
+			if ( it->second.bytes > buffer_memory_limit_per_conn )
+				Evict(c, "conn_buffer_limit_exceeded");
+			}
+		}
+
+	if ( ! buffer_memory_limit || total <= buffer_memory_limit )
+		return;
+
+	// Leave some room, so that we don't end up evicting a connection
+	// on every packet.
+	uint64_t target = buffer_memory_limit - buffer_memory_limit / 10;
+
+	std::vector<Victim> victims;
+	RankVictims(&victims);
+
+	while ( total > target && ! victims.empty() )
+		{
+		std::pop_heap(victims.begin(), victims.end(), EvictLater);
+		Connection* c = victims.back().conn;
+		victims.pop_back();
+
+		// Evicting one connection may have made another one drop
+		// its buffers.
+		if ( conns.find(c) == conns.end() )
+			continue;
+
+		Evict(c, "buffer_memory_limit_exceeded");
+		}
+	}
+
+bool BufferBudget::EvictLater(const Victim& a, const Victim& b)
+	{
+	if ( buffer_eviction_policy == BifEnum::EVICT_LARGEST )
+		return a.bytes < b.bytes;
+
+	return a.since > b.since;
+	}
+
+void BufferBudget::RankVictims(std::vector<Victim>* victims) const
+	{
+	victims->reserve(conns.size());
+
+	for ( const auto& e : conns )
+		{
+		const ConnBuffers& cb = e.second;
+		double since = network_time;
+
+		for ( auto h : cb.holders )
+			since = std::min(since, h->BufferedSince());
+
+		victims->push_back({const_cast<Connection*>(e.first), cb.bytes, since});
+		}
+
+	std::make_heap(victims->begin(), victims->end(), EvictLater);
+	}
+
+void BufferBudget::Evict(Connection* c, const char* weird)
+	{
+	auto it = conns.find(c);
+	uint64_t bytes = it->second.bytes;
+
+	c->Weird(weird, fmt("%" PRIu64, bytes));
+	++evictions;
+
+	// Evicting may deliver data to analyzers, which may then buffer
+	// some more, so look up the holders afresh each time.
+	for ( size_t i = it->second.holders.size(); i > 0; --i )
+		{
+		it = conns.find(c);
+
+		if ( it == conns.end() )
+			break;
+
+		if ( i <= it->second.holders.size() )
+			it->second.holders[i - 1]->EvictBuffers();
+		}
+
+	uint64_t remaining = ConnBuffered(c);
+
+	if ( remaining < bytes )
+		evicted_bytes += bytes - remaining;
+	}
+
+uint64_t BufferBudget::ConnBuffered(const Connection* c) const
+	{
+	auto it = conns.find(c);
+	return it != conns.end() ? it->second.bytes : 0;
+	}
+
+void BufferBudget::GetStats(Stats* s) const
+	{
+	s->bytes = total;
+
+	for ( int i = 0; i < NUM_BUFFER_TYPES; ++i )
+		s->bytes_by_type[i] = by_type[i];
+
+	s->conns = conns.size();
+	s->evictions = evictions;
+	s->evicted_bytes = evicted_bytes;
+	}
+
+namespace {
+
+class TestHolder : public BufferHolder {
+public:
+	TestHolder(Connection* c, BufferType t) : BufferHolder(t), conn(c)	{ }
+
+	void Set(uint64_t bytes)	{ SetBuffered(bytes); }
+
+protected:
+	Connection* BufferConn() const override	{ return conn; }
+	void EvictBuffers() override	{ SetBuffered(0); }
+
+private:
+	Connection* conn;
+};
+
+}
+
+TEST_CASE("buffer budget accounting")
+	{
+	BufferBudget::Stats s0;
+	buffer_budget.GetStats(&s0);
+
+	auto c1 = reinterpret_cast<Connection*>(0x1000);
+	auto c2 = reinterpret_cast<Connection*>(0x2000);
+
+		{
+		TestHolder h1(c1, BUFFER_REASSEMBLY);
+		TestHolder h2(c1, BUFFER_LINES);
+		TestHolder h3(c2, BUFFER_REASSEMBLY);
+
+		h1.Set(100);
+		h2.Set(50);
+		h3.Set(10);
+		h1.Set(70);
+
+		CHECK(buffer_budget.ConnBuffered(c1) == 120);
+		CHECK(buffer_budget.ConnBuffered(c2) == 10);
+
+		BufferBudget::Stats s;
+		buffer_budget.GetStats(&s);
+		CHECK(s.bytes - s0.bytes == 130);
+		CHECK(s.bytes_by_type[BUFFER_REASSEMBLY] - s0.bytes_by_type[BUFFER_REASSEMBLY] == 80);
+		CHECK(s.bytes_by_type[BUFFER_LINES] - s0.bytes_by_type[BUFFER_LINES] == 50);
+		CHECK(s.conns - s0.conns == 2);
+
+		h3.Set(0);
+		CHECK(buffer_budget.ConnBuffered(c2) == 0);
+		}
+
+	// Destroying the holders releases their data.
+	CHECK(buffer_budget.ConnBuffered(c1) == 0);
+
+	BufferBudget::Stats s;
+	buffer_budget.GetStats(&s);
+	CHECK(s.bytes == s0.bytes);
+	CHECK(s.conns == s0.conns);
+	}
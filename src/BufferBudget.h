@@ -0,0 +1,147 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+class Connection;
+class BufferHolder;
+
+// The kinds of data buffered on behalf of connections.
+enum BufferType {
+	BUFFER_REASSEMBLY,	// TCP reassembly
+	BUFFER_DPD,	// protocol detection
+	BUFFER_LINES,	// lines being assembled
+	NUM_BUFFER_TYPES
+};
+
+/**
+ * Keeps track of the data that reassemblers and analyzers buffer on
+ * behalf of connections, and makes them drop it once they hold too much.
+ *
+ * If a single connection buffers more than buffer_memory_limit_per_conn
+ * bytes, all of its buffers get evicted. If all connections together
+ * buffer more than buffer_memory_limit bytes, connections get evicted
+ * until the total is back under 90% of the limit, in the order given by
+ * buffer_eviction_policy: either the ones waiting the longest on a hole
+ * in their data first, or the ones buffering the most. Each eviction
+ * raises a weird for the connection.
+ *
+ * Evicting may deliver data to analyzers, so it only happens in
+ * Enforce(), which must be called in between packets. Once over the
+ * global limit, Enforce() ranks all connections buffering anything and
+ * evicts from the top of that ranking until back under the target.
+ */
+class BufferBudget {
+public:
+	/**
+	 * Evicts connections as needed to keep within the limits.
+	 */
+	void Enforce();
+
+	struct Stats {
+		uint64_t bytes;	// bytes currently buffered
+		uint64_t bytes_by_type[NUM_BUFFER_TYPES];
+		uint64_t conns;	// connections buffering anything
+		uint64_t evictions;	// connections evicted
+		uint64_t evicted_bytes;
+	};
+
+	void GetStats(Stats* s) const;
+
+	/**
+	 * Returns the number of bytes buffered for a connection.
+	 */
+	uint64_t ConnBuffered(const Connection* c) const;
+
+private:
+	friend class BufferHolder;
+
+	struct ConnBuffers {
+		uint64_t bytes = 0;
+		bool over_limit = false;	// queued for eviction
+		std::vector<BufferHolder*> holders;	// ones with any data
+	};
+
+	// Accounts for a holder's change in buffered data.
+	void Update(BufferHolder* h, uint64_t old_bytes, uint64_t new_bytes);
+
+	// A connection that may get evicted under the global limit.
+	struct Victim {
+		Connection* conn;
+		uint64_t bytes;
+		double since;	// when its oldest buffered data arrived
+	};
+
+	// Orders victims for a heap that has the one to evict first on top,
+	// per the eviction policy.
+	static bool EvictLater(const Victim& a, const Victim& b);
+
+	// Collects all connections buffering anything into a heap.
+	void RankVictims(std::vector<Victim>* victims) const;
+
+	// Evicts all buffers of a connection, raising the given weird.
+	void Evict(Connection* c, const char* weird);
+
+	std::unordered_map<const Connection*, ConnBuffers> conns;
+	std::vector<Connection*> over_limit;
+	uint64_t total = 0;
+	uint64_t by_type[NUM_BUFFER_TYPES] = { 0 };
+	uint64_t evictions = 0;
+	uint64_t evicted_bytes = 0;
+};
+
+extern BufferBudget buffer_budget;
+
+/**
+ * Base class for anything buffering data on behalf of a connection.
+ * Derived classes report how much they hold through SetBuffered(), and
+ * drop it when asked to through EvictBuffers().
+ */
+class BufferHolder {
+public:
+	explicit BufferHolder(BufferType arg_type) : buffer_type(arg_type)	{ }
+	virtual ~BufferHolder()	{ SetBuffered(0); }
+
+	/**
+	 * Returns the number of bytes currently buffered.
+	 */
+	uint64_t Buffered() const	{ return buffered; }
+
+	/**
+	 * Returns since when the buffered data has been waiting, for
+	 * evicting the oldest first. By default, that's since the holder
+	 * last started buffering anything.
+	 */
+	virtual double BufferedSince() const	{ return buffered_since; }
+
+protected:
+	friend class BufferBudget;
+
+	/**
+	 * Reports the number of bytes currently buffered.
+	 */
+	void SetBuffered(uint64_t bytes);
+
+	/**
+	 * Returns the connection that data is buffered for. Called whenever
+	 * the holder starts buffering; data without a connection is counted
+	 * but never evicted.
+	 */
+	virtual Connection* BufferConn() const = 0;
+
+	/**
+	 * Drops all buffered data, delivering or skipping it as suits the
+	 * holder, and reports zero bytes.
+	 */
+	virtual void EvictBuffers() = 0;
+
+private:
+	BufferType buffer_type;
+	uint64_t buffered = 0;
+	double buffered_since = 0;
+	Connection* buffer_conn = nullptr;	// set while buffering
+};
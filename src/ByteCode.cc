@@ -0,0 +1,974 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ByteCode.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "Expr.h"
+#include "Stmt.h"
+#include "Frame.h"
+#include "Func.h"
+#include "Val.h"
+#include "ID.h"
+#include "Attr.h"
+#include "BroString.h"
+#include "Reporter.h"
+#include "Trigger.h"
+
+bool compile_scripts = false;
+
+// Compiles one body. Expressions get compiled into a given register,
+// using the registers above it for their operands, so that the number
+// of registers is the maximum nesting depth.
+class ByteCodeCompiler {
+public:
+	explicit ByteCodeCompiler(ByteCode* arg_bc) : bc(arg_bc)	{ }
+
+	void CompileStmt(const Stmt* s);
+
+	// Returns whether the expression's value may be nil, as the AST
+	// yields e.g. for calls of functions without a return value and
+	// for calls that got delayed.
+	bool CompileExpr(const Expr* e, int r);
+
+	// Whether any code beyond what just hands off to the AST got
+	// generated.
+	bool Native() const	{ return native; }
+
+	int Emit(ByteCode::Op op, int a = 0, int b = 0, int c = 0,
+	         const Expr* e = nullptr);
+
+	// Lets the jump emitted at the given position go to the next
+	// instruction emitted.
+	void PatchJump(int at)
+		{ bc->code[at].b = bc->code.size(); }
+
+private:
+	bool CompileFallback(const Expr* e, int r);
+	bool CompileAssign(const AssignExpr* e, int r);
+	bool CompileBinary(const BinaryExpr* e, int r);
+	bool CompileCall(const CallExpr* e, int r);
+
+	// Returns the typed opcode for an arithmetic or relational
+	// expression, or -1 if there's none.
+	static int TypedOp(const BinaryExpr* e);
+
+	ByteCode* bc;
+	bool native = false;
+};
+
+int ByteCodeCompiler::Emit(ByteCode::Op op, int a, int b, int c,
+                           const Expr* e)
+	{
+	ByteCode::Instr i;
+	i.op = op;
+	i.a = a;
+	i.b = b;
+	i.c = c;
+	i.e = e;
+	i.val = nullptr;
+
+	bc->num_regs = std::max(bc->num_regs, a + 1);
+
+	switch ( op ) {
+	case ByteCode::OP_ACCESS:
+	case ByteCode::OP_EVAL:
+	case ByteCode::OP_EXEC:
+	case ByteCode::OP_DISCARD:
+	case ByteCode::OP_END:
+		break;
+
+	default:
+		native = true;
+	}
+
+	bc->code.push_back(i);
+	return bc->code.size() - 1;
+	}
+
+void ByteCodeCompiler::CompileStmt(const Stmt* s)
+	{
+	// Statements left to the AST count their executions themselves.
+	switch ( s->Tag() ) {
+	case STMT_LIST:
+	case STMT_EXPR:
+	case STMT_IF:
+	case STMT_RETURN:
+	case STMT_NULL:
+	case STMT_NEXT:
+	case STMT_BREAK:
+	case STMT_FALLTHROUGH:
+		{
+		int i = Emit(ByteCode::OP_ACCESS);
+		bc->code[i].stmt = s;
+		break;
+		}
+
+	default:
+		break;
+	}
+
+	switch ( s->Tag() ) {
+	case STMT_LIST:
+		for ( const auto& stmt : s->AsStmtList()->Stmts() )
+			CompileStmt(stmt);
+		return;
+
+	case STMT_EXPR:
+		{
+		auto e = static_cast<const ExprStmt*>(s)->StmtExpr();
+
+		if ( ! e )
+			// Nothing to evaluate; OP_ACCESS above already
+			// counted it.
+			return;
+
+		CompileExpr(e, 0);
+		Emit(ByteCode::OP_DISCARD, 0);
+		return;
+		}
+
+	case STMT_IF:
+		{
+		auto is = static_cast<const IfStmt*>(s);
+		bool may_be_nil = CompileExpr(is->StmtExpr(), 0);
+
+		// A nil condition executes neither branch.
+		int skip = -1;
+		if ( may_be_nil )
+			skip = Emit(ByteCode::OP_JUMP_IF_NULL, 0, 0, 0);
+
+		int to_false = Emit(ByteCode::OP_JUMP_IF_FALSE, 0);
+
+		if ( is->TrueBranch() )
+			CompileStmt(is->TrueBranch());
+
+		int to_end = Emit(ByteCode::OP_JUMP);
+		PatchJump(to_false);
+
+		if ( is->FalseBranch() )
+			CompileStmt(is->FalseBranch());
+
+		PatchJump(to_end);
+
+		if ( skip >= 0 )
+			PatchJump(skip);
+
+		Emit(ByteCode::OP_DISCARD, 0);
+		return;
+		}
+
+	case STMT_RETURN:
+		{
+		auto e = static_cast<const ReturnStmt*>(s)->StmtExpr();
+
+		if ( e )
+			{
+			CompileExpr(e, 0);
+			Emit(ByteCode::OP_RETURN, 0);
+			}
+		else
+			Emit(ByteCode::OP_RETURN, -1);
+
+		return;
+		}
+
+	case STMT_NULL:
+		return;
+
+	case STMT_NEXT:
+		Emit(ByteCode::OP_FLOW, 0, FLOW_LOOP);
+		return;
+
+	case STMT_BREAK:
+		Emit(ByteCode::OP_FLOW, 0, FLOW_BREAK);
+		return;
+
+	case STMT_FALLTHROUGH:
+		Emit(ByteCode::OP_FLOW, 0, FLOW_FALLTHROUGH);
+		return;
+
+	default:
+		// Loops and the like, which might catch flows other than
+		// FLOW_NEXT from their bodies, are left to the AST as a
+		// whole. That way any flow reaching the compiled code ends
+		// the body, just as it propagates up to the body's top in
+		// the AST.
+		break;
+	}
+
+	int i = Emit(ByteCode::OP_EXEC);
+	bc->code[i].stmt = s;
+	}
+
+bool ByteCodeCompiler::CompileFallback(const Expr* e, int r)
+	{
+	Emit(ByteCode::OP_EVAL, r, 0, 0, e);
+	return true;
+	}
+
+bool ByteCodeCompiler::CompileExpr(const Expr* e, int r)
+	{
+	if ( e->IsError() )
+		return CompileFallback(e, r);
+
+	switch ( e->Tag() ) {
+	case EXPR_CONST:
+		{
+		int i = Emit(ByteCode::OP_CONST, r);
+		bc->code[i].val = static_cast<const ConstExpr*>(e)->Value();
+		return false;
+		}
+
+	case EXPR_NAME:
+		{
+		ID* id = static_cast<const NameExpr*>(e)->Id();
+
+		if ( id->AsType() )
+			break;
+
+		int i = Emit(id->IsGlobal() ? ByteCode::OP_GLOBAL : ByteCode::OP_LOCAL,
+		             r, 0, 0, e);
+		bc->code[i].id = id;
+		return false;
+		}
+
+	case EXPR_ASSIGN:
+		return CompileAssign(static_cast<const AssignExpr*>(e), r);
+
+	case EXPR_FIELD:
+		{
+		auto fe = static_cast<const FieldExpr*>(e);
+		auto rt = fe->Op()->Type()->AsRecordType();
+
+		// Leave &default to the AST.
+		if ( rt->FieldDecl(fe->Field())->FindAttr(ATTR_DEFAULT) )
+			break;
+
+		bool may_be_nil = CompileExpr(fe->Op(), r);
+		Emit(ByteCode::OP_FIELD, r, 0, fe->Field(), e);
+		return may_be_nil;
+		}
+
+	case EXPR_HAS_FIELD:
+		{
+		auto hfe = static_cast<const HasFieldExpr*>(e);
+		auto rt = hfe->Op()->Type()->AsRecordType();
+
+		bool may_be_nil = CompileExpr(hfe->Op(), r);
+		Emit(ByteCode::OP_HAS_FIELD, r, 0, rt->FieldOffset(hfe->FieldName()));
+		return may_be_nil;
+		}
+
+	case EXPR_NOT:
+		{
+		if ( e->Type()->Tag() != TYPE_BOOL )
+			break;
+
+		bool may_be_nil = CompileExpr(static_cast<const NotExpr*>(e)->Op(), r);
+		Emit(ByteCode::OP_NOT, r);
+		return may_be_nil;
+		}
+
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+		{
+		auto be = static_cast<const BinaryExpr*>(e);
+
+		if ( is_vector(be->Op1()) || is_vector(be->Op2()) )
+			break;
+
+		// The first operand's value is the result if it decides
+		// the outcome (or is nil).
+		bool may_be_nil = CompileExpr(be->Op1(), r);
+		int skip = Emit(e->Tag() == EXPR_AND_AND ?
+		                ByteCode::OP_JUMP_IF_FALSE : ByteCode::OP_JUMP_IF_TRUE, r);
+
+		if ( CompileExpr(be->Op2(), r) )
+			may_be_nil = true;
+
+		PatchJump(skip);
+		return may_be_nil;
+		}
+
+	case EXPR_COND:
+		{
+		auto ce = static_cast<const CondExpr*>(e);
+
+		if ( is_vector(const_cast<Expr*>(ce->Op1())) )
+			break;
+
+		// A nil condition makes for a nil result.
+		bool cond_nil = CompileExpr(ce->Op1(), r);
+
+		int skip = -1;
+		if ( cond_nil )
+			skip = Emit(ByteCode::OP_JUMP_IF_NULL, r, 0, r);
+
+		int to_false = Emit(ByteCode::OP_JUMP_IF_FALSE, r);
+		bool may_be_nil = CompileExpr(ce->Op2(), r);
+		int to_end = Emit(ByteCode::OP_JUMP);
+		PatchJump(to_false);
+
+		if ( CompileExpr(ce->Op3(), r) )
+			may_be_nil = true;
+
+		PatchJump(to_end);
+
+		if ( skip >= 0 )
+			PatchJump(skip);
+
+		return may_be_nil || cond_nil;
+		}
+
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+		{
+		auto be = static_cast<const BinaryExpr*>(e);
+
+		if ( TypedOp(be) < 0 )
+			break;
+
+		return CompileBinary(be, r);
+		}
+
+	case EXPR_LIST:
+		{
+		const auto& exprs = static_cast<const ListExpr*>(e)->Exprs();
+
+		for ( int k = 0; k < exprs.length(); ++k )
+			// A nil element is an error right away.
+			if ( CompileExpr(exprs[k], r + k) )
+				Emit(ByteCode::OP_LIST_ELEMENT, r + k, 0, 0, e);
+
+		Emit(ByteCode::OP_LIST, r, 0, exprs.length(), e);
+		return false;
+		}
+
+	case EXPR_INDEX:
+		{
+		auto ie = static_cast<const IndexExpr*>(e);
+
+		if ( ie->IsSlice() )
+			break;
+
+		const auto& indices = ie->Op2()->AsListExpr()->Exprs();
+
+		if ( indices.length() == 0 )
+			break;
+
+		TypeTag index_tag = indices[0]->Type()->Tag();
+
+		if ( index_tag == TYPE_VECTOR || index_tag == TYPE_ANY )
+			break;
+
+		ByteCode::Op op;
+		TypeTag t = ie->Op1()->Type()->Tag();
+
+		if ( t == TYPE_TABLE )
+			op = ByteCode::OP_INDEX_TABLE;
+		else if ( t == TYPE_VECTOR && indices.length() == 1 )
+			op = ByteCode::OP_INDEX_VECTOR;
+		else
+			break;
+
+		bool may_be_nil = CompileExpr(ie->Op1(), r);
+
+		int skip = -1;
+		if ( may_be_nil )
+			skip = Emit(ByteCode::OP_JUMP_IF_NULL, r, 0, r);
+
+		CompileExpr(ie->Op2(), r + 1);
+		Emit(op, r, r + 1, 0, e);
+
+		if ( skip >= 0 )
+			PatchJump(skip);
+
+		return may_be_nil;
+		}
+
+	case EXPR_IN:
+		{
+		auto ie = static_cast<const InExpr*>(e);
+
+		if ( ie->Op1()->Tag() != EXPR_LIST ||
+		     ie->Op2()->Type()->Tag() != TYPE_TABLE )
+			break;
+
+		CompileExpr(ie->Op1(), r);
+		bool may_be_nil = CompileExpr(ie->Op2(), r + 1);
+		Emit(ByteCode::OP_IN_TABLE, r, r + 1);
+		return may_be_nil;
+		}
+
+	case EXPR_CALL:
+		return CompileCall(static_cast<const CallExpr*>(e), r);
+
+	default:
+		break;
+	}
+
+	return CompileFallback(e, r);
+	}
+
+bool ByteCodeCompiler::CompileAssign(const AssignExpr* e, int r)
+	{
+	if ( e->IsInit() || e->AssignVal() || e->Op1()->Tag() != EXPR_REF )
+		return CompileFallback(e, r);
+
+	const Expr* lhs = static_cast<const RefExpr*>(e->Op1())->Op();
+
+	if ( lhs->Tag() == EXPR_NAME )
+		{
+		ID* id = static_cast<const NameExpr*>(lhs)->Id();
+		bool may_be_nil = CompileExpr(e->Op2(), r);
+
+		int skip = -1;
+		if ( may_be_nil )
+			skip = Emit(ByteCode::OP_JUMP_IF_NULL, r, 0, r);
+
+		int i = Emit(id->IsGlobal() ?
+		             ByteCode::OP_ASSIGN_GLOBAL : ByteCode::OP_ASSIGN_LOCAL, r);
+		bc->code[i].id = id;
+
+		if ( skip >= 0 )
+			PatchJump(skip);
+
+		return may_be_nil;
+		}
+
+	if ( lhs->Tag() == EXPR_FIELD && ! lhs->IsError() )
+		{
+		auto fe = static_cast<const FieldExpr*>(lhs);
+		bool may_be_nil = CompileExpr(e->Op2(), r);
+
+		// The record only gets evaluated for a non-nil value.
+		int skip = -1;
+		if ( may_be_nil )
+			skip = Emit(ByteCode::OP_JUMP_IF_NULL, r, 0, r);
+
+		CompileExpr(fe->Op(), r + 1);
+		Emit(ByteCode::OP_ASSIGN_FIELD, r, r + 1, fe->Field());
+
+		if ( skip >= 0 )
+			PatchJump(skip);
+
+		return may_be_nil;
+		}
+
+	return CompileFallback(e, r);
+	}
+
+int ByteCodeCompiler::TypedOp(const BinaryExpr* e)
+	{
+	TypeTag t1 = e->Op1()->Type()->Tag();
+	TypeTag t2 = e->Op2()->Type()->Tag();
+	TypeTag t = e->Type()->Tag();
+
+	if ( t1 != t2 )
+		return -1;
+
+	int type_index;
+
+	switch ( t1 ) {
+	case TYPE_INT:	type_index = 0; break;
+	case TYPE_COUNT:	type_index = 1; break;
+	case TYPE_DOUBLE:	type_index = 2; break;
+
+	case TYPE_STRING:
+		if ( t != TYPE_BOOL )
+			return -1;
+
+		if ( e->Tag() == EXPR_EQ )
+			return ByteCode::OP_EQ_STRING;
+
+		if ( e->Tag() == EXPR_NE )
+			return ByteCode::OP_NE_STRING;
+
+		return -1;
+
+	default:
+		return -1;
+	}
+
+	static const int arith_ops[3][5] = {
+		{ ByteCode::OP_ADD_INT, ByteCode::OP_SUB_INT, ByteCode::OP_MUL_INT,
+		  ByteCode::OP_DIV_INT, ByteCode::OP_MOD_INT },
+		{ ByteCode::OP_ADD_COUNT, ByteCode::OP_SUB_COUNT,
+		  ByteCode::OP_MUL_COUNT, ByteCode::OP_DIV_COUNT,
+		  ByteCode::OP_MOD_COUNT },
+		{ ByteCode::OP_ADD_DOUBLE, ByteCode::OP_SUB_DOUBLE,
+		  ByteCode::OP_MUL_DOUBLE, ByteCode::OP_DIV_DOUBLE, -1 },
+	};
+
+	static const int rel_ops[3][6] = {
+		{ ByteCode::OP_LT_INT, ByteCode::OP_LE_INT, ByteCode::OP_EQ_INT,
+		  ByteCode::OP_NE_INT, ByteCode::OP_GE_INT, ByteCode::OP_GT_INT },
+		{ ByteCode::OP_LT_COUNT, ByteCode::OP_LE_COUNT,
+		  ByteCode::OP_EQ_COUNT, ByteCode::OP_NE_COUNT,
+		  ByteCode::OP_GE_COUNT, ByteCode::OP_GT_COUNT },
+		{ ByteCode::OP_LT_DOUBLE, ByteCode::OP_LE_DOUBLE,
+		  ByteCode::OP_EQ_DOUBLE, ByteCode::OP_NE_DOUBLE,
+		  ByteCode::OP_GE_DOUBLE, ByteCode::OP_GT_DOUBLE },
+	};
+
+	switch ( e->Tag() ) {
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+		{
+		if ( t != t1 )
+			return -1;
+
+		static const BroExprTag arith_tags[] = {
+			EXPR_ADD, EXPR_SUB, EXPR_TIMES, EXPR_DIVIDE, EXPR_MOD,
+		};
+
+		for ( int k = 0; k < 5; ++k )
+			if ( e->Tag() == arith_tags[k] )
+				return arith_ops[type_index][k];
+
+		return -1;
+		}
+
+	default:
+		{
+		if ( t != TYPE_BOOL )
+			return -1;
+
+		static const BroExprTag rel_tags[] = {
+			EXPR_LT, EXPR_LE, EXPR_EQ, EXPR_NE, EXPR_GE, EXPR_GT,
+		};
+
+		for ( int k = 0; k < 6; ++k )
+			if ( e->Tag() == rel_tags[k] )
+				return rel_ops[type_index][k];
+
+		return -1;
+		}
+	}
+	}
+
+bool ByteCodeCompiler::CompileBinary(const BinaryExpr* e, int r)
+	{
+	// As in the AST, a nil first operand skips the second one.
+	bool may_be_nil = CompileExpr(e->Op1(), r);
+
+	int skip = -1;
+	if ( may_be_nil )
+		skip = Emit(ByteCode::OP_JUMP_IF_NULL, r, 0, r);
+
+	if ( CompileExpr(e->Op2(), r + 1) )
+		may_be_nil = true;
+
+	Emit(static_cast<ByteCode::Op>(TypedOp(e)), r, r + 1, 0, e);
+
+	if ( skip >= 0 )
+		PatchJump(skip);
+
+	return may_be_nil;
+	}
+
+bool ByteCodeCompiler::CompileCall(const CallExpr* e, int r)
+	{
+	// Inside a trigger condition, the result may already be cached.
+	int cached = Emit(ByteCode::OP_CALL_CACHED, r, 0, 0, e);
+
+	CompileExpr(e->Func(), r);
+
+	// As in eval_list(), a nil argument stops evaluating the others;
+	// the call instruction then notices it and yields nil.
+	const auto& args = e->Args()->Exprs();
+	std::vector<int> to_call;
+
+	for ( int k = 0; k < args.length(); ++k )
+		if ( CompileExpr(args[k], r + 1 + k) )
+			to_call.push_back(Emit(ByteCode::OP_JUMP_IF_NULL, r + 1 + k, 0,
+			                       r + 1 + k));
+
+	for ( auto i : to_call )
+		PatchJump(i);
+
+	Emit(ByteCode::OP_CALL, r, r + 1, args.length(), e);
+	PatchJump(cached);
+
+	return true;
+	}
+
+ByteCode* ByteCode::Compile(const Stmt* body)
+	{
+	auto bc = std::unique_ptr<ByteCode>(new ByteCode());
+	ByteCodeCompiler c(bc.get());
+
+	c.CompileStmt(body);
+	c.Emit(OP_END);
+
+	if ( ! c.Native() )
+		return nullptr;
+
+	bc->body = {NewRef{}, const_cast<Stmt*>(body)};
+	return bc.release();
+	}
+
+ByteCode::~ByteCode()
+	{
+	}
+
+IntrusivePtr<Val> ByteCode::Exec(Frame* f, stmt_flow_type& flow) const
+	{
+	IntrusivePtr<Val> stack_regs[MAX_STACK_REGS];
+	std::unique_ptr<IntrusivePtr<Val>[]> heap_regs;
+	IntrusivePtr<Val>* r = stack_regs;
+
+	if ( num_regs > MAX_STACK_REGS )
+		{
+		heap_regs.reset(new IntrusivePtr<Val>[num_regs]);
+		r = heap_regs.get();
+		}
+
+	flow = FLOW_NEXT;
+
+	const Instr* code_start = code.data();
+	const Instr* ip = code_start;
+
+	for ( ; ; )
+		{
+		const Instr& i = *ip++;
+
+		switch ( i.op ) {
+		case OP_CONST:
+			r[i.a] = {NewRef{}, i.val};
+			break;
+
+		case OP_LOCAL:
+			{
+			Val* v = f->GetElement(i.id);
+
+			if ( ! v )
+				reporter->ExprRuntimeError(i.e, "value used but not set");
+
+			r[i.a] = {NewRef{}, v};
+			break;
+			}
+
+		case OP_GLOBAL:
+			{
+			Val* v = i.id->ID_Val();
+
+			if ( ! v )
+				reporter->ExprRuntimeError(i.e, "value used but not set");
+
+			r[i.a] = {NewRef{}, v};
+			break;
+			}
+
+		case OP_ACCESS:
+			i.stmt->RegisterAccess();
+			break;
+
+		case OP_EVAL:
+			r[i.a] = i.e->Eval(f);
+			break;
+
+		case OP_EXEC:
+			{
+			auto result = i.stmt->Exec(f, flow);
+
+			if ( flow != FLOW_NEXT || result || f->HasDelayed() )
+				return result;
+
+			break;
+			}
+
+		case OP_DISCARD:
+			r[i.a] = nullptr;
+
+			if ( f->HasDelayed() )
+				return nullptr;
+
+			break;
+
+		case OP_ASSIGN_LOCAL:
+			f->SetElement(i.id, r[i.a]->Ref());
+			break;
+
+		case OP_ASSIGN_GLOBAL:
+			i.id->SetVal(r[i.a]);
+			break;
+
+		case OP_ASSIGN_FIELD:
+			if ( r[i.b] )
+				{
+				r[i.b]->AsRecordVal()->Assign(i.c, r[i.a]);
+				r[i.b] = nullptr;
+				}
+			break;
+
+		case OP_FIELD:
+			if ( r[i.a] )
+				{
+				Val* v = r[i.a]->AsRecordVal()->Lookup(i.c);
+
+				if ( ! v )
+					reporter->ExprRuntimeError(i.e, "field value missing");
+
+				r[i.a] = {NewRef{}, v};
+				}
+			break;
+
+		case OP_HAS_FIELD:
+			if ( r[i.a] )
+				r[i.a] = val_mgr->Bool(r[i.a]->AsRecordVal()->Lookup(i.c));
+			break;
+
+		case OP_NOT:
+			if ( r[i.a] )
+				r[i.a] = val_mgr->Bool(! r[i.a]->InternalInt());
+			break;
+
+		case OP_LIST_ELEMENT:
+			if ( ! r[i.a] )
+				reporter->ExprRuntimeError(i.e, "uninitialized list value");
+			break;
+
+		case OP_LIST:
+			{
+			auto l = make_intrusive<ListVal>(TYPE_ANY);
+
+			for ( int k = 0; k < i.c; ++k )
+				{
+				if ( ! r[i.a + k] )
+					reporter->ExprRuntimeError(i.e, "uninitialized list value");
+
+				l->Append(r[i.a + k].release());
+				}
+
+			r[i.a] = std::move(l);
+			break;
+			}
+
+		case OP_INDEX_TABLE:
+			{
+			auto v = r[i.a]->AsTableVal()->Lookup(r[i.b].get());
+
+			if ( ! v )
+				reporter->ExprRuntimeError(i.e, "no such index");
+
+			r[i.a] = std::move(v);
+			r[i.b] = nullptr;
+			break;
+			}
+
+		case OP_INDEX_VECTOR:
+			{
+			Val* v = r[i.a]->AsVectorVal()->Lookup(r[i.b].get());
+
+			if ( ! v )
+				reporter->ExprRuntimeError(i.e, "no such index");
+
+			r[i.a] = {NewRef{}, v};
+			r[i.b] = nullptr;
+			break;
+			}
+
+		case OP_IN_TABLE:
+			if ( r[i.b] )
+				{
+				bool found = r[i.b]->AsTableVal()->Lookup(r[i.a].get(), false) != nullptr;
+				r[i.a] = val_mgr->Bool(found);
+				r[i.b] = nullptr;
+				}
+			else
+				r[i.a] = nullptr;
+			break;
+
+		case OP_CALL_CACHED:
+			if ( trigger::Trigger* trigger = f->GetTrigger() )
+				{
+				if ( Val* v = trigger->Lookup(static_cast<const CallExpr*>(i.e)) )
+					{
+					r[i.a] = {NewRef{}, v};
+					ip = code_start + i.b;
+					}
+				}
+			break;
+
+		case OP_CALL:
+			{
+			bool have_all = r[i.a] != nullptr;
+
+			for ( int k = 0; k < i.c && have_all; ++k )
+				if ( ! r[i.b + k] )
+					have_all = false;
+
+			if ( ! have_all )
+				{
+				for ( int k = 0; k <= i.c; ++k )
+					r[i.a + k] = nullptr;
+
+				break;
+				}
+
+			zeek::Args args;
+			args.reserve(i.c);
+
+			for ( int k = 0; k < i.c; ++k )
+				args.emplace_back(std::move(r[i.b + k]));
+
+			const Func* func = r[i.a]->AsFunc();
+			const CallExpr* current_call = f->GetCall();
+
+			f->SetCall(static_cast<const CallExpr*>(i.e));
+			auto result = func->Call(args, f);
+			f->SetCall(current_call);
+
+			r[i.a] = std::move(result);
+			break;
+			}
+
+		case OP_JUMP:
+			ip = code_start + i.b;
+			break;
+
+		case OP_JUMP_IF_NULL:
+			if ( ! r[i.a] )
+				{
+				r[i.c] = nullptr;
+				ip = code_start + i.b;
+				}
+			break;
+
+		case OP_JUMP_IF_FALSE:
+			if ( ! r[i.a] || r[i.a]->IsZero() )
+				ip = code_start + i.b;
+			break;
+
+		case OP_JUMP_IF_TRUE:
+			if ( ! r[i.a] || ! r[i.a]->IsZero() )
+				ip = code_start + i.b;
+			break;
+
+		case OP_RETURN:
+			flow = FLOW_RETURN;
+
+			if ( i.a < 0 )
+				return nullptr;
+
+			return std::move(r[i.a]);
+
+		case OP_FLOW:
+			flow = static_cast<stmt_flow_type>(i.b);
+			return nullptr;
+
+		case OP_END:
+			return nullptr;
+
+#define BINARY_OP(name, compute) \
+		case name: \
+			{ \
+			if ( ! r[i.a] || ! r[i.b] ) \
+				{ \
+				r[i.a] = nullptr; \
+				r[i.b] = nullptr; \
+				break; \
+				} \
+			\
+			Val* v1 = r[i.a].get(); \
+			Val* v2 = r[i.b].get(); \
+			compute; \
+			r[i.b] = nullptr; \
+			break; \
+			}
+
+#define INT_OP(name, op) \
+		BINARY_OP(name, r[i.a] = val_mgr->Int(v1->ForceAsInt() op v2->ForceAsInt()))
+#define COUNT_OP(name, op) \
+		BINARY_OP(name, r[i.a] = val_mgr->Count(v1->ForceAsUInt() op v2->ForceAsUInt()))
+#define DOUBLE_OP(name, op) \
+		BINARY_OP(name, r[i.a] = make_intrusive<Val>(v1->InternalDouble() op v2->InternalDouble(), TYPE_DOUBLE))
+
+#define INT_REL(name, op) \
+		BINARY_OP(name, r[i.a] = val_mgr->Bool(v1->ForceAsInt() op v2->ForceAsInt()))
+#define COUNT_REL(name, op) \
+		BINARY_OP(name, r[i.a] = val_mgr->Bool(v1->ForceAsUInt() op v2->ForceAsUInt()))
+#define DOUBLE_REL(name, op) \
+		BINARY_OP(name, r[i.a] = val_mgr->Bool(v1->InternalDouble() op v2->InternalDouble()))
+
+#define CHECKED_OP(name, get, make, op, msg) \
+		BINARY_OP(name, \
+			if ( v2->get() == 0 ) \
+				reporter->ExprRuntimeError(i.e, msg); \
+			r[i.a] = make(v1->get() op v2->get()))
+
+		INT_OP(OP_ADD_INT, +)
+		INT_OP(OP_SUB_INT, -)
+		INT_OP(OP_MUL_INT, *)
+		CHECKED_OP(OP_DIV_INT, ForceAsInt, val_mgr->Int, /, "division by zero")
+		CHECKED_OP(OP_MOD_INT, ForceAsInt, val_mgr->Int, %, "modulo by zero")
+
+		COUNT_OP(OP_ADD_COUNT, +)
+		COUNT_OP(OP_SUB_COUNT, -)
+		COUNT_OP(OP_MUL_COUNT, *)
+		CHECKED_OP(OP_DIV_COUNT, ForceAsUInt, val_mgr->Count, /, "division by zero")
+		CHECKED_OP(OP_MOD_COUNT, ForceAsUInt, val_mgr->Count, %, "modulo by zero")
+
+		DOUBLE_OP(OP_ADD_DOUBLE, +)
+		DOUBLE_OP(OP_SUB_DOUBLE, -)
+		DOUBLE_OP(OP_MUL_DOUBLE, *)
+
+		BINARY_OP(OP_DIV_DOUBLE,
+			if ( v2->InternalDouble() == 0 )
+				reporter->ExprRuntimeError(i.e, "division by zero");
+			r[i.a] = make_intrusive<Val>(v1->InternalDouble() / v2->InternalDouble(), TYPE_DOUBLE))
+
+		INT_REL(OP_LT_INT, <)
+		INT_REL(OP_LE_INT, <=)
+		INT_REL(OP_EQ_INT, ==)
+		INT_REL(OP_NE_INT, !=)
+		INT_REL(OP_GE_INT, >=)
+		INT_REL(OP_GT_INT, >)
+
+		COUNT_REL(OP_LT_COUNT, <)
+		COUNT_REL(OP_LE_COUNT, <=)
+		COUNT_REL(OP_EQ_COUNT, ==)
+		COUNT_REL(OP_NE_COUNT, !=)
+		COUNT_REL(OP_GE_COUNT, >=)
+		COUNT_REL(OP_GT_COUNT, >)
+
+		DOUBLE_REL(OP_LT_DOUBLE, <)
+		DOUBLE_REL(OP_LE_DOUBLE, <=)
+		DOUBLE_REL(OP_EQ_DOUBLE, ==)
+		DOUBLE_REL(OP_NE_DOUBLE, !=)
+		DOUBLE_REL(OP_GE_DOUBLE, >=)
+		DOUBLE_REL(OP_GT_DOUBLE, >)
+
+		BINARY_OP(OP_EQ_STRING,
+			r[i.a] = val_mgr->Bool(Bstr_eq(v1->AsString(), v2->AsString())))
+		BINARY_OP(OP_NE_STRING,
+			r[i.a] = val_mgr->Bool(! Bstr_eq(v1->AsString(), v2->AsString())))
+
+#undef BINARY_OP
+#undef INT_OP
+#undef COUNT_OP
+#undef DOUBLE_OP
+#undef INT_REL
+#undef COUNT_REL
+#undef DOUBLE_REL
+#undef CHECKED_OP
+		}
+		}
+	}
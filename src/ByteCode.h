@@ -0,0 +1,135 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <vector>
+
+#include "IntrusivePtr.h"
+#include "StmtEnums.h"
+
+class Expr;
+class Stmt;
+class Frame;
+class Val;
+class ID;
+
+// Whether BroFunc bodies get compiled into bytecode (--compile-scripts).
+extern bool compile_scripts;
+
+/**
+ * A function body lowered into code for a small register machine.
+ *
+ * The compiler covers the statements and expressions that dominate
+ * typical event handlers: statement lists, if, return, expression
+ * statements, constants, variables, assignments, record field access,
+ * table and vector lookups, set membership, calls, && / || / ?:, and
+ * arithmetic and comparisons on scalar int, count and double (and
+ * comparisons of strings). Everything else stays in the AST: the machine
+ * evaluates such expressions through Expr::Eval() and executes such
+ * statements through Stmt::Exec(), so that any body can be compiled and
+ * loops, switches, when and so on keep working as before.
+ *
+ * Registers hold the intermediate values that the AST would pass around
+ * as temporaries. Variables stay in the Frame, so that closures, triggers
+ * and the statements left to the AST see them as usual.
+ */
+class ByteCode {
+public:
+	/**
+	 * Compiles a function body.
+	 *
+	 * @param body The body, including its initializations.
+	 *
+	 * @return The compiled body, or nil if compiling it wouldn't gain
+	 * anything because all of it would be left to the AST anyway.
+	 */
+	static ByteCode* Compile(const Stmt* body);
+
+	~ByteCode();
+
+	/**
+	 * Executes the body in the given frame, with the same semantics as
+	 * Stmt::Exec() on the body.
+	 */
+	IntrusivePtr<Val> Exec(Frame* f, stmt_flow_type& flow) const;
+
+	/**
+	 * Returns the number of instructions, for debugging output.
+	 */
+	int NumInstructions() const	{ return code.size(); }
+
+private:
+	friend class ByteCodeCompiler;
+
+	enum Op {
+		OP_CONST,	// a = val
+		OP_LOCAL,	// a = local id
+		OP_GLOBAL,	// a = global id
+		OP_ACCESS,	// count an execution of stmt
+		OP_EVAL,	// a = e->Eval()
+		OP_EXEC,	// stmt->Exec(), return unless it flows on
+		OP_DISCARD,	// clear a, return if the frame got delayed
+
+		OP_ASSIGN_LOCAL,	// local id = a
+		OP_ASSIGN_GLOBAL,	// global id = a
+		OP_ASSIGN_FIELD,	// b$c = a, clears b
+
+		OP_FIELD,	// a = a$c
+		OP_HAS_FIELD,	// a = a?$c
+		OP_NOT,	// a = ! a
+
+		OP_LIST_ELEMENT,	// error if ! a
+		OP_LIST,	// a = [a, ..., a + c - 1]
+		OP_INDEX_TABLE,	// a = a[b]
+		OP_INDEX_VECTOR,	// a = a[b]
+		OP_IN_TABLE,	// a = a in b
+
+		OP_CALL_CACHED,	// a = value cached by trigger, jump to b
+		OP_CALL,	// a = a(b, ..., b + c - 1)
+
+		OP_JUMP,	// jump to b
+		OP_JUMP_IF_NULL,	// if ! a, clear c and jump to b
+		OP_JUMP_IF_FALSE,	// if ! a or a is zero, jump to b
+		OP_JUMP_IF_TRUE,	// if ! a or a is non-zero, jump to b
+
+		OP_RETURN,	// return a (or nothing if a < 0)
+		OP_FLOW,	// return nothing, with flow b
+		OP_END,	// fall off the end
+
+		// a = a <op> b, for b = a + 1, with the operands' type.
+		OP_ADD_INT, OP_SUB_INT, OP_MUL_INT, OP_DIV_INT, OP_MOD_INT,
+		OP_ADD_COUNT, OP_SUB_COUNT, OP_MUL_COUNT, OP_DIV_COUNT,
+		OP_MOD_COUNT,
+		OP_ADD_DOUBLE, OP_SUB_DOUBLE, OP_MUL_DOUBLE, OP_DIV_DOUBLE,
+
+		OP_LT_INT, OP_LE_INT, OP_EQ_INT, OP_NE_INT, OP_GE_INT, OP_GT_INT,
+		OP_LT_COUNT, OP_LE_COUNT, OP_EQ_COUNT, OP_NE_COUNT, OP_GE_COUNT,
+		OP_GT_COUNT,
+		OP_LT_DOUBLE, OP_LE_DOUBLE, OP_EQ_DOUBLE, OP_NE_DOUBLE,
+		OP_GE_DOUBLE, OP_GT_DOUBLE,
+		OP_EQ_STRING, OP_NE_STRING,
+	};
+
+	struct Instr {
+		Op op;
+		int a, b, c;
+
+		// For run-time errors, and for what's left to the AST.
+		const Expr* e;
+
+		union {
+			Val* val;
+			ID* id;
+			const Stmt* stmt;
+		};
+	};
+
+	// Registers up to this many live on the stack.
+	static constexpr int MAX_STACK_REGS = 16;
+
+	ByteCode() = default;
+
+	IntrusivePtr<Stmt> body;
+	std::vector<Instr> code;
+	int num_regs = 0;
+};
@@ -55,11 +55,68 @@ CompositeHash::CompositeHash(IntrusivePtr<TypeList> composite_type)
 		size = ComputeKeySize(nullptr, true, true);
 
 		if ( size > 0 )
+			{
 			// Fixed size.  Make sure what we get is fully aligned.
 			key = reinterpret_cast<char*>
 				(new double[size/sizeof(double) + 1]);
+
+			// Padding between values then stays zero for good,
+			// as the fast path never writes to it.
+			memset(key, 0, size);
+			}
 		else
 			key = nullptr;
+
+		if ( size > 0 && ! is_complex_type )
+			{
+			// Lay out the values the same way SingleValHash()
+			// does, so that keys are the same on either path.
+			int offset = 0;
+
+			for ( const auto& t : *type->Types() )
+				{
+				InternalTypeTag it = t->InternalType();
+				unsigned int align, width;
+
+				switch ( it ) {
+				case TYPE_INTERNAL_INT:
+				case TYPE_INTERNAL_UNSIGNED:
+					align = width = sizeof(bro_int_t);
+					break;
+
+				case TYPE_INTERNAL_ADDR:
+					align = sizeof(uint32_t);
+					width = 4 * sizeof(uint32_t);
+					break;
+
+				case TYPE_INTERNAL_SUBNET:
+					align = sizeof(uint32_t);
+					width = 5 * sizeof(uint32_t);
+					break;
+
+				case TYPE_INTERNAL_DOUBLE:
+					align = width = sizeof(double);
+					break;
+
+				default:
+					align = width = 0;
+					break;
+				}
+
+				if ( ! width )
+					{
+					fixed_fields.clear();
+					break;
+					}
+
+				int start = SizeAlign(offset, align) - align;
+				fixed_fields.push_back({t, it, start});
+				offset = start + width;
+				}
+
+			if ( offset != size )
+				fixed_fields.clear();
+			}
 		}
 	}
 
@@ -341,6 +398,9 @@ HashKey* CompositeHash::ComputeHash(const Val* v, bool type_check) const
 	if ( is_singleton )
 		return ComputeSingletonHash(v, type_check);
 
+	if ( ! fixed_fields.empty() )
+		return ComputeFixedHash(v, type_check);
+
 	if ( is_complex_type && v->Type()->Tag() != TYPE_LIST )
 		{
 		ListVal lv(TYPE_ANY);
@@ -387,6 +447,58 @@ HashKey* CompositeHash::ComputeHash(const Val* v, bool type_check) const
 	return new HashKey((k == key), (void*) k, kp - k);
 	}
 
+HashKey* CompositeHash::ComputeFixedHash(const Val* v, bool type_check) const
+	{
+	if ( type_check && v->Type()->Tag() != TYPE_LIST )
+		return nullptr;
+
+	const val_list* vl = v->AsListVal()->Vals();
+	if ( type_check && vl->length() != static_cast<int>(fixed_fields.size()) )
+		return nullptr;
+
+	for ( size_t i = 0; i < fixed_fields.size(); ++i )
+		{
+		const FixedField& f = fixed_fields[i];
+		const Val* fv = (*vl)[i];
+		char* kp = key + f.offset;
+
+		if ( type_check && fv->Type()->InternalType() != f.tag )
+			return nullptr;
+
+		switch ( f.tag ) {
+		case TYPE_INTERNAL_INT:
+			*reinterpret_cast<bro_int_t*>(kp) = fv->ForceAsInt();
+			break;
+
+		case TYPE_INTERNAL_UNSIGNED:
+			*reinterpret_cast<bro_uint_t*>(kp) = fv->ForceAsUInt();
+			break;
+
+		case TYPE_INTERNAL_ADDR:
+			fv->AsAddr().CopyIPv6(reinterpret_cast<uint32_t*>(kp));
+			break;
+
+		case TYPE_INTERNAL_SUBNET:
+			{
+			uint32_t* kp32 = reinterpret_cast<uint32_t*>(kp);
+			fv->AsSubNet().Prefix().CopyIPv6(kp32);
+			kp32[4] = fv->AsSubNet().Length();
+			}
+			break;
+
+		case TYPE_INTERNAL_DOUBLE:
+			*reinterpret_cast<double*>(kp) = fv->InternalDouble();
+			break;
+
+		default:
+			reporter->InternalError("bad fixed index type in CompositeHash::ComputeFixedHash()");
+			break;
+		}
+		}
+
+	return new HashKey(true, (void*) key, size);
+	}
+
 HashKey* CompositeHash::ComputeSingletonHash(const Val* v, bool type_check) const
 	{
 	if ( v->Type()->Tag() == TYPE_LIST )
@@ -714,8 +826,49 @@ int CompositeHash::SizeAlign(int offset, unsigned int size) const
 	return offset;
 	}
 
+IntrusivePtr<ListVal> CompositeHash::RecoverFixedVals(const HashKey* k) const
+	{
+	auto l = make_intrusive<ListVal>(TYPE_ANY);
+	const char* kp = (const char*) k->Key();
+	const char* const k_end = kp + k->Size();
+
+	for ( const auto& f : fixed_fields )
+		{
+		const char* fp = kp + f.offset;
+		IntrusivePtr<Val> v;
+
+		// Handle the common ones directly, the others are all simple
+		// enough for RecoverOneVal() to not need any parsing either.
+		switch ( f.type->Tag() ) {
+		case TYPE_ADDR:
+			v = make_intrusive<AddrVal>(IPAddr(IPv6, reinterpret_cast<const uint32_t*>(fp), IPAddr::Network));
+			break;
+
+		case TYPE_PORT:
+			v = val_mgr->Port(*reinterpret_cast<const bro_uint_t*>(fp));
+			break;
+
+		case TYPE_COUNT:
+			v = val_mgr->Count(*reinterpret_cast<const bro_uint_t*>(fp));
+			break;
+
+		default:
+			RecoverOneVal(k, fp, k_end, f.type, &v, false);
+			break;
+		}
+
+		ASSERT(v);
+		l->Append(v.release());
+		}
+
+	return l;
+	}
+
 IntrusivePtr<ListVal> CompositeHash::RecoverVals(const HashKey* k) const
 	{
+	if ( ! fixed_fields.empty() && k->Size() == size )
+		return RecoverFixedVals(k);
+
 	auto l = make_intrusive<ListVal>(TYPE_ANY);
 	const type_list* tl = type->Types();
 	const char* kp = (const char*) k->Key();
@@ -5,6 +5,8 @@
 #include "Type.h"
 #include "IntrusivePtr.h"
 
+#include <vector>
+
 class ListVal;
 class HashKey;
 
@@ -25,6 +27,12 @@ public:
 protected:
 	HashKey* ComputeSingletonHash(const Val* v, bool type_check) const;
 
+	// Fast paths for indices made up solely of fixed-width types, such
+	// as [addr, port] or [addr, addr]: the values go straight to their
+	// precomputed offsets in the key.
+	HashKey* ComputeFixedHash(const Val* v, bool type_check) const;
+	IntrusivePtr<ListVal> RecoverFixedVals(const HashKey* k) const;
+
 	// Computes the piece of the hash for Val*, returning the new kp.
 	// Used as a helper for ComputeHash in the non-singleton case.
 	char* SingleValHash(bool type_check, char* kp, BroType* bt, Val* v,
@@ -88,4 +96,14 @@ protected:
 	bool is_complex_type;
 
 	InternalTypeTag singleton_tag;
+
+	// For fixed-width indices, where each of the index's values goes
+	// in the key. Empty if the index doesn't qualify.
+	struct FixedField {
+		BroType* type;
+		InternalTypeTag tag;
+		int offset;
+	};
+
+	std::vector<FixedField> fixed_fields;
 };
@@ -5,6 +5,7 @@
 #include "Conn.h"
 
 #include <ctype.h>
+#include <utility>
 
 #include "Desc.h"
 #include "Net.h"
@@ -94,6 +95,9 @@ Connection::Connection(NetSessions* s, const ConnIDKey& k, double t, const ConnI
 
 	is_active = 1;
 	skip = 0;
+	bypassed = 0;
+	bypassed_pkts[0] = bypassed_pkts[1] = 0;
+	bypassed_bytes[0] = bypassed_bytes[1] = 0;
 	weird = 0;
 
 	suppress_event = 0;
@@ -219,6 +223,15 @@ void Connection::NextPacket(double t, bool is_orig,
 	current_pkt = nullptr;
 	}
 
+void Connection::BypassedPacket(double t, bool is_orig, int len)
+	{
+	last_time = t;
+
+	int i = is_orig ? 0 : 1;
+	++bypassed_pkts[i];
+	bypassed_bytes[i] += len;
+	}
+
 void Connection::SetLifetime(double lifetime)
 	{
 	ADD_TIMER(&Connection::DeleteTimer, network_time + lifetime, 0,
@@ -353,15 +366,15 @@ const IntrusivePtr<RecordVal>& Connection::ConnVal()
 		TransportProto prot_type = ConnTransport();
 
 		auto id_val = make_intrusive<RecordVal>(conn_id);
-		id_val->Assign(0, make_intrusive<AddrVal>(orig_addr));
+		id_val->AssignAddr(0, orig_addr);
 		id_val->Assign(1, val_mgr->Port(ntohs(orig_port), prot_type));
-		id_val->Assign(2, make_intrusive<AddrVal>(resp_addr));
+		id_val->AssignAddr(2, resp_addr);
 		id_val->Assign(3, val_mgr->Port(ntohs(resp_port), prot_type));
 
 		auto orig_endp = make_intrusive<RecordVal>(endpoint);
-		orig_endp->Assign(0, val_mgr->Count(0));
-		orig_endp->Assign(1, val_mgr->Count(0));
-		orig_endp->Assign(4, val_mgr->Count(orig_flow_label));
+		orig_endp->AssignCount(0, 0);
+		orig_endp->AssignCount(1, 0);
+		orig_endp->AssignCount(4, orig_flow_label);
 
 		const int l2_len = sizeof(orig_l2_addr);
 		char null[l2_len]{};
@@ -370,9 +383,9 @@ const IntrusivePtr<RecordVal>& Connection::ConnVal()
 			orig_endp->Assign(5, make_intrusive<StringVal>(fmt_mac(orig_l2_addr, l2_len)));
 
 		auto resp_endp = make_intrusive<RecordVal>(endpoint);
-		resp_endp->Assign(0, val_mgr->Count(0));
-		resp_endp->Assign(1, val_mgr->Count(0));
-		resp_endp->Assign(4, val_mgr->Count(resp_flow_label));
+		resp_endp->AssignCount(0, 0);
+		resp_endp->AssignCount(1, 0);
+		resp_endp->AssignCount(4, resp_flow_label);
 
 		if ( memcmp(&resp_l2_addr, &null, l2_len) != 0 )
 			resp_endp->Assign(5, make_intrusive<StringVal>(fmt_mac(resp_l2_addr, l2_len)));
@@ -403,10 +416,10 @@ const IntrusivePtr<RecordVal>& Connection::ConnVal()
 	if ( root_analyzer )
 		root_analyzer->UpdateConnVal(conn_val.get());
 
-	conn_val->Assign(3, make_intrusive<Val>(start_time, TYPE_TIME));	// ###
-	conn_val->Assign(4, make_intrusive<Val>(last_time - start_time, TYPE_INTERVAL));
+	conn_val->AssignDouble(3, start_time);	// ###
+	conn_val->AssignDouble(4, last_time - start_time);
 	conn_val->Assign(6, make_intrusive<StringVal>(history.c_str()));
-	conn_val->Assign(11, val_mgr->Bool(is_successful));
+	conn_val->AssignBool(11, is_successful);
 
 	conn_val->SetOrigin(this);
 
@@ -603,6 +616,9 @@ void Connection::FlipRoles()
 	resp_flow_label = orig_flow_label;
 	orig_flow_label = tmp_flow;
 
+	std::swap(bypassed_pkts[0], bypassed_pkts[1]);
+	std::swap(bypassed_bytes[0], bypassed_bytes[1]);
+
 	conn_val = nullptr;
 
 	if ( root_analyzer )
@@ -16,6 +16,7 @@
 #include "WeirdState.h"
 #include "ZeekArgs.h"
 #include "IntrusivePtr.h"
+#include "Slab.h"
 #include "iosource/Packet.h"
 
 #include "analyzer/Tag.h"
@@ -59,7 +60,7 @@ static inline int addr_port_canon_lt(const IPAddr& addr1, uint32_t p1,
 
 namespace analyzer { class Analyzer; }
 
-class Connection final : public BroObj {
+class Connection final : public BroObj, public SlabAllocated {
 public:
 	Connection(NetSessions* s, const ConnIDKey& k, double t, const ConnID* id,
 	           uint32_t flow, const Packet* pkt, const EncapsulationStack* arg_encap);
@@ -148,6 +149,23 @@ public:
 	void SetSkip(bool do_skip)		{ skip = do_skip ? 1 : 0; }
 	bool Skipping() const			{ return skip; }
 
+	// If true, the connection's packets bypass all analysis: they only
+	// update its timestamps and its packet and byte counts.  Use
+	// NetSessions::Bypass() to turn it on.
+	void SetBypassed()			{ bypassed = 1; }
+	bool IsBypassed() const			{ return bypassed; }
+
+	// Accounts for a packet that bypassed analysis; len is its IP
+	// length.
+	void BypassedPacket(double t, bool is_orig, int len);
+
+	// Returns the number of packets, and their IP bytes, that bypassed
+	// analysis in the given direction.
+	uint64_t BypassedPackets(bool is_orig) const
+		{ return bypassed_pkts[is_orig ? 0 : 1]; }
+	uint64_t BypassedBytes(bool is_orig) const
+		{ return bypassed_bytes[is_orig ? 0 : 1]; }
+
 	// Arrange for the connection to expire after the given amount of time.
 	void SetLifetime(double lifetime);
 
@@ -364,6 +382,7 @@ protected:
 	unsigned int timers_canceled:1;
 	unsigned int is_active:1;
 	unsigned int skip:1;
+	unsigned int bypassed:1;
 	unsigned int weird:1;
 	unsigned int finished:1;
 	unsigned int record_packets:1, record_contents:1;
@@ -375,6 +394,9 @@ protected:
 	static uint64_t total_connections;
 	static uint64_t current_connections;
 
+	uint64_t bypassed_pkts[2];	// Originator first.
+	uint64_t bypassed_bytes[2];
+
 	std::string history;
 	uint32_t hist_seen;
 
@@ -0,0 +1,309 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ConnTable.h"
+
+#include <algorithm>
+
+#include "util.h"
+
+#include "3rdparty/doctest.h"
+
+ConnTable::ConnTable()
+	{
+	cur.hashes.resize(INITIAL_SLOTS, EMPTY);
+	cur.entries.resize(INITIAL_SLOTS);
+	}
+
+ssize_t ConnTable::Array::Find(const ConnIDKey& key, hash_t h) const
+	{
+	if ( hashes.empty() )
+		return -1;
+
+	size_t mask = Mask();
+
+	for ( size_t i = h & mask; hashes[i] != EMPTY; i = (i + 1) & mask )
+		{
+		if ( hashes[i] == h && entries[i].key == key )
+			return i;
+		}
+
+	return -1;
+	}
+
+Connection* ConnTable::Lookup(const ConnIDKey& key, hash_t hash) const
+	{
+	hash = SlotHash(hash);
+
+	ssize_t i = cur.Find(key, hash);
+
+	if ( i >= 0 )
+		return cur.entries[i].conn;
+
+	i = old.Find(key, hash);
+
+	if ( i >= 0 )
+		return old.entries[i].conn;
+
+	return nullptr;
+	}
+
+Connection* ConnTable::Insert(const ConnIDKey& key, hash_t hash, Connection* conn)
+	{
+	hash = SlotHash(hash);
+
+	if ( Resizing() )
+		Migrate(MIGRATE_SLOTS);
+
+	Connection* prev = nullptr;
+	ssize_t i = old.Find(key, hash);
+
+	if ( i >= 0 )
+		{
+		// Move it over right away.
+		prev = old.entries[i].conn;
+		old.hashes[i] = REMOVED;
+		--old.num_entries;
+		}
+
+	else if ( (i = cur.Find(key, hash)) >= 0 )
+		{
+		prev = cur.entries[i].conn;
+		cur.entries[i].conn = conn;
+		return prev;
+		}
+
+	if ( 4 * (cur.num_entries + 1) > 3 * cur.hashes.size() )
+		Grow();
+
+	Place(key, hash, conn);
+	return prev;
+	}
+
+Connection* ConnTable::Remove(const ConnIDKey& key, hash_t hash)
+	{
+	hash = SlotHash(hash);
+
+	if ( Resizing() )
+		Migrate(MIGRATE_SLOTS);
+
+	ssize_t i = cur.Find(key, hash);
+
+	if ( i >= 0 )
+		{
+		Connection* conn = cur.entries[i].conn;
+		RemoveAt(i);
+		return conn;
+		}
+
+	i = old.Find(key, hash);
+
+	if ( i >= 0 )
+		{
+		old.hashes[i] = REMOVED;
+		--old.num_entries;
+		return old.entries[i].conn;
+		}
+
+	return nullptr;
+	}
+
+size_t ConnTable::MemoryAllocation() const
+	{
+	return padded_sizeof(*this)
+		+ (cur.hashes.capacity() + old.hashes.capacity()) * sizeof(hash_t)
+		+ (cur.entries.capacity() + old.entries.capacity()) * sizeof(Entry);
+	}
+
+void ConnTable::Grow()
+	{
+	// Growing again before the previous round finished can only
+	// happen with lots of insertions and few slots moved per each;
+	// finish it first.
+	if ( Resizing() )
+		Migrate(old.hashes.size());
+
+	size_t size = 2 * cur.hashes.size();
+
+	old = std::move(cur);
+	cur = Array();
+	cur.hashes.resize(size, EMPTY);
+	cur.entries.resize(size);
+	migrate_pos = 0;
+	}
+
+void ConnTable::Migrate(size_t num_slots)
+	{
+	size_t end = std::min(migrate_pos + num_slots, old.hashes.size());
+
+	for ( ; migrate_pos < end; ++migrate_pos )
+		{
+		hash_t h = old.hashes[migrate_pos];
+
+		if ( h == EMPTY || h == REMOVED )
+			continue;
+
+		const Entry& e = old.entries[migrate_pos];
+		Place(e.key, h, e.conn);
+
+		// Leave a marker rather than an empty slot, so that lookups
+		// still find the entries after it in the same cluster.
+		old.hashes[migrate_pos] = REMOVED;
+		--old.num_entries;
+		}
+
+	if ( migrate_pos == old.hashes.size() )
+		{
+		old = Array();
+		migrate_pos = 0;
+		}
+	}
+
+void ConnTable::Place(const ConnIDKey& key, hash_t h, Connection* conn)
+	{
+	size_t mask = cur.Mask();
+	size_t i = h & mask;
+
+	while ( cur.hashes[i] != EMPTY )
+		i = (i + 1) & mask;
+
+	cur.hashes[i] = h;
+	cur.entries[i].key = key;
+	cur.entries[i].conn = conn;
+	++cur.num_entries;
+	}
+
+void ConnTable::RemoveAt(size_t pos)
+	{
+	size_t mask = cur.Mask();
+	size_t i = pos;
+
+	for ( size_t j = (i + 1) & mask; cur.hashes[j] != EMPTY; j = (j + 1) & mask )
+		{
+		// An entry can move back to the hole at i only if its home
+		// slot isn't cyclically in (i, j].
+		size_t home = cur.hashes[j] & mask;
+
+		if ( ((j - home) & mask) >= ((j - i) & mask) )
+			{
+			cur.hashes[i] = cur.hashes[j];
+			cur.entries[i] = cur.entries[j];
+			i = j;
+			}
+		}
+
+	cur.hashes[i] = EMPTY;
+	--cur.num_entries;
+	}
+
+std::vector<Connection*> ConnTable::SortedByKey() const
+	{
+	std::vector<const Entry*> sorted;
+	sorted.reserve(Size());
+
+	for ( const Array* a : { &cur, &old } )
+		for ( size_t i = 0; i < a->hashes.size(); ++i )
+			if ( a->hashes[i] != EMPTY && a->hashes[i] != REMOVED )
+				sorted.push_back(&a->entries[i]);
+
+	std::sort(sorted.begin(), sorted.end(),
+		  [](const Entry* a, const Entry* b) { return a->key < b->key; });
+
+	std::vector<Connection*> conns;
+	conns.reserve(sorted.size());
+
+	for ( auto e : sorted )
+		conns.push_back(e->conn);
+
+	return conns;
+	}
+
+Connection* ConnTable::const_iterator::operator*() const
+	{
+	size_t n = table->cur.hashes.size();
+
+	if ( pos < n )
+		return table->cur.entries[pos].conn;
+
+	return table->old.entries[pos - n].conn;
+	}
+
+void ConnTable::const_iterator::Skip()
+	{
+	size_t n = table->cur.hashes.size();
+	size_t total = n + table->old.hashes.size();
+
+	for ( ; pos < total; ++pos )
+		{
+		hash_t h = pos < n ? table->cur.hashes[pos] : table->old.hashes[pos - n];
+
+		if ( h != EMPTY && h != REMOVED )
+			break;
+		}
+	}
+
+TEST_CASE("conn table")
+	{
+	ConnTable t;
+	std::vector<ConnIDKey> keys(10000);
+
+	auto conn = [](size_t i) { return reinterpret_cast<Connection*>(i + 1); };
+
+	for ( size_t i = 0; i < keys.size(); ++i )
+		{
+		keys[i].port1 = i & 0xffff;
+		keys[i].port2 = i >> 16;
+		keys[i].ip1.s6_addr[15] = i % 7;
+		CHECK(t.Insert(keys[i], conn(i)) == nullptr);
+		}
+
+	CHECK(t.Size() == keys.size());
+
+	// Replacing keeps the size.
+	CHECK(t.Insert(keys[42], conn(4242)) == conn(42));
+	CHECK(t.Lookup(keys[42]) == conn(4242));
+	CHECK(t.Size() == keys.size());
+	t.Insert(keys[42], conn(42));
+
+	for ( size_t i = 0; i < keys.size(); i += 2 )
+		CHECK(t.Remove(keys[i]) == conn(i));
+
+	CHECK(t.Remove(keys[0]) == nullptr);
+	CHECK(t.Size() == keys.size() / 2);
+
+	size_t found = 0;
+
+	for ( size_t i = 0; i < keys.size(); ++i )
+		{
+		if ( t.Lookup(keys[i]) == (i % 2 ? conn(i) : nullptr) )
+			++found;
+		}
+
+	CHECK(found == keys.size());
+
+	size_t iterated = 0;
+
+	for ( auto c : t )
+		{
+		CHECK(reinterpret_cast<size_t>(c) % 2 == 0);
+		++iterated;
+		}
+
+	CHECK(iterated == t.Size());
+
+	auto key = [&keys](Connection* c)
+		{ return keys[reinterpret_cast<size_t>(c) - 1]; };
+
+	auto sorted = t.SortedByKey();
+	CHECK(sorted.size() == t.Size());
+
+	for ( size_t i = 1; i < sorted.size(); ++i )
+		CHECK(key(sorted[i - 1]) < key(sorted[i]));
+
+	for ( size_t i = 1; i < keys.size(); i += 2 )
+		t.Remove(keys[i]);
+
+	CHECK(t.Size() == 0);
+	CHECK(! (t.begin() != t.end()));
+	}
@@ -0,0 +1,167 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <vector>
+
+#include <sys/types.h>
+
+#include "IPAddr.h"
+#include "Hash.h"
+
+class Connection;
+
+/**
+ * A hash table mapping connection keys to connections, as NetSessions
+ * keeps one per transport protocol.
+ *
+ * The table uses open addressing with linear probing. The hashes live in
+ * an array of their own, separate from the keys and connections, so that
+ * probing touches as few cache lines as possible and compares keys only
+ * once a full hash matches. Removal shifts the rest of a cluster back
+ * rather than leaving tombstones.
+ *
+ * Growing doesn't rehash all entries at once: the table allocates an
+ * array twice the size and then moves a few slots over from the old one
+ * on every insertion and removal, with lookups checking both until the
+ * old one is empty. That way, a table with millions of connections
+ * doesn't stall packet processing when it needs to grow.
+ *
+ * Callers that look up a key and then insert it may compute its hash
+ * once with Hash() and pass it to both.
+ */
+class ConnTable {
+public:
+	ConnTable();
+
+	/**
+	 * Returns the hash of a key, for use with the methods below.
+	 */
+	static hash_t Hash(const ConnIDKey& key)
+		{ return HashKey::HashBytes(&key, sizeof(key)); }
+
+	/**
+	 * Returns the connection with the given key, or null if none.
+	 */
+	Connection* Lookup(const ConnIDKey& key, hash_t hash) const;
+	Connection* Lookup(const ConnIDKey& key) const
+		{ return Lookup(key, Hash(key)); }
+
+	/**
+	 * Inserts a connection, replacing any with the same key.
+	 *
+	 * @return The connection replaced, or null if none.
+	 */
+	Connection* Insert(const ConnIDKey& key, hash_t hash, Connection* conn);
+	Connection* Insert(const ConnIDKey& key, Connection* conn)
+		{ return Insert(key, Hash(key), conn); }
+
+	/**
+	 * Removes the connection with the given key.
+	 *
+	 * @return The connection removed, or null if none.
+	 */
+	Connection* Remove(const ConnIDKey& key, hash_t hash);
+	Connection* Remove(const ConnIDKey& key)
+		{ return Remove(key, Hash(key)); }
+
+	/**
+	 * Returns the number of connections in the table.
+	 */
+	size_t Size() const	{ return cur.num_entries + old.num_entries; }
+
+	/**
+	 * Returns the number of bytes allocated for the table itself, not
+	 * counting the connections.
+	 */
+	size_t MemoryAllocation() const;
+
+	/**
+	 * Returns true while the table is moving entries into a larger
+	 * array. For diagnostics.
+	 */
+	bool Resizing() const	{ return ! old.hashes.empty(); }
+
+	/**
+	 * Returns the connections ordered by their keys. Where the order is
+	 * visible to scripts, such as at termination, this keeps it the same
+	 * from run to run.
+	 */
+	std::vector<Connection*> SortedByKey() const;
+
+	/**
+	 * Iterates over the connections, in no particular order. The table
+	 * must not be changed while iterating.
+	 */
+	class const_iterator {
+	public:
+		Connection* operator*() const;
+		const_iterator& operator++()	{ ++pos; Skip(); return *this; }
+		bool operator!=(const const_iterator& other) const
+			{ return pos != other.pos; }
+
+	private:
+		friend class ConnTable;
+
+		const_iterator(const ConnTable* t, size_t arg_pos)
+			: table(t), pos(arg_pos)	{ Skip(); }
+
+		// Advances to the next slot holding a connection. Positions
+		// past the current array's end index into the old one.
+		void Skip();
+
+		const ConnTable* table;
+		size_t pos;
+	};
+
+	const_iterator begin() const	{ return const_iterator(this, 0); }
+	const_iterator end() const
+		{ return const_iterator(this, cur.hashes.size() + old.hashes.size()); }
+
+private:
+	// Hashes of 0 and 1 mark empty and removed slots; real hashes get
+	// mapped around them.
+	static constexpr hash_t EMPTY = 0;
+	static constexpr hash_t REMOVED = 1;
+
+	static hash_t SlotHash(hash_t h)	{ return h < 2 ? h + 2 : h; }
+
+	struct Entry {
+		ConnIDKey key;
+		Connection* conn;
+	};
+
+	struct Array {
+		std::vector<hash_t> hashes;	// Size is a power of two.
+		std::vector<Entry> entries;
+		size_t num_entries = 0;
+
+		size_t Mask() const	{ return hashes.size() - 1; }
+
+		// Returns the slot holding the key, or -1 if none.
+		ssize_t Find(const ConnIDKey& key, hash_t h) const;
+	};
+
+	// Starts moving the entries into an array twice the size.
+	void Grow();
+
+	// Moves up to the given number of slots from the old array into the
+	// current one, freeing the old one once it's done.
+	void Migrate(size_t num_slots);
+
+	// Places an entry known not to be present into the current array.
+	void Place(const ConnIDKey& key, hash_t h, Connection* conn);
+
+	// Removes the entry at the given slot of the current array, shifting
+	// back the entries after it that would otherwise become unreachable.
+	void RemoveAt(size_t pos);
+
+	Array cur;
+	Array old;	// Not empty while growing; only gets removals.
+	size_t migrate_pos = 0;	// Next slot of the old array to move.
+
+	// Slots to move per insertion or removal while growing. With growth
+	// at 3/4 load, that finishes before the new array fills up.
+	static constexpr size_t MIGRATE_SLOTS = 4;
+	static constexpr size_t INITIAL_SLOTS = 64;
+};
@@ -6,18 +6,41 @@
 #include "EquivClass.h"
 #include "Desc.h"
 #include "digest.h"
+#include "Reporter.h"
+
+#include <unordered_set>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+int dfa_precompile_states = 0;
+std::string dfa_cache_dir;
+
+// Identifies files written by DFA_Machine::Save(); bump the version when
+// anything changes about how machines get built.
+static const uint32_t DFA_CACHE_MAGIC = 0x5a444641;	// "ZDFA"
+static const uint32_t DFA_CACHE_VERSION = 1;
 
 unsigned int DFA_State::transition_counter = 0;
 
 DFA_State::DFA_State(int arg_state_num, const EquivClass* ec,
 			NFA_state_list* arg_nfa_states,
-			AcceptingSet* arg_accept)
+			AcceptingSet* arg_accept, DFA_Machine* arg_machine)
 	{
 	state_num = arg_state_num;
 	num_sym = ec->NumClasses();
 	nfa_states = arg_nfa_states;
 	accept = arg_accept;
+	machine = arg_machine;
 	mark = nullptr;
+	compact_row = -1;
+	compact_uncomputed = 0;
 
 	SymPartition(ec);
 
@@ -27,6 +50,25 @@ DFA_State::DFA_State(int arg_state_num, const EquivClass* ec,
 		xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
 	}
 
+DFA_State::DFA_State(int arg_state_num, int arg_num_sym, AcceptingSet* arg_accept,
+			DFA_Machine* arg_machine)
+	{
+	state_num = arg_state_num;
+	num_sym = arg_num_sym;
+	nfa_states = nullptr;
+	accept = arg_accept;
+	machine = arg_machine;
+	meta_ec = nullptr;
+	mark = nullptr;
+	compact_row = -1;
+	compact_uncomputed = 0;
+
+	xtions = new DFA_State*[num_sym];
+
+	for ( int i = 0; i < num_sym; ++i )
+		xtions[i] = nullptr;
+	}
+
 DFA_State::~DFA_State()
 	{
 	delete [] xtions;
@@ -75,6 +117,9 @@ void DFA_State::SymPartition(const EquivClass* ec)
 
 DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 	{
+	// States loaded from the cache have all their transitions.
+	assert(meta_ec);
+
 	int equiv_sym = meta_ec->EquivRep(sym);
 	if ( xtions[equiv_sym] != DFA_UNCOMPUTED_STATE_PTR )
 		{
@@ -186,10 +231,10 @@ void DFA_State::ClearMarks()
 
 		for ( int i = 0; i < num_sym; ++i )
 			{
-			DFA_State* s = xtions[i];
+			DFA_State* s = Next(i);
 
 			if ( s && s != DFA_UNCOMPUTED_STATE_PTR )
-				xtions[i]->ClearMarks();
+				s->ClearMarks();
 			}
 		}
 	}
@@ -219,7 +264,7 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m)
 	int num_trans = 0;
 	for ( int sym = 0; sym < num_sym; ++sym )
 		{
-		DFA_State* s = xtions[sym];
+		DFA_State* s = Next(sym);
 
 		if ( ! s )
 			continue;
@@ -227,7 +272,7 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m)
 		// Look ahead for compression.
 		int i;
 		for ( i = sym + 1; i < num_sym; ++i )
-			if ( xtions[i] != s )
+			if ( Next(i) != s )
 				break;
 
 		char xbuf[512];
@@ -259,7 +304,7 @@ void DFA_State::Dump(FILE* f, DFA_Machine* m)
 
 	for ( int sym = 0; sym < num_sym; ++sym )
 		{
-		DFA_State* s = xtions[sym];
+		DFA_State* s = Next(sym);
 
 		if ( s && s != DFA_UNCOMPUTED_STATE_PTR )
 			s->Dump(f, m);
@@ -270,7 +315,7 @@ void DFA_State::Stats(unsigned int* computed, unsigned int* uncomputed)
 	{
 	for ( int sym = 0; sym < num_sym; ++sym )
 		{
-		DFA_State* s = xtions[sym];
+		DFA_State* s = Next(sym);
 
 		if ( s == DFA_UNCOMPUTED_STATE_PTR )
 			(*uncomputed)++;
@@ -282,7 +327,7 @@ void DFA_State::Stats(unsigned int* computed, unsigned int* uncomputed)
 unsigned int DFA_State::Size()
 	{
 	return sizeof(*this)
-		+ pad_size(sizeof(DFA_State*) * num_sym)
+		+ (xtions ? pad_size(sizeof(DFA_State*) * num_sym) : 0)
 		+ (accept ? pad_size(sizeof(int) * accept->size()) : 0)
 		+ (nfa_states ? pad_size(sizeof(NFA_State*) * nfa_states->length()) : 0)
 		+ (meta_ec ? meta_ec->Size() : 0);
@@ -383,6 +428,7 @@ DFA_Machine::DFA_Machine(NFA_Machine* n, EquivClass* arg_ec)
 	Ref(n);
 
 	ec = arg_ec;
+	compact_width = ec->NumClasses();
 
 	dfa_state_cache = new DFA_State_Cache();
 
@@ -426,10 +472,340 @@ unsigned int DFA_Machine::MemoryAllocation() const
 	// FIXME: Count *ec?
 	return padded_sizeof(*this)
 		+ s.mem
+		+ pad_size(compact.capacity() * sizeof(uint32_t))
+		+ pad_size(compact_states.capacity() * sizeof(DFA_State*))
+		+ pad_size(accel.capacity() * sizeof(Accel))
 		+ padded_sizeof(*start_state)
 		+ nfa->MemoryAllocation();
 	}
 
+uint32_t DFA_Machine::CompactID(DFA_State* s)
+	{
+	if ( ! s )
+		return COMPACT_JAM;
+
+	if ( s->compact_row < 0 )
+		{
+		s->compact_row = compact_states.size();
+		s->compact_uncomputed = compact_width;
+		compact_states.push_back(s);
+		compact.resize(compact.size() + compact_width, COMPACT_UNCOMPUTED);
+		accel.push_back({-1, {}});
+		}
+
+	uint32_t id = static_cast<uint32_t>(s->compact_row) << 1;
+
+	if ( s->Accept() )
+		id |= COMPACT_ACCEPT;
+
+	return id;
+	}
+
+uint32_t DFA_Machine::ComputeCompactXtion(uint32_t id, int sym)
+	{
+	DFA_State* s = compact_states[id >> 1];
+	uint32_t next_id = CompactID(s->Xtion(sym, this));
+	compact[(id >> 1) * compact_width + sym] = next_id;
+
+	if ( --s->compact_uncomputed == 0 )
+		{
+		// The row has all of the state's transitions now, so
+		// don't keep them twice.
+		delete [] s->xtions;
+		s->xtions = nullptr;
+		}
+
+	return next_id;
+	}
+
+const u_char* DFA_Machine::DoAccelerate(uint32_t id, const u_char* p, const u_char* end)
+	{
+	if ( accel[id >> 1].num_bytes < 0 )
+		{
+		// Find the bytes that leave the state. Note that computing
+		// the transitions may grow the vectors.
+		u_char bytes[MAX_ACCEL_BYTES] = { };
+		int n = 0;
+		const int* ecs = ec->EquivClasses();
+
+		if ( ! (id & COMPACT_ACCEPT) )
+			{
+			for ( int c = 0; c < 256 && n <= MAX_ACCEL_BYTES; ++c )
+				if ( CompactXtion(id, ecs[c]) != id )
+					{
+					if ( n < MAX_ACCEL_BYTES )
+						bytes[n] = c;
+
+					++n;
+					}
+			}
+
+		Accel& a = accel[id >> 1];
+		a.num_bytes = (n > 0 && n <= MAX_ACCEL_BYTES) ? n : 0;
+		memcpy(a.bytes, bytes, sizeof(bytes));
+
+		if ( a.num_bytes == 0 )
+			return p;
+		}
+
+	const Accel& a = accel[id >> 1];
+
+	if ( a.num_bytes == 1 )
+		{
+		auto q = static_cast<const u_char*>(memchr(p, a.bytes[0], end - p));
+		return q ? q : end;
+		}
+
+	u_char b0 = a.bytes[0];
+	u_char b1 = a.bytes[1];
+	u_char b2 = a.num_bytes > 2 ? a.bytes[2] : b1;
+
+#ifdef __SSE2__
+	__m128i v0 = _mm_set1_epi8(b0);
+	__m128i v1 = _mm_set1_epi8(b1);
+	__m128i v2 = _mm_set1_epi8(b2);
+
+	while ( end - p >= 16 )
+		{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, v0),
+		                                      _mm_cmpeq_epi8(x, v1)),
+		                         _mm_cmpeq_epi8(x, v2));
+		int mask = _mm_movemask_epi8(m);
+
+		if ( mask )
+			return p + __builtin_ctz(mask);
+
+		p += 16;
+		}
+#endif
+
+	for ( ; p < end; ++p )
+		if ( *p == b0 || *p == b1 || *p == b2 )
+			return p;
+
+	return end;
+	}
+
+void DFA_Machine::ResetCompact()
+	{
+	for ( auto s : compact_states )
+		{
+		if ( ! s->xtions )
+			{
+			auto xtions = new DFA_State*[s->num_sym];
+
+			for ( int sym = 0; sym < s->num_sym; ++sym )
+				xtions[sym] = s->Next(sym);
+
+			s->xtions = xtions;
+			}
+
+		s->compact_row = -1;
+		}
+
+	compact.clear();
+	compact_states.clear();
+	accel.clear();
+	}
+
+bool DFA_Machine::ReachableStates(int max_states, std::vector<DFA_State*>* states)
+	{
+	if ( ! start_state )
+		return true;
+
+	std::unordered_set<DFA_State*> seen;
+	seen.insert(start_state);
+	states->push_back(start_state);
+
+	for ( size_t i = 0; i < states->size(); ++i )
+		{
+		DFA_State* s = (*states)[i];
+
+		for ( int sym = 0; sym < s->num_sym; ++sym )
+			{
+			if ( s->Next(sym) == DFA_UNCOMPUTED_STATE_PTR &&
+			     NumStates() >= max_states )
+				return false;
+
+			DFA_State* next = s->Xtion(sym, this);
+
+			if ( next && seen.insert(next).second )
+				states->push_back(next);
+			}
+		}
+
+	return true;
+	}
+
+bool DFA_Machine::Determinize(int max_states)
+	{
+	std::vector<DFA_State*> states;
+	return ReachableStates(max_states, &states);
+	}
+
+bool DFA_Machine::Save(const std::string& path)
+	{
+	std::vector<DFA_State*> states;
+	if ( ! ReachableStates(NumStates(), &states) )
+		return false;
+
+	std::map<DFA_State*, int32_t> index;
+	for ( size_t i = 0; i < states.size(); ++i )
+		index[states[i]] = i;
+
+	// Write to a temporary file first, so that concurrent readers
+	// never see a partial one.
+	std::string tmp = fmt("%s.%d.tmp", path.c_str(), getpid());
+	FILE* f = fopen(tmp.c_str(), "w");
+
+	if ( ! f )
+		{
+		reporter->Warning("cannot write DFA cache file %s: %s",
+		                  tmp.c_str(), strerror(errno));
+		return false;
+		}
+
+	uint32_t hdr[4] = { DFA_CACHE_MAGIC, DFA_CACHE_VERSION,
+	                    static_cast<uint32_t>(ec->NumClasses()),
+	                    static_cast<uint32_t>(states.size()) };
+	bool ok = fwrite(hdr, sizeof(hdr), 1, f) == 1;
+
+	std::vector<int32_t> row;
+
+	for ( auto s : states )
+		{
+		row.clear();
+		row.push_back(s->accept ? s->accept->size() : 0);
+
+		if ( s->accept )
+			row.insert(row.end(), s->accept->begin(), s->accept->end());
+
+		for ( int sym = 0; sym < s->num_sym; ++sym )
+			{
+			DFA_State* next = s->Next(sym);
+			row.push_back(next ? index[next] : -1);
+			}
+
+		ok = ok && fwrite(row.data(), sizeof(int32_t), row.size(), f) == row.size();
+		}
+
+	if ( fclose(f) != 0 )
+		ok = false;
+
+	if ( ok && rename(tmp.c_str(), path.c_str()) < 0 )
+		ok = false;
+
+	if ( ! ok )
+		{
+		reporter->Warning("cannot write DFA cache file %s: %s",
+		                  path.c_str(), strerror(errno));
+		unlink(tmp.c_str());
+		}
+
+	return ok;
+	}
+
+bool DFA_Machine::Load(const std::string& path)
+	{
+	FILE* f = fopen(path.c_str(), "r");
+
+	if ( ! f )
+		return false;
+
+	int num_sym = ec->NumClasses();
+	uint32_t hdr[4];
+
+	if ( fread(hdr, sizeof(hdr), 1, f) != 1 ||
+	     hdr[0] != DFA_CACHE_MAGIC || hdr[1] != DFA_CACHE_VERSION ||
+	     hdr[2] != static_cast<uint32_t>(num_sym) )
+		{
+		fclose(f);
+		return false;
+		}
+
+	int num_states = hdr[3];
+	std::vector<DFA_State*> states;
+	std::vector<std::vector<int32_t>> xtions(num_states);
+	bool ok = true;
+
+	for ( int i = 0; ok && i < num_states; ++i )
+		{
+		int32_t num_accept;
+		if ( fread(&num_accept, sizeof(num_accept), 1, f) != 1 ||
+		     num_accept < 0 )
+			{
+			ok = false;
+			break;
+			}
+
+		AcceptingSet* accept = nullptr;
+
+		if ( num_accept > 0 )
+			{
+			std::vector<int32_t> acc(num_accept);
+
+			if ( fread(acc.data(), sizeof(int32_t), num_accept, f) != static_cast<size_t>(num_accept) )
+				{
+				ok = false;
+				break;
+				}
+
+			accept = new AcceptingSet(acc.begin(), acc.end());
+			}
+
+		states.push_back(new DFA_State(i, num_sym, accept, this));
+
+		xtions[i].resize(num_sym);
+		if ( fread(xtions[i].data(), sizeof(int32_t), num_sym, f) != static_cast<size_t>(num_sym) )
+			ok = false;
+
+		for ( auto x : xtions[i] )
+			if ( x < -1 || x >= num_states )
+				ok = false;
+		}
+
+	if ( ok && fgetc(f) != EOF )
+		ok = false;
+
+	fclose(f);
+
+	if ( ! ok )
+		{
+		reporter->Warning("ignoring corrupt DFA cache file %s", path.c_str());
+
+		for ( auto s : states )
+			Unref(s);
+
+		return false;
+		}
+
+	auto cache = new DFA_State_Cache();
+
+	for ( int i = 0; i < num_states; ++i )
+		{
+		DFA_State* s = states[i];
+
+		for ( int sym = 0; sym < num_sym; ++sym )
+			{
+			int32_t x = xtions[i][sym];
+			s->AddXtion(sym, x >= 0 ? states[x] : nullptr);
+			}
+
+		// The states don't have NFA states to derive a digest from,
+		// so just key them by their number.
+		cache->Insert(s, DigestStr(reinterpret_cast<const u_char*>(&i), sizeof(i)));
+		}
+
+	ResetCompact();
+	delete dfa_state_cache;
+	dfa_state_cache = cache;
+	start_state = num_states > 0 ? states[0] : nullptr;
+	state_count = num_states;
+
+	return true;
+	}
+
 bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set,
 				DFA_State*& d, const EquivClass* ec)
 	{
@@ -455,7 +831,7 @@ bool DFA_Machine::StateSetToDFA_State(NFA_state_list* state_set,
 		accept = nullptr;
 		}
 
-	DFA_State* ds = new DFA_State(state_count++, ec, state_set, accept);
+	DFA_State* ds = new DFA_State(state_count++, ec, state_set, accept, this);
 	d = dfa_state_cache->Insert(ds, std::move(digest));
 
 	return true;
@@ -8,6 +8,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <assert.h>
 #include <sys/types.h> // for u_char
@@ -24,10 +25,19 @@ class DFA_State;
 class DFA_Machine;
 class DFA_State;
 
+// If non-zero, DFAs are computed up front when compiling patterns, up to
+// this many states per machine, rather than lazily while matching.
+extern int dfa_precompile_states;
+
+// If not empty, a directory where fully computed DFAs are cached across
+// runs.
+extern std::string dfa_cache_dir;
+
 class DFA_State : public BroObj {
 public:
 	DFA_State(int state_num, const EquivClass* ec,
-			NFA_state_list* nfa_states, AcceptingSet* accept);
+			NFA_state_list* nfa_states, AcceptingSet* accept,
+			DFA_Machine* machine);
 	~DFA_State() override;
 
 	int StateNum() const		{ return state_num; }
@@ -56,6 +66,16 @@ public:
 
 protected:
 	friend class DFA_State_Cache;
+	friend class DFA_Machine;
+
+	// For states loaded from the DFA cache, which come with all their
+	// transitions and hence don't need the NFA states.
+	DFA_State(int state_num, int num_sym, AcceptingSet* accept,
+			DFA_Machine* machine);
+
+	// Returns the transition on the given symbol as far as known,
+	// DFA_UNCOMPUTED_STATE_PTR if not computed yet.
+	inline DFA_State* Next(int sym) const;
 
 	DFA_State* ComputeXtion(int sym, DFA_Machine* machine);
 	void AppendIfNew(int sym, int_list* sym_list);
@@ -63,8 +83,18 @@ protected:
 	int state_num;
 	int num_sym;
 
+	DFA_Machine* machine;
+
+	// Once the state's row in the compact table is complete, the
+	// transitions are looked up there instead, and this is nil.
 	DFA_State** xtions;
 
+	// The state's row in the machine's compact table, or -1 if it
+	// doesn't have one yet, and the number of entries in the row
+	// still to be computed.
+	int compact_row;
+	int compact_uncomputed;
+
 	AcceptingSet* accept;
 	NFA_state_list* nfa_states;
 	EquivClass* meta_ec;	// which ec's make same transition
@@ -127,6 +157,55 @@ public:
 
 	unsigned int MemoryAllocation() const;
 
+	// Computes all states reachable from the start state, up to the
+	// given total number of states. Returns true if that's all of them.
+	bool Determinize(int max_states);
+
+	// Writes the fully computed machine's transition table to the given
+	// file. Returns false on failure.
+	bool Save(const std::string& path);
+
+	// Replaces the machine's states with those from a file written by
+	// Save(). Returns false, leaving the machine as it was, if the file
+	// doesn't exist or doesn't fit the machine.
+	bool Load(const std::string& path);
+
+	// The matching loops use a compact representation of the machine:
+	// a row-major table of 32-bit state IDs, indexed by state and
+	// equivalence class, which gets filled in as transitions are
+	// computed. An ID is its state's row shifted left by one, with the
+	// lowest bit set if the state is accepting.
+	static constexpr uint32_t COMPACT_JAM = 0xffffffff;
+	static constexpr uint32_t COMPACT_ACCEPT = 1;
+
+	// Returns the ID of the given state, or COMPACT_JAM for none.
+	uint32_t CompactID(DFA_State* s);
+
+	DFA_State* CompactState(uint32_t id) const
+		{ return id == COMPACT_JAM ? nullptr : compact_states[id >> 1]; }
+
+	uint32_t CompactXtion(uint32_t id, int sym)
+		{
+		uint32_t next = compact[(id >> 1) * compact_width + sym];
+
+		if ( next == COMPACT_UNCOMPUTED )
+			next = ComputeCompactXtion(id, sym);
+
+		return next;
+		}
+
+	// Called with a state that transitions to itself on the input just
+	// seen. If it does so on all but a few byte values, and isn't
+	// accepting, returns the first position in [p, end) with one of
+	// those, or end if none. Otherwise returns p.
+	const u_char* Accelerate(uint32_t id, const u_char* p, const u_char* end)
+		{
+		if ( accel[id >> 1].num_bytes == 0 )
+			return p;
+
+		return DoAccelerate(id, p, end);
+		}
+
 protected:
 	friend class DFA_State;	// for DFA_State::ComputeXtion
 	friend class DFA_State_Cache;
@@ -136,19 +215,54 @@ protected:
 	// The state list has to be sorted according to IDs.
 	bool StateSetToDFA_State(NFA_state_list* state_set, DFA_State*& d,
 				const EquivClass* ec);
+
+	// Collects the states reachable from the start state in
+	// breadth-first order, computing transitions as it goes until
+	// reaching max_states. Returns true if all were computed.
+	bool ReachableStates(int max_states, std::vector<DFA_State*>* states);
 	const EquivClass* EC() const	{ return ec; }
 
+	static constexpr uint32_t COMPACT_UNCOMPUTED = 0xfffffffe;
+	static constexpr int MAX_ACCEL_BYTES = 3;
+
+	uint32_t ComputeCompactXtion(uint32_t id, int sym);
+	const u_char* DoAccelerate(uint32_t id, const u_char* p, const u_char* end);
+	void ResetCompact();
+
 	EquivClass* ec;	// equivalence classes corresponding to NFAs
 	DFA_State* start_state;
 	DFA_State_Cache* dfa_state_cache;
 
 	NFA_Machine* nfa;
+
+	struct Accel {
+		// The bytes leaving the state, -1 if not determined yet,
+		// and 0 if there are too many.
+		int num_bytes;
+		u_char bytes[MAX_ACCEL_BYTES];
+	};
+
+	int compact_width;
+	std::vector<uint32_t> compact;
+	std::vector<DFA_State*> compact_states;
+	std::vector<Accel> accel;
 };
 
+inline DFA_State* DFA_State::Next(int sym) const
+	{
+	if ( xtions )
+		return xtions[sym];
+
+	uint32_t id = machine->compact[compact_row * machine->compact_width + sym];
+	return machine->CompactState(id);
+	}
+
 inline DFA_State* DFA_State::Xtion(int sym, DFA_Machine* machine)
 	{
-	if ( xtions[sym] == DFA_UNCOMPUTED_STATE_PTR )
+	DFA_State* next = Next(sym);
+
+	if ( next == DFA_UNCOMPUTED_STATE_PTR )
 		return ComputeXtion(sym, machine);
 	else
-		return xtions[sym];
+		return next;
 	}
@@ -23,21 +23,64 @@
 // increase the size of the hash table as needed.
 #define DEFAULT_DICT_SIZE 16
 
+// Keys up to this size are stored directly in the entry.
+#define DICT_INLINE_KEY_SIZE 8
+
 TEST_SUITE_BEGIN("Dict");
 
 class DictEntry {
 public:
-	DictEntry(void* k, int l, hash_t h, void* val) : key(k), len(l), hash(h), value(val) {}
+	DictEntry(hash_t h, void* val) : hash(h), value(val) {}
 
 	~DictEntry()
 		{
-		delete [] (char*) key;
+		if ( ! KeyInline() )
+			delete [] key;
+		}
+
+	bool KeyInline() const	{ return len <= DICT_INLINE_KEY_SIZE; }
+
+	const char* GetKey() const	{ return KeyInline() ? key_here : key; }
+
+	bool Equal(const void* k, int k_len, hash_t h) const
+		{
+		return hash == h && len == k_len && ! memcmp(GetKey(), k, k_len);
+		}
+
+	// Takes over "k", which must be a heap pointer unless copy_key is
+	// true.
+	void SetKey(void* k, int k_len, bool copy_key)
+		{
+		len = k_len;
+
+		if ( KeyInline() )
+			{
+			memcpy(key_here, k, k_len);
+
+			if ( ! copy_key )
+				delete [] (char*) k;
+			}
+
+		else if ( copy_key )
+			{
+			key = new char[k_len];
+			memcpy(key, k, k_len);
+			}
+
+		else
+			key = (char*) k;
 		}
 
-	void* key;
-	int len;
+	int len = 0;
+	// Index into the order list, for ordered dictionaries.
+	int order_pos = -1;
 	hash_t hash;
 	void* value;
+
+	union {
+		char key_here[DICT_INLINE_KEY_SIZE];
+		char* key = nullptr;
+	};
 };
 
 // The value of an iteration cookie is the bucket and offset within the
@@ -139,12 +182,62 @@ TEST_CASE("dict nthentry")
 	lookup = ordered.NthEntry(0);
 	CHECK(*lookup == 15);
 
+	// Overwriting keeps the position but updates the value.
+	uint32_t val3 = 20;
+	ordered.Insert(okey, &val3);
+	CHECK(ordered.Length() == 2);
+	CHECK(*ordered.NthEntry(0) == 20);
+	CHECK(*ordered.NthEntry(1) == 10);
+
+	// Removing shifts the later entries up.
+	ordered.RemoveEntry(okey);
+	CHECK(ordered.Length() == 1);
+	CHECK(*ordered.NthEntry(0) == 10);
+	ordered.Insert(okey, &val);
+	CHECK(*ordered.NthEntry(1) == 15);
+	ordered.Insert(okey2, &val3);
+	CHECK(*ordered.NthEntry(0) == 20);
+
 	delete okey;
 	delete okey2;
 	delete ukey;
 	delete ukey2;
 	}
 
+TEST_CASE("dict ordered removal")
+	{
+	PDict<uint32_t> dict(ORDERED);
+	uint32_t vals[100];
+
+	for ( uint32_t i = 0; i < 100; ++i )
+		{
+		vals[i] = i;
+		HashKey k(i);
+		dict.Insert(&k, &vals[i]);
+		}
+
+	// Removals leave holes that NthEntry() must skip.
+	for ( uint32_t i = 0; i < 100; i += 2 )
+		{
+		HashKey k(i);
+		CHECK(dict.RemoveEntry(&k) == &vals[i]);
+
+		if ( i == 10 )
+			CHECK(*dict.NthEntry(5) == 11);
+		}
+
+	CHECK(dict.Length() == 50);
+
+	for ( int n = 0; n < 50; ++n )
+		CHECK(*dict.NthEntry(n) == uint32_t(2 * n + 1));
+
+	CHECK(dict.NthEntry(50) == nullptr);
+
+	HashKey k(uint32_t(0));
+	dict.Insert(&k, &vals[0]);
+	CHECK(*dict.NthEntry(50) == 0);
+	}
+
 TEST_CASE("dict iteration")
 	{
 	PDict<uint32_t> dict;
@@ -182,14 +275,128 @@ TEST_CASE("dict iteration")
 		delete it_key;
 		}
 
+	CHECK(count == 2);
+	CHECK(it == nullptr);
+
 	delete key;
 	delete key2;
 	}
 
+TEST_CASE("dict resize")
+	{
+	PDict<uint32_t> dict;
+	uint32_t vals[1000];
+
+	for ( uint32_t i = 0; i < 1000; ++i )
+		{
+		vals[i] = i;
+		HashKey k(i);
+		CHECK(dict.Insert(&k, &vals[i]) == nullptr);
+		}
+
+	CHECK(dict.Length() == 1000);
+
+	for ( uint32_t i = 0; i < 1000; ++i )
+		{
+		HashKey k(i);
+		uint32_t* v = dict.Lookup(&k);
+		REQUIRE(v != nullptr);
+		CHECK(*v == i);
+		}
+
+	for ( uint32_t i = 0; i < 1000; i += 2 )
+		{
+		HashKey k(i);
+		CHECK(dict.RemoveEntry(&k) == &vals[i]);
+		}
+
+	CHECK(dict.Length() == 500);
+
+	for ( uint32_t i = 0; i < 1000; ++i )
+		{
+		HashKey k(i);
+		uint32_t* v = dict.Lookup(&k);
+		CHECK((v != nullptr) == (i % 2 == 1));
+		}
+
+	// Long keys live outside the entry.
+	const char* long_key = "a key that does not fit into a slot";
+	uint32_t long_val = 42;
+	dict.Insert(long_key, &long_val);
+	CHECK(dict.Lookup(long_key) == &long_val);
+	CHECK(dict.Length() == 501);
+	}
+
+TEST_CASE("dict robust iteration")
+	{
+	PDict<uint32_t> dict;
+	uint32_t vals[200];
+
+	for ( uint32_t i = 0; i < 200; ++i )
+		vals[i] = i;
+
+	for ( uint32_t i = 0; i < 100; ++i )
+		{
+		HashKey k(i);
+		dict.Insert(&k, &vals[i]);
+		}
+
+	IterCookie* it = dict.InitForIteration();
+	dict.MakeRobustCookie(it);
+
+	bool seen[200] = { false };
+	int count = 0;
+	HashKey* it_key;
+
+	while ( uint32_t* entry = dict.NextEntry(it_key, it) )
+		{
+		// Every entry must be returned once, and removed ones never.
+		CHECK(! seen[*entry]);
+		CHECK((*entry % 3 != 1 || count < 10));
+		seen[*entry] = true;
+		++count;
+		delete it_key;
+
+		if ( count == 10 )
+			{
+			// Remove a third of the original entries and add
+			// another hundred while the iteration is in
+			// progress.
+			for ( uint32_t i = 0; i < 100; ++i )
+				{
+				if ( i % 3 == 1 && ! seen[i] )
+					{
+					HashKey k(i);
+					dict.RemoveEntry(&k);
+					}
+				}
+
+			for ( uint32_t i = 100; i < 200; ++i )
+				{
+				if ( i % 3 == 1 )
+					continue;
+
+				HashKey k(i);
+				dict.Insert(&k, &vals[i]);
+				}
+			}
+		}
+
+	for ( uint32_t i = 0; i < 200; ++i )
+		{
+		HashKey k(i);
+
+		if ( dict.Lookup(&k) )
+			CHECK(seen[i]);
+		}
+
+	CHECK(it == nullptr);
+	}
+
 Dictionary::Dictionary(dict_order ordering, int initial_size)
 	{
 	if ( ordering == ORDERED )
-		order = new PList<DictEntry>;
+		order = new std::vector<DictEntry*>;
 
 	if ( initial_size > 0 )
 		Init(initial_size);
@@ -208,6 +415,20 @@ void Dictionary::Clear()
 	tbl2 = nullptr;
 	num_entries = 0;
 	num_entries2 = 0;
+
+	if ( order )
+		{
+		order->clear();
+		order_holes = 0;
+		}
+
+	// Ongoing iterations have nothing left to visit.
+	for ( const auto& c : cookies )
+		{
+		c->bucket = c->offset = 0;
+		c->ttbl = nullptr;
+		c->inserted.clear();
+		}
 	}
 
 void Dictionary::DeInit()
@@ -272,8 +493,7 @@ void* Dictionary::Lookup(const void* key, int key_size, hash_t hash) const
 		{
 		for ( const auto& entry : *chain )
 			{
-			if ( entry->hash == hash && entry->len == key_size &&
-			     ! memcmp(key, entry->key, key_size) )
+			if ( entry->Equal(key, key_size, hash) )
 				return entry->value;
 			}
 		}
@@ -281,23 +501,43 @@ void* Dictionary::Lookup(const void* key, int key_size, hash_t hash) const
 	return nullptr;
 	}
 
+void* Dictionary::Insert(HashKey* key, void* val)
+	{
+	// Small keys get copied into the entry anyway, so don't make the
+	// HashKey hand over (or allocate) a heap copy for them.
+	if ( key->Size() <= DICT_INLINE_KEY_SIZE )
+		return Insert(const_cast<void*>(key->Key()), key->Size(),
+				key->Hash(), val, true);
+
+	return Insert(key->TakeKey(), key->Size(), key->Hash(), val, false);
+	}
+
 void* Dictionary::Insert(void* key, int key_size, hash_t hash, void* val,
 				bool copy_key)
 	{
 	if ( ! tbl )
 		Init(DEFAULT_DICT_SIZE);
 
-	DictEntry* new_entry = new DictEntry(key, key_size, hash, val);
-	void* old_val = Insert(new_entry, copy_key);
+	DictEntry* new_entry = new DictEntry(hash, val);
+	new_entry->SetKey(key, key_size, copy_key);
+
+	void* old_val = nullptr;
+	DictEntry* old_entry = Insert(new_entry);
 
-	if ( old_val )
+	if ( old_entry )
 		{
 		// We didn't need the new DictEntry, the key was already
 		// present.
+		old_val = old_entry->value;
+		old_entry->value = val;
 		delete new_entry;
 		}
+
 	else if ( order )
+		{
+		new_entry->order_pos = order->size();
 		order->push_back(new_entry);
+		}
 
 	// Resize logic.
 	if ( tbl2 )
@@ -315,22 +555,25 @@ void* Dictionary::Remove(const void* key, int key_size, hash_t hash,
 		return nullptr;
 
 	hash_t h;
-	PList<DictEntry>* chain;
+	PList<DictEntry>** ttbl;
 	int* num_entries_ptr;
 
 	// Figure out which hash table to look in
 	h = hash % num_buckets;
 	if ( ! tbl2 || h >= tbl_next_ind )
 		{
-		chain = tbl[h];
+		ttbl = tbl;
 		num_entries_ptr = &num_entries;
 		}
 	else
 		{
-		chain = tbl2[hash % num_buckets2];
+		ttbl = tbl2;
+		h = hash % num_buckets2;
 		num_entries_ptr = &num_entries2;
 		}
 
+	PList<DictEntry>* chain = ttbl[h];
+
 	if ( ! chain )
 		return nullptr;
 
@@ -340,12 +583,11 @@ void* Dictionary::Remove(const void* key, int key_size, hash_t hash,
 		{
 		DictEntry* entry = (*chain)[i];
 
-		if ( entry->hash == hash && entry->len == key_size &&
-		     ! memcmp(key, entry->key, key_size) )
+		if ( entry->Equal(key, key_size, hash) )
 			{
-			void* entry_value = DoRemove(entry, h, chain, i);
+			void* entry_value = DoRemove(entry, ttbl, h, chain, i);
 
-			if ( dont_delete )
+			if ( dont_delete && ! entry->KeyInline() )
 				entry->key = nullptr;
 
 			delete entry;
@@ -357,20 +599,28 @@ void* Dictionary::Remove(const void* key, int key_size, hash_t hash,
 	return nullptr;
 	}
 
-void* Dictionary::DoRemove(DictEntry* entry, hash_t h,
-				PList<DictEntry>* chain, int chain_offset)
+void* Dictionary::DoRemove(DictEntry* entry, PList<DictEntry>** ttbl,
+				hash_t h, PList<DictEntry>* chain,
+				int chain_offset)
 	{
 	void* entry_value = entry->value;
 
 	chain->remove_nth(chain_offset);
+
 	if ( order )
-		order->remove(entry);
+		{
+		(*order)[entry->order_pos] = nullptr;
+
+		if ( ++order_holes > int(order->size()) / 2 )
+			CompactOrder();
+		}
 
 	// Adjust existing cookies.
 	for ( const auto& c : cookies )
 		{
 		// Is the affected bucket the current one?
-		if ( (unsigned int) c->bucket == h )
+		if ( (c->ttbl ? c->ttbl : tbl) == ttbl &&
+		     (unsigned int) c->bucket == h )
 			{
 			if ( c->offset > chain_offset )
 				--c->offset;
@@ -385,20 +635,52 @@ void* Dictionary::DoRemove(DictEntry* entry, hash_t h,
 			}
 
 		// This item may have been inserted during this iteration.
-		if ( (unsigned int) c->bucket > h )
+		if ( CookiePassed(c, ttbl, h) )
 			c->inserted.remove(entry);
 		}
 
 	return entry_value;
 	}
 
+bool Dictionary::CookiePassed(const IterCookie* c, PList<DictEntry>** ttbl,
+				hash_t h) const
+	{
+	// A cookie walks tbl first and then, if we're resizing, tbl2.
+	if ( (c->ttbl ? c->ttbl : tbl) == ttbl )
+		return h < (unsigned int) c->bucket;
+
+	return ttbl == tbl;
+	}
+
+void Dictionary::CompactOrder() const
+	{
+	int n = 0;
+
+	for ( size_t i = 0; i < order->size(); ++i )
+		{
+		DictEntry* entry = (*order)[i];
+
+		if ( entry )
+			{
+			entry->order_pos = n;
+			(*order)[n++] = entry;
+			}
+		}
+
+	order->resize(n);
+	order_holes = 0;
+	}
+
 void* Dictionary::NthEntry(int n, const void*& key, int& key_len) const
 	{
 	if ( ! order || n < 0 || n >= Length() )
 		return nullptr;
 
+	if ( order_holes )
+		CompactOrder();
+
 	DictEntry* entry = (*order)[n];
-	key = entry->key;
+	key = entry->GetKey();
 	key_len = entry->len;
 	return entry->value;
 	}
@@ -410,6 +692,9 @@ IterCookie* Dictionary::InitForIteration() const
 
 void Dictionary::StopIteration(IterCookie* cookie) const
 	{
+	// FIXME: I don't like removing the const here. But is there
+	// a better way?
+	const_cast<PList<IterCookie>*>(&cookies)->remove(cookie);
 	delete cookie;
 	}
 
@@ -417,8 +702,7 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 	{
 	if ( ! tbl && ! tbl2 )
 		{
-		const_cast<PList<IterCookie>*>(&cookies)->remove(cookie);
-		delete cookie;
+		StopIteration(cookie);
 		cookie = nullptr;
 		return nullptr;
 		}
@@ -435,7 +719,7 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 		// and removing from the tail is cheaper.
 		entry = cookie->inserted.remove_nth(cookie->inserted.length()-1);
 		if ( return_hash )
-			h = new HashKey(entry->key, entry->len, entry->hash);
+			h = new HashKey(entry->GetKey(), entry->len, entry->hash);
 
 		return entry->value;
 		}
@@ -460,7 +744,7 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 		entry = (*ttbl[b])[o];
 		++cookie->offset;
 		if ( return_hash )
-			h = new HashKey(entry->key, entry->len, entry->hash);
+			h = new HashKey(entry->GetKey(), entry->len, entry->hash);
 		return entry->value;
 		}
 
@@ -481,18 +765,14 @@ void* Dictionary::NextEntry(HashKey*& h, IterCookie*& cookie, int return_hash) c
 			}
 
 		// All done.
-
-		// FIXME: I don't like removing the const here. But is there
-		// a better way?
-		const_cast<PList<IterCookie>*>(&cookies)->remove(cookie);
-		delete cookie;
+		StopIteration(cookie);
 		cookie = nullptr;
 		return nullptr;
 		}
 
 	entry = (*ttbl[b])[0];
 	if ( return_hash )
-		h = new HashKey(entry->key, entry->len, entry->hash);
+		h = new HashKey(entry->GetKey(), entry->len, entry->hash);
 
 	cookie->bucket = b;
 	cookie->offset = 1;
@@ -524,7 +804,7 @@ void Dictionary::Init2(int size)
 	}
 
 // private
-void* Dictionary::Insert(DictEntry* new_entry, bool copy_key)
+DictEntry* Dictionary::Insert(DictEntry* new_entry)
 	{
 	if ( ! tbl )
 		Init(DEFAULT_DICT_SIZE);
@@ -556,38 +836,21 @@ void* Dictionary::Insert(DictEntry* new_entry, bool copy_key)
 
 	PList<DictEntry>* chain = ttbl[h];
 
-	int n = new_entry->len;
-
 	if ( chain )
 		{
 		for ( int i = 0; i < chain->length(); ++i )
 			{
 			DictEntry* entry = (*chain)[i];
 
-			if ( entry->hash == new_entry->hash &&
-			     entry->len == n &&
-			     ! memcmp(entry->key, new_entry->key, n) )
-				{
-				void* old_value = entry->value;
-				entry->value = new_entry->value;
-				return old_value;
-				}
+			if ( entry->Equal(new_entry->GetKey(), new_entry->len,
+						new_entry->hash) )
+				return entry;
 			}
 		}
 	else
 		// Create new chain.
 		chain = ttbl[h] = new PList<DictEntry>;
 
-	// If we got this far, then we couldn't use an existing copy
-	// of the key, so make a new one if necessary.
-	if ( copy_key )
-		{
-		void* old_key = new_entry->key;
-		new_entry->key = (void*) new char[n];
-		memcpy(new_entry->key, old_key, n);
-		delete (char*) old_key;
-		}
-
 	// We happen to know (:-() that appending is more efficient
 	// on lists than prepending.
 	chain->push_back(new_entry);
@@ -600,7 +863,7 @@ void* Dictionary::Insert(DictEntry* new_entry, bool copy_key)
 	// entry was put, add it to the cookie's list of inserted entries.
 	for ( const auto& c : cookies )
 		{
-		if ( h < (unsigned int) c->bucket )
+		if ( CookiePassed(c, ttbl, h) )
 			c->inserted.push_back(new_entry);
 		}
 
@@ -669,7 +932,7 @@ void Dictionary::MoveChains()
 
 		for ( const auto& elem : *chain )
 			{
-			Insert(elem, false);
+			Insert(elem);
 			--num_entries;
 			--num;
 			}
@@ -722,14 +985,20 @@ unsigned int Dictionary::MemoryAllocation() const
 			{
 			PList<DictEntry>* chain = tbl[i];
 			for ( const auto& c : *chain )
-				size += padded_sizeof(DictEntry) + pad_size(c->len);
+				{
+				size += padded_sizeof(DictEntry);
+
+				if ( ! c->KeyInline() )
+					size += pad_size(c->len);
+				}
 			size += chain->MemoryAllocation();
 			}
 
 	size += pad_size(num_buckets * sizeof(PList<DictEntry>*));
 
 	if ( order )
-		size += order->MemoryAllocation();
+		size += padded_sizeof(*order) +
+			pad_size(order->capacity() * sizeof(DictEntry*));
 
 	if ( tbl2 )
 		{
@@ -738,7 +1007,12 @@ unsigned int Dictionary::MemoryAllocation() const
 				{
 				PList<DictEntry>* chain = tbl2[i];
 				for ( const auto& c : *chain )
-					size += padded_sizeof(DictEntry) + pad_size(c->len);
+					{
+					size += padded_sizeof(DictEntry);
+
+					if ( ! c->KeyInline() )
+						size += pad_size(c->len);
+					}
 				size += chain->MemoryAllocation();
 				}
 
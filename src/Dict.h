@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "List.h"
 #include "Hash.h"
 
@@ -34,10 +36,7 @@ public:
 	void* Lookup(const void* key, int key_size, hash_t hash) const;
 
 	// Returns previous value, or 0 if none.
-	void* Insert(HashKey* key, void* val)
-		{
-		return Insert(key->TakeKey(), key->Size(), key->Hash(), val, 0);
-		}
+	void* Insert(HashKey* key, void* val);
 	// If copy_key is true, then the key is copied, otherwise it's assumed
 	// that it's a heap pointer that now belongs to the Dictionary to
 	// manage as needed.
@@ -124,12 +123,22 @@ private:
 	void Init2(int size);	// initialize second table for resizing
 	void DeInit();
 
-	// Internal version of Insert().
-	void* Insert(DictEntry* entry, bool copy_key);
+	// Internal version of Insert().  If the key is already present,
+	// returns its entry and leaves the new one alone.  Otherwise the new
+	// entry, which must own its key, goes into the table.
+	DictEntry* Insert(DictEntry* entry);
 
-	void* DoRemove(DictEntry* entry, hash_t h,
+	void* DoRemove(DictEntry* entry, PList<DictEntry>** ttbl, hash_t h,
 			PList<DictEntry>* chain, int chain_offset);
 
+	// Whether the iteration of cookie "c" has already passed bucket "h"
+	// of table "ttbl".
+	bool CookiePassed(const IterCookie* c, PList<DictEntry>** ttbl,
+				hash_t h) const;
+
+	// Squeezes the holes left by removals out of the order list.
+	void CompactOrder() const;
+
 	int NextPrime(int n) const;
 	bool IsPrime(int n) const;
 	void StartChangeSize(int new_size);
@@ -177,7 +186,12 @@ private:
 
 	hash_t tbl_next_ind = 0;
 
-	PList<DictEntry>* order = nullptr;
+	// Entries in insertion order, for ordered dictionaries.  Remove()
+	// leaves a nil hole behind rather than shifting the rest of the list;
+	// holes get squeezed out once NthEntry() needs the positions, or once
+	// they make up half of the list.
+	std::vector<DictEntry*>* order = nullptr;
+	mutable int order_holes = 0;
 	dict_delete_func delete_func = nullptr;
 
 	PList<IterCookie> cookies;
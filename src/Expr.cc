@@ -13,6 +13,7 @@
 #include "EventRegistry.h"
 #include "Net.h"
 #include "Traverse.h"
+#include "ScriptOpt.h"
 #include "Trigger.h"
 #include "IPAddr.h"
 #include "digest.h"
@@ -393,6 +394,11 @@ TraversalCode UnaryExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void UnaryExpr::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	op = opt->Optimize(std::move(op));
+	}
+
 IntrusivePtr<Val> UnaryExpr::Fold(Val* v) const
 	{
 	return {NewRef{}, v};
@@ -510,6 +516,12 @@ TraversalCode BinaryExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void BinaryExpr::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	op1 = opt->Optimize(std::move(op1));
+	op2 = opt->Optimize(std::move(op2));
+	}
+
 void BinaryExpr::ExprDescribe(ODesc* d) const
 	{
 	op1->Describe(d);
@@ -1981,6 +1993,13 @@ TraversalCode CondExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void CondExpr::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	op1 = opt->Optimize(std::move(op1));
+	op2 = opt->Optimize(std::move(op2));
+	op3 = opt->Optimize(std::move(op3));
+	}
+
 void CondExpr::ExprDescribe(ODesc* d) const
 	{
 	op1->Describe(d);
@@ -3920,6 +3939,12 @@ TraversalCode ScheduleExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void ScheduleExpr::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	when = opt->Optimize(std::move(when));
+	event->OptimizeChildren(opt);
+	}
+
 void ScheduleExpr::ExprDescribe(ODesc* d) const
 	{
 	if ( d->IsReadable() )
@@ -4220,6 +4245,12 @@ TraversalCode CallExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void CallExpr::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	// Leave func alone: a call needs a function, not a constant.
+	args->OptimizeChildren(opt);
+	}
+
 void CallExpr::ExprDescribe(ODesc* d) const
 	{
 	func->Describe(d);
@@ -4418,6 +4449,11 @@ TraversalCode EventExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void EventExpr::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	args->OptimizeChildren(opt);
+	}
+
 void EventExpr::ExprDescribe(ODesc* d) const
 	{
 	d->Add(name.c_str());
@@ -4785,6 +4821,12 @@ TraversalCode ListExpr::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_EXPR_POST(tc);
 	}
 
+void ListExpr::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	for ( auto& expr : exprs )
+		expr = opt->Optimize({AdoptRef{}, expr}).release();
+	}
+
 RecordAssignExpr::RecordAssignExpr(const IntrusivePtr<Expr>& record,
                                    const IntrusivePtr<Expr>& init_list, bool is_init)
 	{
@@ -69,6 +69,7 @@ class IndexExpr;
 class AssignExpr;
 class CallExpr;
 class EventExpr;
+class ScriptOptimizer;
 
 struct function_ingredients;
 
@@ -204,6 +205,9 @@ public:
 
 	virtual TraversalCode Traverse(TraversalCallback* cb) const = 0;
 
+	// Lets the optimizer replace the operands. See ScriptOpt.h.
+	virtual void OptimizeChildren(ScriptOptimizer* opt)	{ }
+
 protected:
 	Expr() = default;
 	explicit Expr(BroExprTag arg_tag);
@@ -277,6 +281,7 @@ public:
 	bool IsPure() const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	UnaryExpr(BroExprTag arg_tag, IntrusivePtr<Expr> arg_op);
@@ -302,6 +307,7 @@ public:
 	IntrusivePtr<Val> Eval(Frame* f) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	BinaryExpr(BroExprTag arg_tag,
@@ -489,6 +495,7 @@ public:
 	bool IsPure() const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	void ExprDescribe(ODesc* d) const override;
@@ -520,6 +527,11 @@ public:
 	IntrusivePtr<Val> InitVal(const BroType* t, IntrusivePtr<Val> aggr) const override;
 	bool IsPure() const override;
 
+	bool IsInit() const	{ return is_init; }
+
+	// The value the expression yields instead of the assigned one, if any.
+	Val* AssignVal() const	{ return val.get(); }
+
 protected:
 	bool TypeCheck(attr_list* attrs = nullptr);
 	bool TypeCheckArithmetics(TypeTag bt1, TypeTag bt2);
@@ -762,6 +774,7 @@ public:
 	EventExpr* Event() const	{ return event.get(); }
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	void ExprDescribe(ODesc* d) const override;
@@ -792,6 +805,7 @@ public:
 	IntrusivePtr<Val> Eval(Frame* f) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	void ExprDescribe(ODesc* d) const override;
@@ -837,6 +851,7 @@ public:
 	IntrusivePtr<Val> Eval(Frame* f) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	void ExprDescribe(ODesc* d) const override;
@@ -868,6 +883,7 @@ public:
 	void Assign(Frame* f, IntrusivePtr<Val> v) override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	IntrusivePtr<Val> AddSetInit(const BroType* t, IntrusivePtr<Val> aggr) const;
@@ -66,6 +66,29 @@ void Frame::AddFunctionWithClosureRef(BroFunc* func)
 	functions_with_closure_frame_reference->emplace_back(func);
 	}
 
+bool Frame::IsReusable(const BroFunc* func) const
+	{
+	return RefCnt() == 1 && function == func && ! closure &&
+		! offset_map && ! functions_with_closure_frame_reference;
+	}
+
+void Frame::Recycle()
+	{
+	Reset(0);
+
+	delete [] weak_refs;
+	weak_refs = nullptr;
+
+	func_args = nullptr;
+	next_stmt = nullptr;
+	break_before_next_stmt = false;
+	break_on_return = false;
+	delayed = false;
+
+	trigger = nullptr;
+	call = nullptr;
+	}
+
 void Frame::SetElement(int n, Val* v, bool weak_ref)
 	{
 	UnrefElement(n);
@@ -103,6 +103,8 @@ public:
 	 */
 	const zeek::Args* GetFuncArgs() const	{ return func_args; }
 
+	void SetFuncArgs(const zeek::Args* fn_args)	{ func_args = fn_args; }
+
 	/**
 	 * Change the function that the frame is associated with.
 	 *
@@ -232,6 +234,20 @@ public:
 	 */
 	void AddFunctionWithClosureRef(BroFunc* func);
 
+	/**
+	 * Returns whether the frame may be reused for another call of the
+	 * given function once the current one has finished: nothing else
+	 * holds a reference to it (as closures and triggers do), and it
+	 * doesn't carry closure state.
+	 */
+	bool IsReusable(const BroFunc* func) const;
+
+	/**
+	 * Releases the frame's values and resets its per-call state, so
+	 * that it looks like a newly created frame of the same size.
+	 */
+	void Recycle();
+
 private:
 
 	using OffsetMap = std::unordered_map<std::string, int>;
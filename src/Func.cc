@@ -33,6 +33,8 @@
 #include <broker/error.hh>
 
 #include "Base64.h"
+#include "ByteCode.h"
+#include "ScriptOpt.h"
 #include "Debug.h"
 #include "Desc.h"
 #include "Expr.h"
@@ -287,6 +289,9 @@ BroFunc::~BroFunc()
 	{
 	if ( ! weak_closure_ref )
 		Unref(closure);
+
+	ClearCompiledBodies();
+	ClearFreeFrames();
 	}
 
 bool BroFunc::IsPure() const
@@ -324,7 +329,7 @@ IntrusivePtr<Val> BroFunc::Call(const zeek::Args& args, Frame* parent) const
 		return Flavor() == FUNC_FLAVOR_HOOK ? val_mgr->True() : nullptr;
 		}
 
-	auto f = make_intrusive<Frame>(frame_size, this, &args);
+	auto f = NewFrame(&args);
 
 	if ( closure )
 		f->CaptureClosure(closure, outer_ids);
@@ -336,6 +341,9 @@ IntrusivePtr<Val> BroFunc::Call(const zeek::Args& args, Frame* parent) const
 		f->SetCall(parent->GetCall());
 		}
 
+	if ( compile_scripts && ! bodies_compiled )
+		CompileBodies();
+
 	g_frame_stack.push_back(f.get());	// used for backtracing
 	const CallExpr* call_expr = parent ? parent->GetCall() : nullptr;
 	call_stack.emplace_back(CallInfo{call_expr, this, args});
@@ -352,8 +360,11 @@ IntrusivePtr<Val> BroFunc::Call(const zeek::Args& args, Frame* parent) const
 	stmt_flow_type flow = FLOW_NEXT;
 	IntrusivePtr<Val> result;
 
-	for ( const auto& body : bodies )
+	for ( size_t i = 0; i < bodies.size(); ++i )
 		{
+		const auto& body = bodies[i];
+		ByteCode* code = i < compiled_bodies.size() ? compiled_bodies[i] : nullptr;
+
 		if ( sample_logger )
 			sample_logger->LocationSeen(
 				body.stmts->GetLocationInfo());
@@ -372,7 +383,10 @@ IntrusivePtr<Val> BroFunc::Call(const zeek::Args& args, Frame* parent) const
 
 		try
 			{
-			result = body.stmts->Exec(f.get(), flow);
+			if ( code )
+				result = code->Exec(f.get(), flow);
+			else
+				result = body.stmts->Exec(f.get(), flow);
 			}
 
 		catch ( InterpreterException& e )
@@ -439,10 +453,39 @@ IntrusivePtr<Val> BroFunc::Call(const zeek::Args& args, Frame* parent) const
 		}
 
 	g_frame_stack.pop_back();
+	RecycleFrame(std::move(f));
 
 	return result;
 	}
 
+IntrusivePtr<Frame> BroFunc::NewFrame(const zeek::Args* args) const
+	{
+	if ( free_frames.empty() )
+		return make_intrusive<Frame>(frame_size, this, args);
+
+	IntrusivePtr<Frame> f{AdoptRef{}, free_frames.back()};
+	free_frames.pop_back();
+	f->SetFuncArgs(args);
+	return f;
+	}
+
+void BroFunc::RecycleFrame(IntrusivePtr<Frame> f) const
+	{
+	if ( free_frames.size() >= MAX_FREE_FRAMES || ! f->IsReusable(this) )
+		return;
+
+	f->Recycle();
+	free_frames.push_back(f.release());
+	}
+
+void BroFunc::ClearFreeFrames()
+	{
+	for ( auto f : free_frames )
+		Unref(f);
+
+	free_frames.clear();
+	}
+
 void BroFunc::AddBody(IntrusivePtr<Stmt> new_body, id_list* new_inits,
                       size_t new_frame_size, int priority)
 	{
@@ -469,6 +512,28 @@ void BroFunc::AddBody(IntrusivePtr<Stmt> new_body, id_list* new_inits,
 
 	bodies.push_back(b);
 	sort(bodies.begin(), bodies.end());
+
+	ClearCompiledBodies();
+
+	// The frame size may have changed.
+	ClearFreeFrames();
+	}
+
+void BroFunc::CompileBodies() const
+	{
+	for ( const auto& body : bodies )
+		compiled_bodies.push_back(ByteCode::Compile(body.stmts.get()));
+
+	bodies_compiled = true;
+	}
+
+void BroFunc::ClearCompiledBodies()
+	{
+	for ( auto code : compiled_bodies )
+		delete code;
+
+	compiled_bodies.clear();
+	bodies_compiled = false;
 	}
 
 void BroFunc::AddClosure(id_list ids, Frame* f)
@@ -567,6 +632,18 @@ void BroFunc::Describe(ODesc* d) const
 		}
 	}
 
+void BroFunc::OptimizeBodies(ScriptOptimizer* opt)
+	{
+	for ( auto& body : bodies )
+		body.stmts = opt->OptimizeBody(std::move(body.stmts), this);
+
+	bodies.erase(std::remove_if(bodies.begin(), bodies.end(),
+	                            [](const Body& b) { return ! b.stmts; }),
+	             bodies.end());
+
+	ClearCompiledBodies();
+	}
+
 IntrusivePtr<Stmt> BroFunc::AddInits(IntrusivePtr<Stmt> body, id_list* inits)
 	{
 	if ( ! inits || inits->length() == 0 )
@@ -757,6 +834,7 @@ void init_builtin_funcs()
 	GapStats = internal_type("GapStats")->AsRecordType();
 	EventStats = internal_type("EventStats")->AsRecordType();
 	TimerStats = internal_type("TimerStats")->AsRecordType();
+	TableExpireStats = internal_type("TableExpireStats")->AsRecordType();
 	FileAnalysisStats = internal_type("FileAnalysisStats")->AsRecordType();
 	ThreadStats = internal_type("ThreadStats")->AsRecordType();
 	BrokerStats = internal_type("BrokerStats")->AsRecordType();
@@ -27,6 +27,8 @@ class Frame;
 class ID;
 class CallExpr;
 class Scope;
+class ByteCode;
+class ScriptOptimizer;
 
 class Func : public BroObj {
 public:
@@ -155,6 +157,12 @@ public:
 	void AddBody(IntrusivePtr<Stmt> new_body, id_list* new_inits,
 		     size_t new_frame_size, int priority) override;
 
+	/**
+	 * Replaces the bodies by their optimized versions, dropping those
+	 * that the optimizer deems unnecessary.
+	 */
+	void OptimizeBodies(ScriptOptimizer* opt);
+
 	/** Sets this function's outer_id list. */
 	void SetOuterIDs(id_list ids)
 		{ outer_ids = std::move(ids); }
@@ -170,6 +178,33 @@ protected:
 	 */
 	IntrusivePtr<Func> DoClone() override;
 
+	/**
+	 * Compiles the bodies into bytecode, if not done yet.
+	 */
+	void CompileBodies() const;
+
+	/**
+	 * Deletes the compiled bodies.
+	 */
+	void ClearCompiledBodies();
+
+	/**
+	 * Returns a frame for a call, reusing one of an earlier call if
+	 * possible.
+	 */
+	IntrusivePtr<Frame> NewFrame(const zeek::Args* args) const;
+
+	/**
+	 * Keeps a frame for reuse by a later call, unless something
+	 * captured it.
+	 */
+	void RecycleFrame(IntrusivePtr<Frame> f) const;
+
+	/**
+	 * Deletes the frames kept for reuse.
+	 */
+	void ClearFreeFrames();
+
 	/**
 	 * Performs a selective clone of *f* using the IDs that were
 	 * captured in the function's closure.
@@ -186,6 +221,16 @@ private:
 	// The frame the BroFunc was initialized in.
 	Frame* closure = nullptr;
 	bool weak_closure_ref = false;
+
+	// With --compile-scripts, the bodies compiled on the first call,
+	// in the order of bodies; nil for bodies that aren't compiled.
+	mutable std::vector<ByteCode*> compiled_bodies;
+	mutable bool bodies_compiled = false;
+
+	// Frames of finished calls, all of frame_size, ready for the next
+	// ones. Recursion needs more than one.
+	static constexpr size_t MAX_FREE_FRAMES = 4;
+	mutable std::vector<Frame*> free_frames;
 };
 
 /**
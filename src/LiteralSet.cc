@@ -0,0 +1,190 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "LiteralSet.h"
+
+#include <algorithm>
+#include <deque>
+
+#include <assert.h>
+
+#include "3rdparty/doctest.h"
+
+LiteralSet::LiteralSet()
+	{
+	nodes.push_back(Node{{}, 0, -1, {}});
+	num_ids = 0;
+	compiled = false;
+
+	for ( int c = 0; c < 256; ++c )
+		root_next[c] = 0;
+	}
+
+int LiteralSet::Child(int node, u_char c) const
+	{
+	const auto& children = nodes[node].children;
+	auto it = std::lower_bound(children.begin(), children.end(),
+	                           std::make_pair(c, 0));
+
+	if ( it == children.end() || it->first != c )
+		return -1;
+
+	return it->second;
+	}
+
+void LiteralSet::Add(const std::string& literal, int id)
+	{
+	assert(! compiled && ! literal.empty() && id >= 0);
+
+	int node = 0;
+
+	for ( auto c : literal )
+		{
+		u_char uc = static_cast<u_char>(c);
+		int next = Child(node, uc);
+
+		if ( next < 0 )
+			{
+			next = nodes.size();
+			nodes.push_back(Node{{}, 0, -1, {}});
+
+			auto& children = nodes[node].children;
+			auto it = std::lower_bound(children.begin(), children.end(),
+			                           std::make_pair(uc, 0));
+			children.insert(it, std::make_pair(uc, next));
+			}
+
+		node = next;
+		}
+
+	nodes[node].ids.push_back(id);
+	num_ids = std::max(num_ids, id + 1);
+	}
+
+void LiteralSet::Compile()
+	{
+	assert(! compiled);
+
+	for ( const auto& child : nodes[0].children )
+		root_next[child.first] = child.second;
+
+	// Breadth-first, so that fail links always point to nodes done
+	// already.
+	std::deque<int> queue;
+
+	for ( const auto& child : nodes[0].children )
+		queue.push_back(child.second);
+
+	while ( ! queue.empty() )
+		{
+		int node = queue.front();
+		queue.pop_front();
+
+		for ( const auto& child : nodes[node].children )
+			{
+			u_char c = child.first;
+			int f = nodes[node].fail;
+			int next;
+
+			while ( (next = Child(f, c)) < 0 && f != 0 )
+				f = nodes[f].fail;
+
+			if ( next < 0 || next == child.second )
+				next = 0;
+
+			Node& n = nodes[child.second];
+			n.fail = next;
+			n.output = nodes[next].ids.empty() ? nodes[next].output : next;
+
+			queue.push_back(child.second);
+			}
+		}
+
+	compiled = true;
+	}
+
+bool LiteralSet::Search(int* state, const u_char* data, int len,
+                        std::vector<bool>* found) const
+	{
+	assert(compiled);
+
+	int s = *state;
+	bool any = false;
+
+	for ( int i = 0; i < len; ++i )
+		{
+		u_char c = data[i];
+
+		if ( s == 0 )
+			{
+			// Most input doesn't start a literal.
+			s = root_next[c];
+
+			if ( s == 0 )
+				continue;
+			}
+
+		else
+			{
+			int next;
+
+			while ( (next = Child(s, c)) < 0 && s != 0 )
+				s = nodes[s].fail;
+
+			s = next >= 0 ? next : root_next[c];
+			}
+
+		const Node& n = nodes[s];
+		int o = n.ids.empty() ? n.output : s;
+
+		for ( ; o >= 0; o = nodes[o].output )
+			{
+			for ( auto id : nodes[o].ids )
+				(*found)[id] = true;
+
+			any = true;
+			}
+		}
+
+	*state = s;
+	return any;
+	}
+
+TEST_CASE("literal set")
+	{
+	LiteralSet ls;
+	ls.Add("he", 0);
+	ls.Add("she", 1);
+	ls.Add("hers", 2);
+	ls.Add("his", 3);
+	ls.Compile();
+
+	CHECK(ls.NumIDs() == 4);
+
+	std::vector<bool> found(ls.NumIDs());
+	int state = 0;
+
+	CHECK(! ls.Search(&state, (const u_char*) "xyz", 3, &found));
+
+	// "she" contains "he" as well.
+	CHECK(ls.Search(&state, (const u_char*) "ushe", 4, &found));
+	CHECK(found[0]);
+	CHECK(found[1]);
+	CHECK(! found[2]);
+	CHECK(! found[3]);
+
+	// Spanning chunks.
+	found.assign(found.size(), false);
+	state = 0;
+	CHECK(! ls.Search(&state, (const u_char*) "xhe", 2, &found));
+	CHECK(ls.Search(&state, (const u_char*) "ers", 3, &found));
+	CHECK(found[2]);
+	CHECK(! found[3]);
+
+	found.assign(found.size(), false);
+	state = 0;
+	CHECK(ls.Search(&state, (const u_char*) "hhis", 4, &found));
+	CHECK(found[3]);
+	CHECK(! found[0]);
+	}
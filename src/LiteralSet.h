@@ -0,0 +1,80 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <sys/types.h> // for u_char
+
+/**
+ * A set of literal strings searched for simultaneously with an
+ * Aho-Corasick automaton. Each literal carries an ID, and searching
+ * reports the IDs of all literals occurring in the input.
+ *
+ * The search state is kept by the caller, so that literals spanning
+ * multiple chunks of a stream are found as well.
+ */
+class LiteralSet {
+public:
+	LiteralSet();
+
+	/**
+	 * Adds a literal. Must not be called after Compile().
+	 *
+	 * @param literal The non-empty literal.
+	 *
+	 * @param id An ID >= 0 reported when the literal is found. IDs
+	 * don't need to be unique.
+	 */
+	void Add(const std::string& literal, int id);
+
+	/**
+	 * Prepares the set for searching, after all literals have been
+	 * added.
+	 */
+	void Compile();
+
+	/**
+	 * Returns one more than the largest ID added.
+	 */
+	int NumIDs() const	{ return num_ids; }
+
+	/**
+	 * Searches a chunk of input for the literals.
+	 *
+	 * @param state The search state, which must be 0 at the beginning
+	 * of the input and gets updated for the next chunk.
+	 *
+	 * @param data The chunk.
+	 *
+	 * @param len Its length.
+	 *
+	 * @param found For each ID of a literal found, its element gets set
+	 * to true. Must have at least NumIDs() elements.
+	 *
+	 * @return True if any literal was found.
+	 */
+	bool Search(int* state, const u_char* data, int len,
+	            std::vector<bool>* found) const;
+
+private:
+	struct Node {
+		// Sorted by byte.
+		std::vector<std::pair<u_char, int>> children;
+		int fail;	// longest proper suffix that's a node, too
+		int output;	// nearest node on the fail chain with IDs, or -1
+		std::vector<int> ids;	// literals ending here
+	};
+
+	int Child(int node, u_char c) const;
+
+	std::vector<Node> nodes;
+
+	// The root's transitions, including those staying at the root.
+	int root_next[256];
+
+	int num_ids;
+	bool compiled;
+};
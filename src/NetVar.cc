@@ -34,6 +34,8 @@ int watchdog_interval;
 int max_timer_expires;
 
 int ignore_checksums;
+bro_uint_t flow_shards;
+bro_uint_t flow_shard_index;
 int partial_connection_ok;
 int tcp_SYN_ack_ok;
 int tcp_match_undelivered;
@@ -54,6 +56,11 @@ int tcp_max_initial_window;
 int tcp_max_above_hole_without_any_acks;
 int tcp_excessive_data_without_further_acks;
 int tcp_max_old_segments;
+bro_uint_t reassembly_coalesce_limit;
+
+bro_uint_t buffer_memory_limit;
+bro_uint_t buffer_memory_limit_per_conn;
+int buffer_eviction_policy;
 
 RecordType* socks_address;
 
@@ -269,6 +276,8 @@ void init_net_var()
 	mime_matches = internal_type("mime_matches")->AsVectorType();
 
 	ignore_checksums = opt_internal_int("ignore_checksums");
+	flow_shards = opt_internal_unsigned("flow_shards");
+	flow_shard_index = opt_internal_unsigned("flow_shard_index");
 	partial_connection_ok = opt_internal_int("partial_connection_ok");
 	tcp_SYN_ack_ok = opt_internal_int("tcp_SYN_ack_ok");
 	tcp_match_undelivered = opt_internal_int("tcp_match_undelivered");
@@ -291,6 +300,12 @@ void init_net_var()
 	tcp_excessive_data_without_further_acks =
 		opt_internal_int("tcp_excessive_data_without_further_acks");
 	tcp_max_old_segments = opt_internal_int("tcp_max_old_segments");
+	reassembly_coalesce_limit = opt_internal_unsigned("reassembly_coalesce_limit");
+
+	buffer_memory_limit = opt_internal_unsigned("buffer_memory_limit");
+	buffer_memory_limit_per_conn =
+		opt_internal_unsigned("buffer_memory_limit_per_conn");
+	buffer_eviction_policy = opt_internal_int("buffer_eviction_policy");
 
 	socks_address = internal_type("SOCKS::Address")->AsRecordType();
 
@@ -34,6 +34,8 @@ extern int watchdog_interval;
 extern int max_timer_expires;
 
 extern int ignore_checksums;
+extern bro_uint_t flow_shards;
+extern bro_uint_t flow_shard_index;
 extern int partial_connection_ok;
 extern int tcp_SYN_ack_ok;
 extern int tcp_match_undelivered;
@@ -54,6 +56,11 @@ extern int tcp_max_initial_window;
 extern int tcp_max_above_hole_without_any_acks;
 extern int tcp_excessive_data_without_further_acks;
 extern int tcp_max_old_segments;
+extern bro_uint_t reassembly_coalesce_limit;
+
+extern bro_uint_t buffer_memory_limit;
+extern bro_uint_t buffer_memory_limit_per_conn;
+extern int buffer_eviction_policy;
 
 extern RecordType* socks_address;
 
@@ -15,6 +15,9 @@
 #include "bsd-getopt-long.h"
 #include "logging/writers/ascii/Ascii.h"
 
+// Per-machine state budget for --dfa-precompile without an argument.
+static const int DEFAULT_DFA_PRECOMPILE_STATES = 10000;
+
 void zeek::Options::filter_supervisor_options()
 	{
 	pcap_filter = {};
@@ -41,6 +44,11 @@ void zeek::Options::filter_supervised_node_options()
 	bare_mode = og.bare_mode;
 	perftools_check_leaks = og.perftools_check_leaks;
 	perftools_profile = og.perftools_profile;
+	use_timer_wheel = og.use_timer_wheel;
+	dfa_precompile_states = og.dfa_precompile_states;
+	dfa_cache_dir = og.dfa_cache_dir;
+	compile_scripts = og.compile_scripts;
+	optimize_scripts = og.optimize_scripts;
 
 	pcap_filter = og.pcap_filter;
 	signature_files = og.signature_files;
@@ -112,6 +120,11 @@ void zeek::usage(const char* prog, int code)
 #endif
 	fprintf(stderr, "    --pseudo-realtime[=<speedup>]  | enable pseudo-realtime for performance evaluation (default 1)\n");
 	fprintf(stderr, "    -j|--jobs                      | enable supervisor mode\n");
+	fprintf(stderr, "    --timer-wheel                  | manage timers with a hierarchical timing wheel\n");
+	fprintf(stderr, "    --dfa-precompile[=<states>]    | compute pattern DFAs up front, up to a number of states each (default 10000)\n");
+	fprintf(stderr, "    --dfa-cache <dir>              | cache precompiled DFAs in directory (implies --dfa-precompile)\n");
+	fprintf(stderr, "    --compile-scripts              | execute script functions and event handlers as bytecode\n");
+	fprintf(stderr, "    --optimize-scripts             | fold constants and drop dead code in scripts after parsing\n");
 
 #ifdef USE_IDMEF
 	fprintf(stderr, "    -n|--idmef-dtd <idmef-msg.dtd> | specify path to IDMEF DTD file\n");
@@ -226,6 +239,11 @@ zeek::Options zeek::parse_cmdline(int argc, char** argv)
 
 		{"pseudo-realtime",	optional_argument, nullptr,	'E'},
 		{"jobs",	optional_argument, nullptr,	'j'},
+		{"timer-wheel",	no_argument,		nullptr,	'O'},
+		{"dfa-precompile",	optional_argument, nullptr,	'Y'},
+		{"dfa-cache",	required_argument,	nullptr,	'Z'},
+		{"compile-scripts",	no_argument,	nullptr,	'c'},
+		{"optimize-scripts",	no_argument,	nullptr,	'o'},
 		{"test",		no_argument,		nullptr,	'#'},
 
 		{nullptr,			0,			nullptr,	0},
@@ -257,6 +275,9 @@ zeek::Options zeek::parse_cmdline(int argc, char** argv)
 		case 'b':
 			rval.bare_mode = true;
 			break;
+		case 'c':
+			rval.compile_scripts = true;
+			break;
 		case 'd':
 			rval.debug_scripts = true;
 			break;
@@ -293,6 +314,9 @@ zeek::Options zeek::parse_cmdline(int argc, char** argv)
 				// list of worker/proxy/logger counts like "-j 4,2,1"
 				}
 			break;
+		case 'o':
+			rval.optimize_scripts = true;
+			break;
 		case 'p':
 			rval.script_prefixes.emplace_back(optarg);
 			break;
@@ -351,6 +375,9 @@ zeek::Options zeek::parse_cmdline(int argc, char** argv)
 		case 'N':
 			++rval.print_plugins;
 			break;
+		case 'O':
+			rval.use_timer_wheel = true;
+			break;
 		case 'P':
 			if ( rval.dns_mode != DNS_DEFAULT )
 				usage(zargs[0], 1);
@@ -371,6 +398,16 @@ zeek::Options zeek::parse_cmdline(int argc, char** argv)
 		case 'W':
 			rval.use_watchdog = true;
 			break;
+		case 'Y':
+			rval.dfa_precompile_states = DEFAULT_DFA_PRECOMPILE_STATES;
+			if ( optarg )
+				rval.dfa_precompile_states = atoi(optarg);
+			break;
+		case 'Z':
+			rval.dfa_cache_dir = optarg;
+			if ( ! rval.dfa_precompile_states )
+				rval.dfa_precompile_states = DEFAULT_DFA_PRECOMPILE_STATES;
+			break;
 		case 'X':
 			rval.zeekygen_config_file = optarg;
 			break;
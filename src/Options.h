@@ -53,6 +53,11 @@ struct Options {
 	bool debug_scripts = false;
 	bool perftools_check_leaks = false;
 	bool perftools_profile = false;
+	bool use_timer_wheel = false;
+	int dfa_precompile_states = 0;
+	std::optional<std::string> dfa_cache_dir;
+	bool compile_scripts = false;
+	bool optimize_scripts = false;
 
 	bool run_unit_tests = false;
 	std::vector<std::string> doctest_args;
@@ -11,6 +11,7 @@
 #include "EquivClass.h"
 #include "Reporter.h"
 #include "BroString.h"
+#include "digest.h"
 
 CCL* curr_ccl = nullptr;
 
@@ -145,6 +146,8 @@ bool Specific_RE_Matcher::Compile(bool lazy)
 
 	ecs = EC()->EquivClasses();
 
+	PrecompileDFA(pattern_text);
+
 	return true;
 	}
 
@@ -192,9 +195,41 @@ bool Specific_RE_Matcher::CompileSet(const string_list& set, const int_list& idx
 	dfa = new DFA_Machine(nfa, EC());
 	ecs = EC()->EquivClasses();
 
+	std::string id;
+	for ( int j = 0; j < set.length(); ++j )
+		id += fmt("%d:%s\n", idx[j], set[j]);
+
+	PrecompileDFA(id);
+
 	return true;
 	}
 
+void Specific_RE_Matcher::PrecompileDFA(const std::string& id)
+	{
+	if ( ! dfa_precompile_states || ! dfa )
+		return;
+
+	std::string path;
+
+	if ( ! dfa_cache_dir.empty() )
+		{
+		// The key covers everything going into the machine.
+		std::string key = fmt("%d:%d:", mt, multiline);
+		key += id;
+		key.append(reinterpret_cast<const char*>(ecs), NUM_SYM * sizeof(int));
+
+		u_char digest[MD5_DIGEST_LENGTH];
+		internal_md5(reinterpret_cast<const u_char*>(key.data()), key.size(), digest);
+		path = dfa_cache_dir + "/" + md5_digest_print(digest) + ".dfa";
+
+		if ( dfa->Load(path) )
+			return;
+		}
+
+	if ( dfa->Determinize(dfa_precompile_states) && ! path.empty() )
+		dfa->Save(path);
+	}
+
 std::string Specific_RE_Matcher::LookupDef(const std::string& def)
 	{
 	const auto& iter = defs.find(def);
@@ -267,29 +302,33 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n)
 		// An empty pattern matches anything.
 		return 1;
 
-	DFA_State* d = dfa->StartState();
+	uint32_t d = dfa->CompactID(dfa->StartState());
 
-	d = d->Xtion(ecs[SYM_BOL], dfa);
-	if ( ! d ) return 0;
+	d = dfa->CompactXtion(d, ecs[SYM_BOL]);
+	if ( d == DFA_Machine::COMPACT_JAM ) return 0;
 
-	for ( int i = 0; i < n; ++i )
+	const u_char* p = bv;
+	const u_char* end = bv + n;
+
+	while ( p < end )
 		{
-		int ec = ecs[bv[i]];
-		d = d->Xtion(ec, dfa);
-		if ( ! d )
-			break;
+		uint32_t next = dfa->CompactXtion(d, ecs[*p++]);
+		if ( next == DFA_Machine::COMPACT_JAM )
+			return 0;
 
-		if ( d->Accept() )
-			return i + 1;
-		}
+		if ( next & DFA_Machine::COMPACT_ACCEPT )
+			return p - bv;
 
-	if ( d )
-		{
-		d = d->Xtion(ecs[SYM_EOL], dfa);
-		if ( d && d->Accept() )
-			return n > 0 ? n : 1;	// we can't return 0 here for match...
+		if ( next == d )
+			p = dfa->Accelerate(d, p, end);
+
+		d = next;
 		}
 
+	d = dfa->CompactXtion(d, ecs[SYM_EOL]);
+	if ( d != DFA_Machine::COMPACT_JAM && (d & DFA_Machine::COMPACT_ACCEPT) )
+		return n > 0 ? n : 1;	// we can't return 0 here for match...
+
 	return 0;
 	}
 
@@ -308,6 +347,21 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as,
 		accepted_matches.insert(am_idx(*it, position));
 	}
 
+inline uint32_t RE_Match_State::Step(uint32_t s, int ec)
+	{
+	uint32_t next = dfa->CompactXtion(s, ec);
+
+	if ( next != DFA_Machine::COMPACT_JAM )
+		{
+		if ( next & DFA_Machine::COMPACT_ACCEPT )
+			AddMatches(*dfa->CompactState(next)->Accept(), current_pos);
+
+		++current_pos;
+		}
+
+	return next;
+	}
+
 bool RE_Match_State::Match(const u_char* bv, int n,
 				bool bol, bool eol, bool clear)
 	{
@@ -337,36 +391,33 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 
 	size_t old_matches = accepted_matches.size();
 
-	int ec;
-	int m = bol ? n + 1 : n;
-	int e = eol ? -1 : 0;
+	uint32_t s = dfa->CompactID(current_state);
 
-	while ( --m >= e )
-		{
-		if ( m == n )
-			ec = ecs[SYM_BOL];
-		else if ( m == -1 )
-			ec = ecs[SYM_EOL];
-		else
-			ec = ecs[*(bv++)];
+	if ( bol )
+		s = Step(s, ecs[SYM_BOL]);
 
-		DFA_State* next_state = current_state->Xtion(ec,dfa);
+	const u_char* p = bv;
+	const u_char* end = bv + n;
 
-		if ( ! next_state )
+	while ( p < end && s != DFA_Machine::COMPACT_JAM )
+		{
+		uint32_t next = Step(s, ecs[*p++]);
+
+		if ( next == s )
 			{
-			current_state = nullptr;
-			break;
+			// Skip over input that keeps us here.
+			const u_char* q = dfa->Accelerate(s, p, end);
+			current_pos += q - p;
+			p = q;
 			}
 
-		const AcceptingSet* ac = next_state->Accept();
+		s = next;
+		}
 
-		if ( ac )
-			AddMatches(*ac, current_pos);
+	if ( eol && s != DFA_Machine::COMPACT_JAM )
+		s = Step(s, ecs[SYM_EOL]);
 
-		++current_pos;
-
-		current_state = next_state;
-		}
+	current_state = dfa->CompactState(s);
 
 	return accepted_matches.size() != old_matches;
 	}
@@ -122,6 +122,10 @@ protected:
 	bool MatchAll(const u_char* bv, int n);
 	int Match(const u_char* bv, int n);
 
+	// Computes the DFA up front if so configured, going through the
+	// DFA cache. The id identifies the patterns the DFA was built from.
+	void PrecompileDFA(const std::string& id);
+
 	match_type mt;
 	int multiline;
 	char* pattern_text;
@@ -166,6 +170,10 @@ public:
 	void AddMatches(const AcceptingSet& as, MatchPos position);
 
 protected:
+	// Advances the compact DFA state s by one symbol, recording any
+	// matches. Returns the new state.
+	uint32_t Step(uint32_t s, int ec);
+
 	DFA_Machine* dfa;
 	int* ecs;
 
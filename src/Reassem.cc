@@ -6,6 +6,7 @@
 #include <algorithm>
 
 #include "Desc.h"
+#include "NetVar.h"
 
 using std::min;
 
@@ -16,10 +17,27 @@ DataBlock::DataBlock(const u_char* data, uint64_t size, uint64_t arg_seq)
 	{
 	seq = arg_seq;
 	upper = seq + size;
-	block = new u_char[size];
+	block = AllocBlock(size);
 	memcpy(block, data, size);
 	}
 
+void DataBlock::Extend(const u_char* data, uint64_t size)
+	{
+	uint64_t old_size = Size();
+	uint64_t new_size = old_size + size;
+
+	if ( SlabAllocator::Capacity(old_size) < new_size )
+		{
+		u_char* b = AllocBlock(new_size);
+		memcpy(b, block, old_size);
+		FreeBlock(block, old_size);
+		block = b;
+		}
+
+	memcpy(block + old_size, data, size);
+	upper += size;
+	}
+
 void DataBlockList::DataSize(uint64_t seq_cutoff, uint64_t* below, uint64_t* above) const
 	{
 	for ( const auto& e : block_map )
@@ -112,6 +130,30 @@ DataBlockList::Insert(uint64_t seq, uint64_t upper, const u_char* data,
 	return rval;
 	}
 
+bool DataBlockList::Coalesce(uint64_t seq, uint64_t upper, const u_char* data)
+	{
+	if ( ! reassembly_coalesce_limit )
+		return false;
+
+	auto& last = block_map.rbegin()->second;
+	auto size = upper - seq;
+
+	// Once a block has been delivered, the reassembler won't look at it
+	// for delivery again, so we can only add to ones still waiting
+	// behind a hole.
+	if ( last.seq <= reassembler->LastReassemSeq() ||
+	     last.Size() + size > reassembly_coalesce_limit )
+		return false;
+
+	last.Extend(data, size);
+
+	total_data_size += size;
+	Reassembler::sizes[reassembler->rtype] += size;
+	Reassembler::total_size += size;
+
+	return true;
+	}
+
 DataBlockMap::const_iterator
 DataBlockList::Insert(uint64_t seq, uint64_t upper, const u_char* data,
                       DataBlockMap::const_iterator* hint)
@@ -124,7 +166,12 @@ DataBlockList::Insert(uint64_t seq, uint64_t upper, const u_char* data,
 
 	// Special check for the common case of appending to the end.
 	if ( seq == last.upper )
+		{
+		if ( Coalesce(seq, upper, data) )
+			return std::prev(block_map.end());
+
 		return Insert(seq, upper, data, block_map.end());
+		}
 
 	// Find the first block that doesn't come completely before the new data.
 	DataBlockMap::const_iterator it;
@@ -201,9 +248,11 @@ uint64_t DataBlockList::Trim(uint64_t seq, uint64_t max_old,
 		{
 		const auto& first = block_map.begin()->second;
 
-		if ( first.seq > reassembler->LastReassemSeq() )
-			// An initial hole.
-			num_missing += first.seq - reassembler->LastReassemSeq();
+		// An initial hole, as far as it's being trimmed. Data before
+		// it may have been delivered without having been buffered.
+		if ( first.seq > reassembler->LastReassemSeq() &&
+		     seq > reassembler->LastReassemSeq() )
+			num_missing += min(first.seq, seq) - reassembler->LastReassemSeq();
 		}
 	else if ( seq > reassembler->LastReassemSeq() )
 		{
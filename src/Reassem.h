@@ -5,6 +5,7 @@
 #include <map>
 
 #include "Obj.h"
+#include "Slab.h"
 
 #include <assert.h>
 #include <string.h>
@@ -42,7 +43,7 @@ public:
 		seq = other.seq;
 		upper = other.upper;
 		auto size = other.Size();
-		block = new u_char[size];
+		block = AllocBlock(size);
 		memcpy(block, other.block, size);
 		}
 
@@ -59,11 +60,11 @@ public:
 		if ( this == &other )
 			return *this;
 
+		FreeBlock(block, Size());
 		seq = other.seq;
 		upper = other.upper;
 		auto size = other.Size();
-		delete [] block;
-		block = new u_char[size];
+		block = AllocBlock(size);
 		memcpy(block, other.block, size);
 		return *this;
 		}
@@ -73,16 +74,16 @@ public:
 		if ( this == &other )
 			return *this;
 
+		FreeBlock(block, Size());
 		seq = other.seq;
 		upper = other.upper;
-		delete [] block;
 		block = other.block;
 		other.block = nullptr;
 		return *this;
 		}
 
 	~DataBlock()
-		{ delete [] block; }
+		{ FreeBlock(block, Size()); }
 
 	/**
 	 * @return length of the data block
@@ -90,12 +91,26 @@ public:
 	uint64_t Size() const
 		{ return upper - seq; }
 
+	/**
+	 * Appends data to the end of the block.
+	 */
+	void Extend(const u_char* data, uint64_t size);
+
 	uint64_t seq;
 	uint64_t upper;
 	u_char* block;
+
+private:
+	// Payloads come from the slab allocator's size classes.
+	static u_char* AllocBlock(uint64_t size)
+		{ return static_cast<u_char*>(slab_allocator.Allocate(size)); }
+
+	static void FreeBlock(u_char* block, uint64_t size)
+		{ slab_allocator.Free(block, size); }
 };
 
-using DataBlockMap = std::map<uint64_t, DataBlock>;
+using DataBlockMap = std::map<uint64_t, DataBlock, std::less<uint64_t>,
+                              SlabSTLAllocator<std::pair<const uint64_t, DataBlock>>>;
 
 
 /**
@@ -231,6 +246,17 @@ private:
 	Insert(uint64_t seq, uint64_t upper, const u_char* data,
 	       DataBlockMap::const_iterator hint);
 
+	/**
+	 * Appends data to the last block of the list if that's allowed by
+	 * reassembly_coalesce_limit and the block hasn't been delivered yet.
+	 * @param seq  lower sequence number of the data, which must be the
+	 * last block's upper one
+	 * @param upper  highest sequence number of the data
+	 * @param data  points to the data
+	 * @return whether the data was appended
+	 */
+	bool Coalesce(uint64_t seq, uint64_t upper, const u_char* data);
+
 	/**
 	 * Removes a block from the list and updates other state which keeps
 	 * track of total size of blocks.
@@ -251,7 +277,7 @@ private:
 	DataBlockMap block_map;
 };
 
-class Reassembler : public BroObj {
+class Reassembler : public BroObj, public SlabAllocated {
 public:
 	Reassembler(uint64_t init_seq, ReassemblerType reassem_type = REASSEM_UNKNOWN);
 	~Reassembler() override	{}
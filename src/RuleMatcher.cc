@@ -14,6 +14,7 @@
 #include "IP.h"
 #include "analyzer/Analyzer.h"
 #include "DFA.h"
+#include "LiteralSet.h"
 #include "DebugLogger.h"
 #include "NetVar.h"
 #include "Scope.h"
@@ -57,6 +58,9 @@ RuleHdrTest::RuleHdrTest(Prot arg_prot, uint32_t arg_offset, uint32_t arg_size,
 	ruleset = new IntSet;
 	id = ++idcounter;
 	level = 0;
+
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		prefilters[i] = nullptr;
 	}
 
 RuleHdrTest::RuleHdrTest(Prot arg_prot, Comp arg_comp, vector<IPPrefix> arg_v)
@@ -74,6 +78,9 @@ RuleHdrTest::RuleHdrTest(Prot arg_prot, Comp arg_comp, vector<IPPrefix> arg_v)
 	ruleset = new IntSet;
 	id = ++idcounter;
 	level = 0;
+
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		prefilters[i] = nullptr;
 	}
 
 Val* RuleMatcher::BuildRuleStateValue(const Rule* rule,
@@ -122,6 +129,9 @@ RuleHdrTest::RuleHdrTest(RuleHdrTest& h)
 	ruleset = new IntSet;
 	id = ++idcounter;
 	level = 0;
+
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		prefilters[i] = nullptr;
 	}
 
 RuleHdrTest::~RuleHdrTest()
@@ -137,6 +147,12 @@ RuleHdrTest::~RuleHdrTest()
 			delete pset->re;
 			delete pset;
 			}
+
+		if ( prefilters[i] )
+			{
+			delete prefilters[i]->literals;
+			delete prefilters[i];
+			}
 		}
 
 	delete ruleset;
@@ -201,6 +217,9 @@ RuleEndpointState::~RuleEndpointState()
 		delete matcher;
 		}
 
+	for ( auto prefilter : prefilters )
+		delete prefilter;
+
 	for ( auto text : matched_text )
 		delete text;
 	}
@@ -395,7 +414,8 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], &hdr_test->prefilters[i],
+				                 exprs[i], ids[i]);
 		}
 
 	// Get the patterns on all of our children.
@@ -422,45 +442,167 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], &hdr_test->prefilters[i],
+				                 exprs[i], ids[i]);
 		}
 
 	// If we're below the RE_level, the regexprs remains empty.
 	}
 
+// Patterns shorter than this don't get prefiltered, as their literals
+// would show up too often to be of any help.
+static const int MIN_PREFILTER_LITERAL = 3;
+
+// Patterns longer than this don't get prefiltered, as we'd need to keep
+// too much input around.
+static const int MAX_PREFILTER_WINDOW = 256;
+
+// Determines whether a pattern can be prefiltered. It needs to be of the
+// form ".*R", where R contains neither anchors nor repetitions, and
+// includes a literal of at least MIN_PREFILTER_LITERAL bytes. Any match
+// then ends with R, and contains that literal. Returns the longest such
+// literal along with R's length.
+static bool prefilter_literal(const char* pattern, string* literal, int* len)
+	{
+	if ( strncmp(pattern, ".*", 2) != 0 )
+		return false;
+
+	string run;
+	literal->clear();
+	*len = 0;
+
+	for ( const char* p = pattern + 2; *p; ++p )
+		{
+		int c = -1;	// -1 for anything matching more than one byte
+
+		switch ( *p ) {
+		case '\\':
+			if ( ! p[1] )
+				return false;
+
+			++p;
+			c = expand_escape(p);
+			--p;
+			break;
+
+		case '[':
+			// Skip the character class, which may start with
+			// a ']' of its own.
+			if ( *++p == '^' )
+				++p;
+
+			if ( *p == ']' )
+				++p;
+
+			for ( ; *p && *p != ']'; ++p )
+				if ( *p == '\\' && p[1] )
+					++p;
+
+			if ( ! *p )
+				return false;
+
+			break;
+
+		case '.':
+			break;
+
+		case '*': case '+': case '?': case '{': case '}':
+		case '|': case '(': case ')': case '^': case '$': case '"':
+			return false;
+
+		default:
+			c = static_cast<u_char>(*p);
+			break;
+		}
+
+		++*len;
+
+		if ( c < 0 )
+			run.clear();
+		else
+			{
+			run += static_cast<char>(c);
+
+			if ( run.size() > literal->size() )
+				*literal = run;
+			}
+		}
+
+	return literal->size() >= MIN_PREFILTER_LITERAL &&
+	       *len <= MAX_PREFILTER_WINDOW;
+	}
+
 void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
+				RulePrefilter** prefilter,
 				const string_list& exprs, const int_list& ids)
 	{
 	assert(static_cast<size_t>(exprs.length()) == ids.size());
 
-	// We build groups of at most sig_max_group_size regexps.
+	// We build groups of at most sig_max_group_size regexps. Patterns
+	// that can be prefiltered go into groups of their own, indexed 1.
 
-	string_list group_exprs;
-	int_list group_ids;
+	string_list group_exprs[2];
+	int_list group_ids[2];
+	vector<string> group_literals;
 
-	for ( int i = 0; i < exprs.length() + 1 /* sic! */; i++ )
+	auto build_set = [&](int prefiltered)
 		{
-		if ( i < exprs.length() )
+		if ( ! group_exprs[prefiltered].length() )
+			return;
+
+		RuleHdrTest::PatternSet* set =
+			new RuleHdrTest::PatternSet;
+		set->re = new Specific_RE_Matcher(MATCH_EXACTLY, 1);
+		set->re->CompileSet(group_exprs[prefiltered], group_ids[prefiltered]);
+		set->patterns = group_exprs[prefiltered];
+		set->ids = group_ids[prefiltered];
+		set->prefiltered = prefiltered;
+
+		if ( prefiltered )
 			{
-			group_exprs.push_back(exprs[i]);
-			group_ids.push_back(ids[i]);
+			if ( ! *prefilter )
+				*prefilter = new RulePrefilter{new LiteralSet, 0};
+
+			for ( const auto& l : group_literals )
+				(*prefilter)->literals->Add(l, dst->length());
+
+			group_literals.clear();
 			}
 
-		if ( group_exprs.length() > sig_max_group_size ||
-		     i == exprs.length() )
+		dst->push_back(set);
+
+		group_exprs[prefiltered].clear();
+		group_ids[prefiltered].clear();
+		};
+
+	for ( int i = 0; i < exprs.length(); i++ )
+		{
+		string literal;
+		int len;
+		int prefiltered = prefilter_literal(exprs[i], &literal, &len);
+
+		group_exprs[prefiltered].push_back(exprs[i]);
+		group_ids[prefiltered].push_back(ids[i]);
+
+		if ( prefiltered )
 			{
-			RuleHdrTest::PatternSet* set =
-				new RuleHdrTest::PatternSet;
-			set->re = new Specific_RE_Matcher(MATCH_EXACTLY, 1);
-			set->re->CompileSet(group_exprs, group_ids);
-			set->patterns = group_exprs;
-			set->ids = group_ids;
-			dst->push_back(set);
-
-			group_exprs.clear();
-			group_ids.clear();
+			group_literals.push_back(literal);
+
+			if ( ! *prefilter )
+				*prefilter = new RulePrefilter{new LiteralSet, 0};
+
+			(*prefilter)->window = max((*prefilter)->window, len);
 			}
+
+		if ( group_exprs[prefiltered].length() > sig_max_group_size )
+			build_set(prefiltered);
 		}
+
+	build_set(0);
+	build_set(1);
+
+	if ( *prefilter )
+		(*prefilter)->literals->Compile();
 	}
 
 // Get a 8/16/32-bit value from the given position in the packet header
@@ -769,15 +911,33 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 			{
 			for ( int i = Rule::PAYLOAD; i < Rule::TYPES; ++i )
 				{
-				for ( const auto& set : hdr_test->psets[i] )
+				RuleEndpointState::Prefilter* pf = nullptr;
+
+				if ( hdr_test->prefilters[i] )
 					{
+					pf = new RuleEndpointState::Prefilter;
+					pf->prefilter = hdr_test->prefilters[i];
+					pf->type = (Rule::PatternType) i;
+					pf->literal_state = 0;
+					pf->matchers.resize(hdr_test->psets[i].length());
+					pf->found.resize(pf->prefilter->literals->NumIDs());
+					state->prefilters.push_back(pf);
+					}
+
+				loop_over_list(hdr_test->psets[i], j)
+					{
+					const auto& set = hdr_test->psets[i][j];
 					assert(set->re);
 
 					RuleEndpointState::Matcher* m =
 						new RuleEndpointState::Matcher;
 					m->state = new RE_Match_State(set->re);
 					m->type = (Rule::PatternType) i;
+					m->dormant = set->prefiltered;
 					state->matchers.push_back(m);
+
+					if ( set->prefiltered )
+						pf->matchers[j] = m;
 					}
 				}
 			}
@@ -886,10 +1046,13 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type,
 			state->payload_size = 0;
 		}
 
+	if ( state->prefilters.length() )
+		RunPrefilters(state, type, data, data_len, bol, eol, clear);
+
 	// Feed data into all relevant matchers.
 	for ( const auto& m : state->matchers )
 		{
-		if ( m->type == type &&
+		if ( m->type == type && ! m->dormant &&
 		     m->state->Match((const u_char*) data, data_len,
 					bol, eol, clear) )
 			newmatch = true;
@@ -970,6 +1133,69 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type,
 		}
 	}
 
+void RuleMatcher::RunPrefilters(RuleEndpointState* state, Rule::PatternType type,
+				const u_char* data, int data_len,
+				bool bol, bool eol, bool clear)
+	{
+	for ( const auto& pf : state->prefilters )
+		{
+		if ( pf->type != type )
+			continue;
+
+		if ( clear )
+			{
+			pf->literal_state = 0;
+			pf->history.clear();
+			}
+
+		if ( pf->prefilter->literals->Search(&pf->literal_state, data,
+		                                     data_len, &pf->found) )
+			{
+			for ( size_t i = 0; i < pf->found.size(); ++i )
+				{
+				if ( ! pf->found[i] )
+					continue;
+
+				pf->found[i] = false;
+				RuleEndpointState::Matcher* m = pf->matchers[i];
+
+				if ( ! m || ! m->dormant )
+					continue;
+
+				DBG_LOG(DBG_RULES, "Prefilter activates pattern set %zu", i);
+
+				// A match may have begun in the preceding input.
+				// As the patterns don't have anchors, running
+				// the set on just the window before this chunk
+				// sets it up as if it had seen everything.
+				// Match positions count from the start of each
+				// Match() call, and no match can end before the
+				// literal that just showed up in this chunk, so
+				// depth checks come out as if the set had been
+				// running all along.
+				m->dormant = false;
+
+				if ( ! pf->history.empty() )
+					m->state->Match((const u_char*) pf->history.data(),
+					                pf->history.size(), true, false, false);
+				}
+			}
+
+		// Keep the most recent input around.
+		int window = pf->prefilter->window;
+
+		if ( data_len >= window )
+			pf->history.assign((const char*) data + data_len - window, window);
+		else
+			{
+			pf->history.append((const char*) data, data_len);
+
+			if ( static_cast<int>(pf->history.size()) > window )
+				pf->history.erase(0, pf->history.size() - window);
+			}
+		}
+	}
+
 void RuleMatcher::FinishEndpoint(RuleEndpointState* state)
 	{
 	// Send EOL to payload matchers.
@@ -1123,6 +1349,16 @@ void RuleMatcher::ClearEndpointState(RuleEndpointState* state)
 
 	for ( const auto& matcher : state->matchers )
 		matcher->state->Clear();
+
+	for ( const auto& pf : state->prefilters )
+		{
+		pf->literal_state = 0;
+		pf->history.clear();
+
+		for ( auto m : pf->matchers )
+			if ( m )
+				m->dormant = true;
+		}
 	}
 
 void RuleMatcher::ClearFileMagicState(RuleFileMagicState* state) const
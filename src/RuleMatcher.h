@@ -34,6 +34,7 @@ class IP_Hdr;
 class IPPrefix;
 class RE_Match_State;
 class Specific_RE_Matcher;
+class LiteralSet;
 class RuleMatcher;
 extern RuleMatcher* rule_matcher;
 
@@ -66,6 +67,18 @@ extern void id_to_maskedvallist(const char* id, maskedvalue_list* append_to,
 extern char* id_to_str(const char* id);
 extern uint32_t id_to_uint(const char* id);
 
+// For the pattern sets of one RuleHdrTest node and pattern type whose
+// patterns can only match after one of a few literals has shown up.
+// Searching the input for these literals determines which of the sets
+// need to run at all.
+struct RulePrefilter {
+	// Reports indices into the node's pattern sets.
+	LiteralSet* literals;
+
+	// The maximum length of a match.
+	int window;
+};
+
 class RuleHdrTest {
 public:
 	// Note: Adapt RuleHdrTest::PrintDebug() when changing these enums.
@@ -114,11 +127,18 @@ private:
 		// All the patterns and their rule indices.
 		string_list patterns;
 		int_list ids;	// (only needed for debugging)
+
+		// True if the set needs to run only once the prefilter
+		// found one of its literals.
+		bool prefiltered;
 	};
 
 	typedef PList<PatternSet> pattern_set_list;
 	pattern_set_list psets[Rule::TYPES];
 
+	// Null if none of the pattern sets is prefiltered.
+	RulePrefilter* prefilters[Rule::TYPES];
+
 	// List of rules belonging to this node.
 	Rule* pattern_rules;	// rules w/ at least one pattern of any type
 	Rule* pure_rules;	// rules containing no patterns at all
@@ -163,15 +183,37 @@ private:
 	struct Matcher {
 		RE_Match_State* state;
 		Rule::PatternType type;
+
+		// True while waiting for the prefilter.
+		bool dormant;
 	};
 
 	typedef PList<Matcher> matcher_list;
 
+	// The state of one RulePrefilter for the stream.
+	struct Prefilter {
+		const RulePrefilter* prefilter;
+		Rule::PatternType type;
+		int literal_state;
+
+		// The most recent input, for catching up the pattern sets
+		// that become active.
+		std::string history;
+
+		// Indexed like the node's pattern sets; null for those not
+		// prefiltered.
+		std::vector<Matcher*> matchers;
+		std::vector<bool> found;
+	};
+
+	typedef PList<Prefilter> prefilter_list;
+
 	analyzer::Analyzer* analyzer;
 	RuleEndpointState* opposite;
 	analyzer::pia::PIA* pia;
 
 	matcher_list matchers;
+	prefilter_list prefilters;
 	rule_hdr_test_list hdr_tests;
 
 	// The follow tracks which rules for which all patterns have matched,
@@ -324,10 +366,18 @@ private:
 	// Traverse tree building the combined regular expressions.
 	void BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs, int_list* ids);
 
-	// Build groups of regular epxressions.
+	// Build groups of regular epxressions, with a prefilter for those
+	// that permit one.
 	void BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
+				RulePrefilter** prefilter,
 				const string_list& exprs, const int_list& ids);
 
+	// Runs the endpoint's prefilters on new input and wakes up the
+	// pattern sets for which they found a literal.
+	void RunPrefilters(RuleEndpointState* state, Rule::PatternType type,
+				const u_char* data, int data_len,
+				bool bol, bool eol, bool clear);
+
 	// Check an arbitrary rule if it's satisfied right now.
 	// eos signals end of stream
 	void ExecRule(Rule* rule, RuleEndpointState* state, bool eos);
@@ -0,0 +1,410 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ScriptOpt.h"
+
+#include "Expr.h"
+#include "Stmt.h"
+#include "Func.h"
+#include "ID.h"
+#include "Scope.h"
+#include "Traverse.h"
+#include "Reporter.h"
+#include "DebugLogger.h"
+#include "plugin/Manager.h"
+
+bool optimize_scripts = false;
+
+ScriptOptimizer::Stats ScriptOptimizer::stats;
+
+// Collects the globals that scripts assign to.
+class AssignedGlobalsCallback : public TraversalCallback {
+public:
+	explicit AssignedGlobalsCallback(std::unordered_set<const ID*>* arg_ids)
+		: ids(arg_ids)	{ }
+
+	TraversalCode PreExpr(const Expr* e) override
+		{
+		const Expr* target = nullptr;
+
+		switch ( e->Tag() ) {
+		case EXPR_REF:
+		case EXPR_INCR:
+		case EXPR_DECR:
+			target = static_cast<const UnaryExpr*>(e)->Op();
+			break;
+
+		case EXPR_ASSIGN:
+		case EXPR_ADD_TO:
+		case EXPR_REMOVE_FROM:
+			target = static_cast<const BinaryExpr*>(e)->Op1();
+			break;
+
+		default:
+			break;
+		}
+
+		if ( target && target->Tag() == EXPR_NAME )
+			{
+			const ID* id = target->AsNameExpr()->Id();
+
+			if ( id->IsGlobal() )
+				ids->insert(id);
+			}
+
+		return TC_CONTINUE;
+		}
+
+private:
+	std::unordered_set<const ID*>* ids;
+};
+
+// Returns whether a statement does nothing at all. Initializing locals
+// doesn't count as doing something, since nothing else would see them.
+static bool is_empty(const Stmt* s)
+	{
+	switch ( s->Tag() ) {
+	case STMT_NULL:
+	case STMT_INIT:
+		return true;
+
+	case STMT_LIST:
+	case STMT_EVENT_BODY_LIST:
+		for ( const auto& stmt : s->AsStmtList()->Stmts() )
+			if ( ! is_empty(stmt) )
+				return false;
+
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+// Returns the one statement that a body consists of besides empty ones,
+// or nil if there's more or less than that.
+static const Stmt* single_stmt(const Stmt* s)
+	{
+	if ( s->Tag() != STMT_LIST && s->Tag() != STMT_EVENT_BODY_LIST )
+		return is_empty(s) ? nullptr : s;
+
+	const Stmt* single = nullptr;
+
+	for ( const auto& stmt : s->AsStmtList()->Stmts() )
+		{
+		if ( is_empty(stmt) )
+			continue;
+
+		if ( single )
+			return nullptr;
+
+		single = single_stmt(stmt);
+
+		if ( ! single )
+			return nullptr;
+		}
+
+	return single;
+	}
+
+void ScriptOptimizer::Run()
+	{
+	AssignedGlobalsCallback cb(&assigned_globals);
+	traverse_all(&cb);
+
+	for ( const auto& entry : global_scope()->Vars() )
+		{
+		ID* id = entry.second.get();
+		Val* v = id->ID_Val();
+
+		if ( ! v || id->AsType() || ! IsFunc(v->Type()->Tag()) )
+			continue;
+
+		Func* f = v->AsFunc();
+
+		if ( f->GetKind() == Func::BRO_FUNC )
+			OptimizeFunc(static_cast<BroFunc*>(f));
+		}
+
+	DBG_LOG(DBG_SCRIPTS, "optimizer: %" PRIu64 " globals resolved, %" PRIu64
+	        " expressions folded, %" PRIu64 " calls inlined, %" PRIu64
+	        " branches resolved, %" PRIu64 " bodies dropped",
+	        stats.globals, stats.folded, stats.inlined, stats.branches,
+	        stats.bodies);
+	}
+
+void ScriptOptimizer::OptimizeFunc(BroFunc* f)
+	{
+	if ( ! done_funcs.insert(f).second )
+		return;
+
+	f->OptimizeBodies(this);
+	}
+
+IntrusivePtr<Stmt> ScriptOptimizer::OptimizeBody(IntrusivePtr<Stmt> body,
+                                                 const BroFunc* f)
+	{
+	body = Optimize(std::move(body));
+
+	// Functions need their body even if it's empty, but events and
+	// hooks do fine without.
+	if ( f->Flavor() != FUNC_FLAVOR_FUNCTION && is_empty(body.get()) )
+		{
+		++stats.bodies;
+		return nullptr;
+		}
+
+	return body;
+	}
+
+IntrusivePtr<Stmt> ScriptOptimizer::Optimize(IntrusivePtr<Stmt> s)
+	{
+	if ( ! s )
+		return s;
+
+	s->OptimizeChildren(this);
+
+	switch ( s->Tag() ) {
+	case STMT_IF:
+		{
+		auto if_stmt = static_cast<IfStmt*>(s.get());
+		const Expr* cond = if_stmt->StmtExpr();
+
+		if ( ! cond->IsConst() || cond->Type()->Tag() != TYPE_BOOL )
+			break;
+
+		++stats.branches;
+
+		Stmt* branch = cond->ExprVal()->IsZero() ?
+			if_stmt->FalseBranch() : if_stmt->TrueBranch();
+
+		if ( branch )
+			return {NewRef{}, branch};
+
+		return make_intrusive<NullStmt>();
+		}
+
+	case STMT_WHILE:
+		{
+		const Expr* cond = static_cast<WhileStmt*>(s.get())->Condition();
+
+		if ( cond->IsConst() && cond->ExprVal()->IsZero() )
+			{
+			++stats.branches;
+			return make_intrusive<NullStmt>();
+			}
+
+		break;
+		}
+
+	default:
+		break;
+	}
+
+	return s;
+	}
+
+IntrusivePtr<Expr> ScriptOptimizer::Optimize(IntrusivePtr<Expr> e)
+	{
+	if ( ! e || e->IsError() )
+		return e;
+
+	e->OptimizeChildren(this);
+
+	switch ( e->Tag() ) {
+	case EXPR_NAME:
+		return ResolveGlobal(std::move(e));
+
+	case EXPR_CALL:
+		return Inline(std::move(e));
+
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+		e = ShortCircuit(std::move(e));
+		break;
+
+	default:
+		break;
+	}
+
+	return Fold(std::move(e));
+	}
+
+IntrusivePtr<Expr> ScriptOptimizer::ResolveGlobal(IntrusivePtr<Expr> e)
+	{
+	ID* id = e->AsNameExpr()->Id();
+
+	if ( ! id->IsGlobal() || ! id->HasVal() || id->IsOption() ||
+	     ! is_atomic_type(id->Type()) )
+		return e;
+
+	// Constants are fixed now that any redefs have happened, and so
+	// are redefinable globals that scripts leave alone.
+	if ( ! id->IsConst() &&
+	     ! (id->IsRedefinable() && ! assigned_globals.count(id)) )
+		return e;
+
+	++stats.globals;
+	return MakeConst({NewRef{}, id->ID_Val()}, e.get());
+	}
+
+IntrusivePtr<Expr> ScriptOptimizer::ShortCircuit(IntrusivePtr<Expr> e)
+	{
+	auto b = static_cast<BinaryExpr*>(e.get());
+	Expr* op1 = b->Op1();
+
+	if ( ! op1->IsConst() || e->Type()->Tag() != TYPE_BOOL )
+		return e;
+
+	bool is_and = e->Tag() == EXPR_AND_AND;
+	bool v1 = ! op1->ExprVal()->IsZero();
+
+	// "F && x" and "T || x" don't look at x ...
+	if ( v1 != is_and )
+		{
+		++stats.folded;
+		return MakeConst({NewRef{}, op1->ExprVal()}, e.get());
+		}
+
+	// ... while "T && x" and "F || x" amount to x.
+	++stats.folded;
+	return {NewRef{}, b->Op2()};
+	}
+
+IntrusivePtr<Expr> ScriptOptimizer::Fold(IntrusivePtr<Expr> e)
+	{
+	// Operators on atomic values that can't fail, and whose result
+	// only depends on the operands.
+	const Expr* ops[3] = { nullptr, nullptr, nullptr };
+
+	switch ( e->Tag() ) {
+	case EXPR_NOT:
+	case EXPR_COMPLEMENT:
+	case EXPR_POSITIVE:
+	case EXPR_NEGATE:
+	case EXPR_SIZE:
+	case EXPR_ARITH_COERCE:
+		ops[0] = static_cast<const UnaryExpr*>(e.get())->Op();
+		break;
+
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+		{
+		auto b = static_cast<const BinaryExpr*>(e.get());
+
+		// Leave run-time errors to run-time, and so subnet
+		// construction, too.
+		if ( b->Op2()->IsZero() || b->Op1()->Type()->Tag() == TYPE_ADDR )
+			return e;
+		}
+		// fall through
+
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_AND:
+	case EXPR_OR:
+	case EXPR_XOR:
+	case EXPR_AND_AND:
+	case EXPR_OR_OR:
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+	case EXPR_IN:
+		ops[0] = static_cast<const BinaryExpr*>(e.get())->Op1();
+		ops[1] = static_cast<const BinaryExpr*>(e.get())->Op2();
+		break;
+
+	case EXPR_COND:
+		ops[0] = static_cast<const CondExpr*>(e.get())->Op1();
+		ops[1] = static_cast<const CondExpr*>(e.get())->Op2();
+		ops[2] = static_cast<const CondExpr*>(e.get())->Op3();
+		break;
+
+	default:
+		return e;
+	}
+
+	if ( ! is_atomic_type(e->Type()) )
+		return e;
+
+	for ( auto op : ops )
+		if ( op && ! (op->IsConst() && is_atomic_type(op->Type())) )
+			return e;
+
+	IntrusivePtr<Val> v;
+
+	try
+		{
+		v = e->Eval(nullptr);
+		}
+	catch ( InterpreterException& )
+		{
+		return e;
+		}
+
+	if ( ! v )
+		return e;
+
+	++stats.folded;
+	return MakeConst(std::move(v), e.get());
+	}
+
+IntrusivePtr<Expr> ScriptOptimizer::Inline(IntrusivePtr<Expr> e)
+	{
+	auto call = static_cast<CallExpr*>(e.get());
+	const Expr* func = call->Func();
+
+	// Plugins may want to see the call.
+	if ( plugin_mgr->HavePluginForHook(plugin::HOOK_CALL_FUNCTION) )
+		return e;
+
+	if ( func->Tag() != EXPR_NAME || ! call->Args()->IsPure() )
+		return e;
+
+	ID* id = func->AsNameExpr()->Id();
+
+	if ( ! id->IsGlobal() || ! id->IsConst() || assigned_globals.count(id) )
+		return e;
+
+	Val* fv = id->ID_Val();
+
+	if ( ! fv || ! IsFunc(fv->Type()->Tag()) )
+		return e;
+
+	Func* f = fv->AsFunc();
+
+	if ( f->GetKind() != Func::BRO_FUNC ||
+	     f->Flavor() != FUNC_FLAVOR_FUNCTION ||
+	     f->GetBodies().size() != 1 )
+		return e;
+
+	// Get to the callee's final form first. Recursive calls find it
+	// in progress and don't get inlined.
+	OptimizeFunc(static_cast<BroFunc*>(f));
+
+	const Stmt* s = single_stmt(f->GetBodies()[0].stmts.get());
+
+	if ( ! s || s->Tag() != STMT_RETURN )
+		return e;
+
+	const Expr* rv = static_cast<const ReturnStmt*>(s)->StmtExpr();
+
+	if ( ! rv || ! rv->IsConst() || ! is_atomic_type(rv->Type()) ||
+	     ! same_type(rv->Type(), e->Type()) )
+		return e;
+
+	++stats.inlined;
+	return MakeConst({NewRef{}, rv->ExprVal()}, e.get());
+	}
+
+IntrusivePtr<Expr> ScriptOptimizer::MakeConst(IntrusivePtr<Val> v, const Expr* orig)
+	{
+	auto c = make_intrusive<ConstExpr>(std::move(v));
+	c->SetLocationInfo(orig->GetLocationInfo());
+	return c;
+	}
@@ -0,0 +1,102 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <unordered_set>
+
+#include <stdint.h>
+
+#include "IntrusivePtr.h"
+
+class Expr;
+class Stmt;
+class ID;
+class Val;
+class BroFunc;
+
+// Whether scripts get optimized once parsed (--optimize-scripts).
+extern bool optimize_scripts;
+
+/**
+ * A pass over the parsed scripts that rewrites the bodies of functions,
+ * hooks and event handlers in place before anything executes. It
+ *
+ *   - replaces references to globals whose values are fixed once parsing
+ *     has finished by the values: constants, and &redef globals that no
+ *     script assigns to (both only for atomic types, and not options);
+ *
+ *   - folds operators applied to constants into constants;
+ *
+ *   - replaces calls of functions whose body just returns a constant by
+ *     the constant, if the arguments don't have side effects;
+ *
+ *   - replaces if statements with a constant condition by the branch
+ *     taken, and while loops with a constant false condition by nothing;
+ *
+ *   - drops hook and event handler bodies left without any statements,
+ *     so that events no longer handled aren't even raised.
+ *
+ * What it did shows up in the profiling log.
+ */
+class ScriptOptimizer {
+public:
+	struct Stats {
+		uint64_t globals;	// references to globals resolved
+		uint64_t folded;	// expressions folded into constants
+		uint64_t inlined;	// calls inlined
+		uint64_t branches;	// if/while statements resolved
+		uint64_t bodies;	// handler bodies dropped
+	};
+
+	/**
+	 * Optimizes all functions, hooks and event handlers defined at
+	 * global scope. To be called once, after parsing.
+	 */
+	void Run();
+
+	/**
+	 * Optimizes an expression after optimizing its operands.
+	 *
+	 * @return The expression, or an equivalent one to replace it with.
+	 */
+	IntrusivePtr<Expr> Optimize(IntrusivePtr<Expr> e);
+
+	/**
+	 * Optimizes a statement after optimizing the statements and
+	 * expressions it contains.
+	 *
+	 * @return The statement, or an equivalent one to replace it with.
+	 */
+	IntrusivePtr<Stmt> Optimize(IntrusivePtr<Stmt> s);
+
+	/**
+	 * Optimizes a body of the given function.
+	 *
+	 * @return The body to replace it with, or nil if the body can be
+	 * dropped altogether.
+	 */
+	IntrusivePtr<Stmt> OptimizeBody(IntrusivePtr<Stmt> body, const BroFunc* f);
+
+	static const Stats& GetStats()	{ return stats; }
+
+private:
+	// Optimizes a function's bodies, if not done yet.
+	void OptimizeFunc(BroFunc* f);
+
+	IntrusivePtr<Expr> ResolveGlobal(IntrusivePtr<Expr> e);
+	IntrusivePtr<Expr> ShortCircuit(IntrusivePtr<Expr> e);
+	IntrusivePtr<Expr> Fold(IntrusivePtr<Expr> e);
+	IntrusivePtr<Expr> Inline(IntrusivePtr<Expr> e);
+
+	// Returns a constant for the given expression's value, located
+	// like the expression.
+	IntrusivePtr<Expr> MakeConst(IntrusivePtr<Val> v, const Expr* orig);
+
+	// Globals that some script assigns to.
+	std::unordered_set<const ID*> assigned_globals;
+
+	// Functions optimized already, or being optimized.
+	std::unordered_set<const BroFunc*> done_funcs;
+
+	static Stats stats;
+};
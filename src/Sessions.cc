@@ -16,6 +16,7 @@
 #include "Timer.h"
 #include "NetVar.h"
 #include "Reporter.h"
+#include "BufferBudget.h"
 
 #include "analyzer/protocol/icmp/ICMP.h"
 #include "analyzer/protocol/udp/UDP.h"
@@ -31,7 +32,9 @@
 
 #include "analyzer/Manager.h"
 #include "iosource/IOSource.h"
+#include "iosource/Manager.h"
 #include "iosource/PktDumper.h"
+#include "iosource/PktSrc.h"
 
 // These represent NetBIOS services on ephemeral ports.  They're numbered
 // so that we can use a single int to hold either an actual TCP/UDP server
@@ -79,6 +82,10 @@ NetSessions::NetSessions()
 
 	packet_filter = nullptr;
 
+	if ( flow_shards && flow_shard_index >= flow_shards )
+		reporter->FatalError("flow_shard_index must be less than flow_shards (%" PRIu64 " >= %" PRIu64 ")",
+		                     flow_shard_index, flow_shards);
+
 	dump_this_packet = false;
 	num_packets_processed = 0;
 
@@ -94,6 +101,9 @@ NetSessions::NetSessions()
 		arp_analyzer = nullptr;
 
 	memset(&stats, 0, sizeof(SessionStats));
+
+	for ( auto& e : flow_cache )
+		e.conn = nullptr;
 	}
 
 NetSessions::~NetSessions()
@@ -104,12 +114,12 @@ NetSessions::~NetSessions()
 	delete discarder;
 	delete stp_manager;
 
-	for ( const auto& entry : tcp_conns )
-		Unref(entry.second);
-	for ( const auto& entry : udp_conns )
-		Unref(entry.second);
-	for ( const auto& entry : icmp_conns )
-		Unref(entry.second);
+	for ( auto c : tcp_conns.SortedByKey() )
+		Unref(c);
+	for ( auto c : udp_conns.SortedByKey() )
+		Unref(c);
+	for ( auto c : icmp_conns.SortedByKey() )
+		Unref(c);
 	for ( const auto& entry : fragments )
 		Unref(entry.second);
 	}
@@ -137,7 +147,9 @@ void NetSessions::NextPacket(double t, const Packet* pkt)
 
 	if ( pkt->hdr_size > pkt->cap_len )
 		{
-		Weird("truncated_link_frame", pkt);
+		if ( InDefaultShard() )
+			Weird("truncated_link_frame", pkt);
+
 		return;
 		}
 
@@ -147,7 +159,9 @@ void NetSessions::NextPacket(double t, const Packet* pkt)
 		{
 		if ( caplen < sizeof(struct ip) )
 			{
-			Weird("truncated_IP", pkt);
+			if ( InDefaultShard() )
+				Weird("truncated_IP", pkt);
+
 			return;
 			}
 
@@ -160,7 +174,9 @@ void NetSessions::NextPacket(double t, const Packet* pkt)
 		{
 		if ( caplen < sizeof(struct ip6_hdr) )
 			{
-			Weird("truncated_IP", pkt);
+			if ( InDefaultShard() )
+				Weird("truncated_IP", pkt);
+
 			return;
 			}
 
@@ -168,6 +184,10 @@ void NetSessions::NextPacket(double t, const Packet* pkt)
 		DoNextPacket(t, pkt, &ip_hdr, nullptr);
 		}
 
+	else if ( ! InDefaultShard() )
+		// There are no addresses to pick a shard by.
+		return;
+
 	else if ( pkt->l3_proto == L3_ARP )
 		{
 		if ( arp_analyzer )
@@ -180,6 +200,9 @@ void NetSessions::NextPacket(double t, const Packet* pkt)
 		return;
 		}
 
+	// Now that the packet's been dealt with, it's safe to make
+	// connections drop buffered data.
+	buffer_budget.Enforce();
 
 	if ( dump_this_packet && ! record_all_packets )
 		DumpPacket(pkt);
@@ -210,6 +233,27 @@ static unsigned int gre_header_len(uint16_t flags)
 	return len;
 	}
 
+bool NetSessions::InFlowShard(const IP_Hdr* ip_hdr) const
+	{
+	uint32_t src[4], dst[4];
+	ip_hdr->SrcAddr().CopyIPv6(src);
+	ip_hdr->DstAddr().CopyIPv6(dst);
+
+	// Combine the two addresses symmetrically so that both directions
+	// of a flow end up in the same shard.
+	uint64_t h = 0;
+
+	for ( int i = 0; i < 4; ++i )
+		{
+		uint64_t x = (uint64_t(src[i] + dst[i]) << 32) | (src[i] ^ dst[i]);
+		h = (h ^ x) * 0x9e3779b97f4a7c15ULL;
+		}
+
+	h ^= h >> 29;
+
+	return h % flow_shards == flow_shard_index;
+	}
+
 void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr,
 			       const EncapsulationStack* encapsulation)
 	{
@@ -251,6 +295,11 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 	if ( packet_filter && packet_filter->Match(ip_hdr, len, caplen) )
 		 return;
 
+	// Only the outermost header decides, so that tunneled traffic stays
+	// with its tunnel.
+	if ( flow_shards && ! encapsulation && ! InFlowShard(ip_hdr) )
+		return;
+
 	if ( ! pkt->l2_checksummed && ! ignore_checksums && ip4 &&
 	     ones_complement_checksum((void*) ip4, ip_hdr_len, 0) != 0xffff )
 		{
@@ -349,7 +398,7 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 	ConnID id;
 	id.src_addr = ip_hdr->SrcAddr();
 	id.dst_addr = ip_hdr->DstAddr();
-	ConnectionMap* d = nullptr;
+	ConnTable* d = nullptr;
 	BifEnum::Tunnel::Type tunnel_type = BifEnum::Tunnel::IP;
 	int gre_version = -1;
 	int gre_link_type = DLT_RAW;
@@ -642,20 +691,29 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 		return;
 	}
 
-	ConnIDKey key = BuildConnIDKey(id);
-	Connection* conn = nullptr;
+	ConnIDKey key;
+	hash_t hash = 0;
+
+	// Packets of the flow seen last usually hit the flow cache.
+	Connection* conn = LookupFlowCache(id, d);
+	bool cached = (conn != nullptr);
+
+	if ( cached )
+		key = conn->Key();
+	else
+		{
+		key = BuildConnIDKey(id);
+		hash = ConnTable::Hash(key);
+		conn = d->Lookup(key, hash);
+		}
 
 	// FIXME: The following is getting pretty complex. Need to split up
 	// into separate functions.
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
-
 	if ( ! conn )
 		{
 		conn = NewConn(key, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
 		if ( conn )
-			InsertConnection(d, key, conn);
+			InsertConnection(d, key, hash, conn);
 		}
 	else
 		{
@@ -665,9 +723,10 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 			conn->Event(connection_reused, nullptr);
 
 			Remove(conn);
+			cached = false;
 			conn = NewConn(key, t, &id, data, proto, ip_hdr->FlowLabel(), pkt, encapsulation);
 			if ( conn )
-				InsertConnection(d, key, conn);
+				InsertConnection(d, key, ConnTable::Hash(key), conn);
 			}
 		else
 			{
@@ -678,12 +737,26 @@ void NetSessions::DoNextPacket(double t, const Packet* pkt, const IP_Hdr* ip_hdr
 	if ( ! conn )
 		return;
 
+	if ( ! cached )
+		UpdateFlowCache(id, d, conn);
+
 	int record_packet = 1;	// whether to record the packet at all
 	int record_content = 1;	// whether to record its data
 
 	bool is_orig = (id.src_addr == conn->OrigAddr()) &&
 			(id.src_port == conn->OrigPort());
 
+	if ( conn->IsBypassed() )
+		{
+		conn->BypassedPacket(t, is_orig, ip_hdr->TotalLen());
+		++stats.bypassed_packets;
+
+		if ( f )
+			f->DeleteTimer();
+
+		return;
+		}
+
 	conn->CheckFlowLabel(is_orig, ip_hdr->FlowLabel());
 
 	Val* pkt_hdr_val = nullptr;
@@ -911,7 +984,7 @@ Connection* NetSessions::FindConnection(Val* v)
 		return nullptr;
 
 	RecordType* vr = vt->AsRecordType();
-	const val_list* vl = v->AsRecord();
+	RecordVal* rv = v->AsRecordVal();
 
 	int orig_h, orig_p;	// indices into record's value list
 	int resp_h, resp_p;
@@ -939,11 +1012,11 @@ Connection* NetSessions::FindConnection(Val* v)
 		// types, too.
 		}
 
-	const IPAddr& orig_addr = (*vl)[orig_h]->AsAddr();
-	const IPAddr& resp_addr = (*vl)[resp_h]->AsAddr();
+	const IPAddr& orig_addr = rv->Lookup(orig_h)->AsAddr();
+	const IPAddr& resp_addr = rv->Lookup(resp_h)->AsAddr();
 
-	PortVal* orig_portv = (*vl)[orig_p]->AsPortVal();
-	PortVal* resp_portv = (*vl)[resp_p]->AsPortVal();
+	PortVal* orig_portv = rv->Lookup(orig_p)->AsPortVal();
+	PortVal* resp_portv = rv->Lookup(resp_p)->AsPortVal();
 
 	ConnID id;
 
@@ -956,7 +1029,7 @@ Connection* NetSessions::FindConnection(Val* v)
 	id.is_one_way = false;	// ### incorrect for ICMP connections
 
 	ConnIDKey key = BuildConnIDKey(id);
-	ConnectionMap* d;
+	ConnTable* d;
 
 	if ( orig_portv->IsTCP() )
 		d = &tcp_conns;
@@ -972,12 +1045,7 @@ Connection* NetSessions::FindConnection(Val* v)
 		return nullptr;
 		}
 
-	Connection* conn = nullptr;
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
-
-	return conn;
+	return d->Lookup(key);
 	}
 
 void NetSessions::Remove(Connection* c)
@@ -1004,20 +1072,21 @@ void NetSessions::Remove(Connection* c)
 		// up, we know on a future call to Remove() that it's no
 		// longer in the dictionary.
 		c->ClearKey();
+		InvalidateFlowCache(c);
 
 		switch ( c->ConnTransport() ) {
 		case TRANSPORT_TCP:
-			if ( tcp_conns.erase(key) == 0 )
+			if ( ! tcp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
 		case TRANSPORT_UDP:
-			if ( udp_conns.erase(key) == 0 )
+			if ( ! udp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
 		case TRANSPORT_ICMP:
-			if ( icmp_conns.erase(key) == 0 )
+			if ( ! icmp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
@@ -1041,6 +1110,34 @@ void NetSessions::Remove(FragReassembler* f)
 	Unref(f);
 	}
 
+bool NetSessions::Bypass(Connection* c)
+	{
+	if ( ! c->IsKeyValid() )
+		return false;
+
+	if ( c->IsBypassed() )
+		return true;
+
+	c->SetBypassed();
+	++stats.cumulative_bypassed_conns;
+
+	iosource::PktSrc* ps = iosource_mgr->GetPktSrc();
+
+	if ( ps )
+		{
+		ConnID id;
+		id.src_addr = c->OrigAddr();
+		id.dst_addr = c->RespAddr();
+		id.src_port = c->OrigPort();
+		id.dst_port = c->RespPort();
+		id.is_one_way = false;
+
+		ps->BypassFlow(id, c->ConnTransport());
+		}
+
+	return true;
+	}
+
 void NetSessions::Insert(Connection* c)
 	{
 	assert(c->IsKeyValid());
@@ -1048,25 +1145,19 @@ void NetSessions::Insert(Connection* c)
 	Connection* old = nullptr;
 
 	switch ( c->ConnTransport() ) {
-	// Remove first. Otherwise the map would still reference the old key for
-	// already existing connections.
-
 	case TRANSPORT_TCP:
 		old = LookupConn(tcp_conns, c->Key());
-		tcp_conns.erase(c->Key());
-		InsertConnection(&tcp_conns, c->Key(), c);
+		InsertConnection(&tcp_conns, c->Key(), ConnTable::Hash(c->Key()), c);
 		break;
 
 	case TRANSPORT_UDP:
 		old = LookupConn(udp_conns, c->Key());
-		udp_conns.erase(c->Key());
-		InsertConnection(&udp_conns, c->Key(), c);
+		InsertConnection(&udp_conns, c->Key(), ConnTable::Hash(c->Key()), c);
 		break;
 
 	case TRANSPORT_ICMP:
 		old = LookupConn(icmp_conns, c->Key());
-		icmp_conns.erase(c->Key());
-		InsertConnection(&icmp_conns, c->Key(), c);
+		InsertConnection(&icmp_conns, c->Key(), ConnTable::Hash(c->Key()), c);
 		break;
 
 	default:
@@ -1081,29 +1172,27 @@ void NetSessions::Insert(Connection* c)
 		// to the script layer).
 		old->CancelTimers();
 		old->ClearKey();
+		InvalidateFlowCache(old);
 		Unref(old);
 		}
 	}
 
 void NetSessions::Drain()
 	{
-	for ( const auto& entry : tcp_conns )
+	for ( auto tc : tcp_conns.SortedByKey() )
 		{
-		Connection* tc = entry.second;
 		tc->Done();
 		tc->RemovalEvent();
 		}
 
-	for ( const auto& entry : udp_conns )
+	for ( auto uc : udp_conns.SortedByKey() )
 		{
-		Connection* uc = entry.second;
 		uc->Done();
 		uc->RemovalEvent();
 		}
 
-	for ( const auto& entry : icmp_conns )
+	for ( auto ic : icmp_conns.SortedByKey() )
 		{
-		Connection* ic = entry.second;
 		ic->Done();
 		ic->RemovalEvent();
 		}
@@ -1111,14 +1200,18 @@ void NetSessions::Drain()
 
 void NetSessions::GetStats(SessionStats& s) const
 	{
-	s.num_TCP_conns = tcp_conns.size();
+	s.num_TCP_conns = tcp_conns.Size();
 	s.cumulative_TCP_conns = stats.cumulative_TCP_conns;
-	s.num_UDP_conns = udp_conns.size();
+	s.num_UDP_conns = udp_conns.Size();
 	s.cumulative_UDP_conns = stats.cumulative_UDP_conns;
-	s.num_ICMP_conns = icmp_conns.size();
+	s.num_ICMP_conns = icmp_conns.Size();
 	s.cumulative_ICMP_conns = stats.cumulative_ICMP_conns;
 	s.num_fragments = fragments.size();
 	s.num_packets = num_packets_processed;
+	s.flow_cache_hits = stats.flow_cache_hits;
+	s.flow_cache_misses = stats.flow_cache_misses;
+	s.cumulative_bypassed_conns = stats.cumulative_bypassed_conns;
+	s.bypassed_packets = stats.bypassed_packets;
 
 	s.max_TCP_conns = stats.max_TCP_conns;
 	s.max_UDP_conns = stats.max_UDP_conns;
@@ -1186,15 +1279,79 @@ Connection* NetSessions::NewConn(const ConnIDKey& k, double t, const ConnID* id,
 	return conn;
 	}
 
-Connection* NetSessions::LookupConn(const ConnectionMap& conns, const ConnIDKey& key)
+Connection* NetSessions::LookupConn(const ConnTable& conns, const ConnIDKey& key)
+	{
+	return conns.Lookup(key);
+	}
+
+size_t NetSessions::FlowCacheSlot(const IPAddr& src_addr, const IPAddr& dst_addr,
+				  uint32_t src_port, uint32_t dst_port)
+	{
+	uint32_t src[4], dst[4];
+	src_addr.CopyIPv6(src);
+	dst_addr.CopyIPv6(dst);
+
+	uint64_t h = (uint64_t(src_port) << 32) | dst_port;
+
+	for ( int i = 0; i < 4; ++i )
+		{
+		uint64_t x = (uint64_t(src[i]) << 32) | dst[i];
+		h = (h ^ x) * 0x9e3779b97f4a7c15ULL;
+		}
+
+	return (h ^ (h >> 32)) % FLOW_CACHE_SIZE;
+	}
+
+Connection* NetSessions::LookupFlowCache(const ConnID& id, const ConnTable* table)
 	{
-	auto it = conns.find(key);
-	if ( it != conns.end() )
-		return it->second;
+	const FlowCacheEntry& e =
+		flow_cache[FlowCacheSlot(id.src_addr, id.dst_addr, id.src_port, id.dst_port)];
 
+	if ( e.conn && e.table == table &&
+	     e.src_port == id.src_port && e.dst_port == id.dst_port &&
+	     e.src_addr == id.src_addr && e.dst_addr == id.dst_addr )
+		{
+		++stats.flow_cache_hits;
+		return e.conn;
+		}
+
+	++stats.flow_cache_misses;
 	return nullptr;
 	}
 
+void NetSessions::UpdateFlowCache(const ConnID& id, const ConnTable* table,
+				  Connection* conn)
+	{
+	FlowCacheEntry& e =
+		flow_cache[FlowCacheSlot(id.src_addr, id.dst_addr, id.src_port, id.dst_port)];
+
+	e.src_addr = id.src_addr;
+	e.dst_addr = id.dst_addr;
+	e.src_port = id.src_port;
+	e.dst_port = id.dst_port;
+	e.table = table;
+	e.conn = conn;
+	}
+
+void NetSessions::InvalidateFlowCache(const Connection* conn)
+	{
+	// Every packet of the connection has its originator's or its
+	// responder's address and port as source, so its entries can only
+	// be in one of these two slots.
+	size_t slots[2] = {
+		FlowCacheSlot(conn->OrigAddr(), conn->RespAddr(),
+			      conn->OrigPort(), conn->RespPort()),
+		FlowCacheSlot(conn->RespAddr(), conn->OrigAddr(),
+			      conn->RespPort(), conn->OrigPort()),
+	};
+
+	for ( auto slot : slots )
+		{
+		if ( flow_cache[slot].conn == conn )
+			flow_cache[slot].conn = nullptr;
+		}
+	}
+
 bool NetSessions::IsLikelyServerPort(uint32_t port, TransportProto proto) const
 	{
 	// We keep a cached in-core version of the table to speed up the lookup.
@@ -1315,14 +1472,18 @@ unsigned int NetSessions::ConnectionMemoryUsage()
 		// Connections have been flushed already.
 		return 0;
 
-	for ( const auto& entry : tcp_conns )
-		mem += entry.second->MemoryAllocation();
+	for ( auto c : tcp_conns )
+		mem += c->MemoryAllocation();
+
+	for ( auto c : udp_conns )
+		mem += c->MemoryAllocation();
 
-	for ( const auto& entry : udp_conns )
-		mem += entry.second->MemoryAllocation();
+	for ( auto c : icmp_conns )
+		mem += c->MemoryAllocation();
 
-	for ( const auto& entry : icmp_conns )
-		mem += entry.second->MemoryAllocation();
+	mem += tcp_conns.MemoryAllocation()
+		+ udp_conns.MemoryAllocation()
+		+ icmp_conns.MemoryAllocation();
 
 	return mem;
 	}
@@ -1335,14 +1496,14 @@ unsigned int NetSessions::ConnectionMemoryUsageConnVals()
 		// Connections have been flushed already.
 		return 0;
 
-	for ( const auto& entry : tcp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+	for ( auto c : tcp_conns )
+		mem += c->MemoryAllocationConnVal();
 
-	for ( const auto& entry : udp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+	for ( auto c : udp_conns )
+		mem += c->MemoryAllocationConnVal();
 
-	for ( const auto& entry : icmp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+	for ( auto c : icmp_conns )
+		mem += c->MemoryAllocationConnVal();
 
 	return mem;
 	}
@@ -1355,34 +1516,32 @@ unsigned int NetSessions::MemoryAllocation()
 
 	return ConnectionMemoryUsage()
 		+ padded_sizeof(*this)
-		+ (tcp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
-		+ (udp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
-		+ (icmp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
 		+ (fragments.size() * (sizeof(FragmentMap::key_type) + sizeof(FragmentMap::value_type)))
 		// FIXME: MemoryAllocation() not implemented for rest.
 		;
 	}
 
-void NetSessions::InsertConnection(ConnectionMap* m, const ConnIDKey& key, Connection* conn)
+void NetSessions::InsertConnection(ConnTable* m, const ConnIDKey& key, hash_t hash,
+				   Connection* conn)
 	{
-	(*m)[key] = conn;
+	m->Insert(key, hash, conn);
 
 	switch ( conn->ConnTransport() )
 		{
 		case TRANSPORT_TCP:
 			stats.cumulative_TCP_conns++;
-			if ( m->size() > stats.max_TCP_conns )
-				stats.max_TCP_conns = m->size();
+			if ( m->Size() > stats.max_TCP_conns )
+				stats.max_TCP_conns = m->Size();
 			break;
 		case TRANSPORT_UDP:
 			stats.cumulative_UDP_conns++;
-			if ( m->size() > stats.max_UDP_conns )
-				stats.max_UDP_conns = m->size();
+			if ( m->Size() > stats.max_UDP_conns )
+				stats.max_UDP_conns = m->Size();
 			break;
 		case TRANSPORT_ICMP:
 			stats.cumulative_ICMP_conns++;
-			if ( m->size() > stats.max_ICMP_conns )
-				stats.max_ICMP_conns = m->size();
+			if ( m->Size() > stats.max_ICMP_conns )
+				stats.max_ICMP_conns = m->Size();
 			break;
 		default: break;
 		}
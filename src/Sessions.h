@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Frag.h"
+#include "ConnTable.h"
 #include "PacketFilter.h"
 #include "NetVar.h"
 #include "analyzer/protocol/tcp/Stats.h"
@@ -41,6 +42,12 @@ struct SessionStats {
 	size_t num_fragments;
 	size_t max_fragments;
 	uint64_t num_packets;
+
+	uint64_t flow_cache_hits;
+	uint64_t flow_cache_misses;
+
+	uint64_t cumulative_bypassed_conns;
+	uint64_t bypassed_packets;
 };
 
 class NetSessions {
@@ -66,6 +73,14 @@ public:
 	void Remove(Connection* c);
 	void Remove(FragReassembler* f);
 
+	// Makes the connection's remaining packets bypass analysis: they
+	// only update its timestamps and the packet and byte counts in its
+	// endpoint records, and don't get recorded.  The connection still
+	// expires through its inactivity timeout.  Also asks the packet
+	// source to drop the flow's packets, if it can.  Can't be undone.
+	// Returns false if the connection isn't in the session tables.
+	bool Bypass(Connection* c);
+
 	void Insert(Connection* c);
 
 	// Generating connection_pending events for all connections
@@ -90,7 +105,7 @@ public:
 
 	unsigned int CurrentConnections()
 		{
-		return tcp_conns.size() + udp_conns.size() + icmp_conns.size();
+		return tcp_conns.Size() + udp_conns.Size() + icmp_conns.Size();
 		}
 
 	void DoNextPacket(double t, const Packet *pkt, const IP_Hdr* ip_hdr,
@@ -169,14 +184,13 @@ protected:
 	friend class ConnCompressor;
 	friend class IPTunnelTimer;
 
-	using ConnectionMap = std::map<ConnIDKey, Connection*>;
 	using FragmentMap = std::map<FragReassemblerKey, FragReassembler*>;
 
 	Connection* NewConn(const ConnIDKey& k, double t, const ConnID* id,
 			const u_char* data, int proto, uint32_t flow_label,
 			const Packet* pkt, const EncapsulationStack* encapsulation);
 
-	Connection* LookupConn(const ConnectionMap& conns, const ConnIDKey& key);
+	Connection* LookupConn(const ConnTable& conns, const ConnIDKey& key);
 
 	// Returns true if the port corresonds to an application
 	// for which there's a Bro analyzer (even if it might not
@@ -207,16 +221,57 @@ protected:
 	bool CheckHeaderTrunc(int proto, uint32_t len, uint32_t caplen,
 			      const Packet *pkt, const EncapsulationStack* encap);
 
+	// Returns true if the packet falls into the shard of the traffic
+	// we're analyzing, as selected by flow_shards/flow_shard_index.
+	bool InFlowShard(const IP_Hdr* ip_hdr) const;
+
+	// Returns true if we're analyzing the packets that can't be hashed
+	// into a shard, such as non-IP ones.  They all go to the first one.
+	bool InDefaultShard() const
+		{ return flow_shards == 0 || flow_shard_index == 0; }
+
 	// Inserts a new connection into the sessions map. If a connection with
 	// the same key already exists in the map, it will be overwritten by
 	// the new one.  Connection count stats get updated either way (so most
 	// cases should likely check that the key is not already in the map to
 	// avoid unnecessary incrementing of connecting counts).
-	void InsertConnection(ConnectionMap* m, const ConnIDKey& key, Connection* conn);
-
-	ConnectionMap tcp_conns;
-	ConnectionMap udp_conns;
-	ConnectionMap icmp_conns;
+	void InsertConnection(ConnTable* m, const ConnIDKey& key, hash_t hash,
+			      Connection* conn);
+
+	// The flow cache remembers, for recent packets, the connection they
+	// belonged to, so that the next packet with the same addresses and
+	// ports finds it without building and hashing the key. It's direct
+	// mapped, indexed by a cheap hash of the packet's tuple, with each
+	// direction of a connection taking an entry of its own.
+	struct FlowCacheEntry {
+		IPAddr src_addr;
+		IPAddr dst_addr;
+		uint32_t src_port;
+		uint32_t dst_port;
+		const ConnTable* table;
+		Connection* conn;	// Null if unused.
+	};
+
+	static constexpr size_t FLOW_CACHE_SIZE = 1024;
+
+	static size_t FlowCacheSlot(const IPAddr& src_addr, const IPAddr& dst_addr,
+				    uint32_t src_port, uint32_t dst_port);
+
+	// Returns the cached connection for the packet, or null if none.
+	Connection* LookupFlowCache(const ConnID& id, const ConnTable* table);
+
+	void UpdateFlowCache(const ConnID& id, const ConnTable* table,
+			     Connection* conn);
+
+	// Drops any entries for the connection. Must be called before a
+	// connection leaves its table.
+	void InvalidateFlowCache(const Connection* conn);
+
+	FlowCacheEntry flow_cache[FLOW_CACHE_SIZE];
+
+	ConnTable tcp_conns;
+	ConnTable udp_conns;
+	ConnTable icmp_conns;
 	FragmentMap fragments;
 
 	SessionStats stats;
@@ -0,0 +1,183 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "Slab.h"
+#include "util.h"
+
+#include "3rdparty/doctest.h"
+
+SlabAllocator slab_allocator;
+
+SlabAllocator::Chunk* SlabAllocator::NewChunk(size_t c)
+	{
+	void* mem;
+
+	if ( posix_memalign(&mem, CHUNK_SIZE, CHUNK_SIZE) != 0 )
+		out_of_memory("slab chunk");
+
+	++num_chunks;
+	++num_empty[c];
+
+	Chunk* chunk = static_cast<Chunk*>(mem);
+	chunk->used = 0;
+	chunk->size_class = c;
+	chunk->free = nullptr;
+
+	size_t size = ClassSize(c);
+	char* objects = static_cast<char*>(mem) + CHUNK_HEADER_SIZE;
+
+	// Link them up back to front, so that the list hands them out in
+	// address order.
+	for ( size_t n = (CHUNK_SIZE - CHUNK_HEADER_SIZE) / size; n > 0; --n )
+		{
+		FreeItem* item = reinterpret_cast<FreeItem*>(objects + (n - 1) * size);
+		item->next = chunk->free;
+		chunk->free = item;
+		}
+
+	Link(chunk);
+	return chunk;
+	}
+
+void SlabAllocator::ChunkEmpty(Chunk* chunk)
+	{
+	size_t c = chunk->size_class;
+
+	if ( num_empty[c] == 0 )
+		{
+		// Keep it as the spare.
+		++num_empty[c];
+		return;
+		}
+
+	Unlink(chunk);
+	free(chunk);
+	--num_chunks;
+	++num_released;
+	}
+
+TEST_CASE("slab allocator")
+	{
+	SlabAllocator::Stats before;
+	slab_allocator.GetStats(&before);
+
+	void* a = slab_allocator.Allocate(40);
+	void* b = slab_allocator.Allocate(48);
+	CHECK(a != b);
+	CHECK(reinterpret_cast<uintptr_t>(a) % SlabAllocator::GRANULARITY == 0);
+
+	SlabAllocator::Stats s;
+	slab_allocator.GetStats(&s);
+	CHECK(s.objects == before.objects + 2);
+
+	// Objects of the same size class get recycled.
+	slab_allocator.Free(a, 40);
+	void* c = slab_allocator.Allocate(33);
+	CHECK(c == a);
+
+	slab_allocator.Free(b, 48);
+	slab_allocator.Free(c, 33);
+
+	slab_allocator.GetStats(&s);
+	CHECK(s.objects == before.objects);
+
+	// Large ones bypass the slabs.
+	void* big = slab_allocator.Allocate(SlabAllocator::MAX_SIZE + 1);
+	slab_allocator.GetStats(&s);
+	CHECK(s.objects == before.objects);
+	slab_allocator.Free(big, SlabAllocator::MAX_SIZE + 1);
+
+	// Buffers beyond the small classes get coarser ones.
+	CHECK(SlabAllocator::Capacity(1460) == 1536);
+	void* buf = slab_allocator.Allocate(1460);
+	slab_allocator.GetStats(&s);
+	CHECK(s.bytes == before.bytes + 1536);
+	slab_allocator.Free(buf, 1500);
+
+	slab_allocator.GetStats(&s);
+	CHECK(s.bytes == before.bytes);
+	}
+
+TEST_CASE("slab chunk release")
+	{
+	// A size class nothing else uses.
+	const size_t size = SlabAllocator::MAX_SIZE - 100;
+	const int num = 100;
+	void* objs[num];
+
+	SlabAllocator::Stats before;
+	slab_allocator.GetStats(&before);
+
+	for ( int i = 0; i < num; ++i )
+		objs[i] = slab_allocator.Allocate(size);
+
+	SlabAllocator::Stats s;
+	slab_allocator.GetStats(&s);
+	uint64_t peak = s.chunks;
+	CHECK(peak >= before.chunks + num / (SlabAllocator::CHUNK_SIZE / SlabAllocator::MAX_SIZE));
+
+	// Objects are carved out of chunks without overlapping the chunk
+	// header.
+	for ( int i = 0; i < num; ++i )
+		CHECK(reinterpret_cast<uintptr_t>(objs[i]) % SlabAllocator::CHUNK_SIZE != 0);
+
+	// Freeing every other object doesn't empty any chunk.
+	for ( int i = 0; i < num; i += 2 )
+		slab_allocator.Free(objs[i], size);
+
+	slab_allocator.GetStats(&s);
+	CHECK(s.chunks == peak);
+	CHECK(s.released == before.released);
+
+	// Their slots get reused before any new chunk is taken.
+	for ( int i = 0; i < num; i += 2 )
+		objs[i] = slab_allocator.Allocate(size);
+
+	slab_allocator.GetStats(&s);
+	CHECK(s.chunks == peak);
+
+	for ( int i = 0; i < num; ++i )
+		slab_allocator.Free(objs[i], size);
+
+	// All but one spare chunk went back.
+	slab_allocator.GetStats(&s);
+	CHECK(s.chunks == before.chunks + 1);
+	CHECK(s.released == before.released + peak - before.chunks - 1);
+	CHECK(s.objects == before.objects);
+
+	// The spare gets used again.
+	void* p = slab_allocator.Allocate(size);
+	slab_allocator.GetStats(&s);
+	CHECK(s.chunks == before.chunks + 1);
+	slab_allocator.Free(p, size);
+	}
+
+TEST_CASE("slab allocated classes")
+	{
+	struct Base : public SlabAllocated {
+		virtual ~Base()	{ }
+		int x = 1;
+	};
+
+	struct Derived : public Base {
+		char buf[200];
+	};
+
+	SlabAllocator::Stats before;
+	slab_allocator.GetStats(&before);
+
+	Base* b = new Derived;
+	SlabAllocator::Stats s;
+	slab_allocator.GetStats(&s);
+	CHECK(s.objects == before.objects + 1);
+
+	// Deleting through the base must hand back the derived size.
+	delete b;
+	void* p = slab_allocator.Allocate(sizeof(Derived));
+	CHECK(p == static_cast<void*>(b));
+	slab_allocator.Free(p, sizeof(Derived));
+
+	slab_allocator.GetStats(&s);
+	CHECK(s.objects == before.objects);
+	}
@@ -0,0 +1,252 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A size-class slab allocator for the main thread's many small,
+ * short-lived objects (connections, analyzers, reassemblers, ...) and
+ * for buffers up to a few KB, such as reassembly data.
+ *
+ * Memory is taken from the system in aligned chunks, each carved into
+ * objects of a single size class. Every chunk keeps a free list of its
+ * own, and each size class a list of the chunks that have objects left.
+ * Allocating and freeing are thus a couple of pointer operations, and
+ * setting up and tearing down a connection doesn't need to go through
+ * malloc() for every single object. Once all of a chunk's objects are
+ * free again, the chunk goes back to the system, except for one per size
+ * class kept around so that a class hovering at a chunk boundary doesn't
+ * keep getting and returning one. Memory thus follows the number of
+ * objects alive rather than staying at its peak after a burst.
+ *
+ * Not thread-safe: only the main thread may allocate from it.
+ */
+class SlabAllocator {
+public:
+	// Size classes go in steps of GRANULARITY up to SMALL_SIZE, and
+	// then in steps of LARGE_GRANULARITY up to MAX_SIZE.
+	static constexpr size_t GRANULARITY = 16;
+	static constexpr size_t SMALL_SIZE = 1024;
+	static constexpr size_t LARGE_GRANULARITY = 256;
+	static constexpr size_t MAX_SIZE = 16 * 1024;
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	static constexpr size_t NUM_SMALL_CLASSES = SMALL_SIZE / GRANULARITY;
+	static constexpr size_t NUM_CLASSES = NUM_SMALL_CLASSES +
+		(MAX_SIZE - SMALL_SIZE) / LARGE_GRANULARITY;
+
+	/**
+	 * Allocates memory for an object. Requests larger than MAX_SIZE
+	 * go to the global operator new.
+	 */
+	void* Allocate(size_t size)
+		{
+		if ( size > MAX_SIZE || size == 0 )
+			return ::operator new(size);
+
+		size_t c = SizeClass(size);
+		Chunk* chunk = avail[c];
+
+		if ( ! chunk )
+			chunk = NewChunk(c);
+
+		FreeItem* item = chunk->free;
+		chunk->free = item->next;
+
+		if ( chunk->used++ == 0 )
+			--num_empty[c];
+
+		if ( ! chunk->free )
+			// Full now.
+			Unlink(chunk);
+
+		++num_objects;
+		num_bytes += ClassSize(c);
+		return item;
+		}
+
+	/**
+	 * Returns memory obtained from Allocate(). The size must be at least
+	 * the one passed to Allocate(), and at most its Capacity().
+	 */
+	void Free(void* p, size_t size)
+		{
+		if ( ! p )
+			return;
+
+		if ( size > MAX_SIZE || size == 0 )
+			{
+			::operator delete(p);
+			return;
+			}
+
+		size_t c = SizeClass(size);
+		Chunk* chunk = ChunkOf(p);
+
+		if ( ! chunk->free )
+			// Was full, has room again.
+			Link(chunk);
+
+		FreeItem* item = static_cast<FreeItem*>(p);
+		item->next = chunk->free;
+		chunk->free = item;
+		--num_objects;
+		num_bytes -= ClassSize(c);
+
+		if ( --chunk->used == 0 )
+			ChunkEmpty(chunk);
+		}
+
+	/**
+	 * Returns how many bytes an allocation of the given size actually
+	 * provides.
+	 */
+	static size_t Capacity(size_t size)
+		{
+		if ( size > MAX_SIZE || size == 0 )
+			return size;
+
+		return ClassSize(SizeClass(size));
+		}
+
+	struct Stats {
+		uint64_t chunks;	// chunks currently held
+		uint64_t released;	// chunks given back to the system
+		uint64_t objects;	// objects currently allocated
+		uint64_t bytes;	// bytes currently handed out from the chunks
+	};
+
+	void GetStats(Stats* s) const
+		{
+		s->chunks = num_chunks;
+		s->released = num_released;
+		s->objects = num_objects;
+		s->bytes = num_bytes;
+		}
+
+private:
+	struct FreeItem {
+		FreeItem* next;
+	};
+
+	// Sits at the start of each chunk, which is aligned to CHUNK_SIZE
+	// so that an object's chunk follows from its address.
+	struct Chunk {
+		Chunk* prev;	// in its class's list of chunks with room
+		Chunk* next;
+		FreeItem* free;
+		uint32_t used;	// objects handed out
+		uint32_t size_class;
+	};
+
+	static constexpr size_t CHUNK_HEADER_SIZE =
+		(sizeof(Chunk) + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+
+	static Chunk* ChunkOf(void* p)
+		{
+		return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p) &
+		                                ~uintptr_t(CHUNK_SIZE - 1));
+		}
+
+	// Adds a chunk to the front of its class's list of chunks with room.
+	void Link(Chunk* chunk)
+		{
+		Chunk*& head = avail[chunk->size_class];
+		chunk->prev = nullptr;
+		chunk->next = head;
+
+		if ( head )
+			head->prev = chunk;
+
+		head = chunk;
+		}
+
+	void Unlink(Chunk* chunk)
+		{
+		if ( chunk->prev )
+			chunk->prev->next = chunk->next;
+		else
+			avail[chunk->size_class] = chunk->next;
+
+		if ( chunk->next )
+			chunk->next->prev = chunk->prev;
+		}
+
+	static size_t SizeClass(size_t size)
+		{
+		if ( size <= SMALL_SIZE )
+			return (size - 1) / GRANULARITY;
+
+		return NUM_SMALL_CLASSES + (size - SMALL_SIZE - 1) / LARGE_GRANULARITY;
+		}
+
+	static size_t ClassSize(size_t c)
+		{
+		if ( c < NUM_SMALL_CLASSES )
+			return (c + 1) * GRANULARITY;
+
+		return SMALL_SIZE + (c - NUM_SMALL_CLASSES + 1) * LARGE_GRANULARITY;
+		}
+
+	// Gets a new chunk for objects of the given class from the system
+	// and adds it to the class's list.
+	Chunk* NewChunk(size_t c);
+
+	// Called once all of a chunk's objects are free; releases it unless
+	// it's the class's spare one.
+	void ChunkEmpty(Chunk* chunk);
+
+	// Zero-initialized as a global, so that it's usable during static
+	// initialization already.
+	Chunk* avail[NUM_CLASSES];
+	uint32_t num_empty[NUM_CLASSES];	// chunks in avail with all free
+	uint64_t num_chunks;
+	uint64_t num_released;
+	uint64_t num_objects;
+	uint64_t num_bytes;
+};
+
+extern SlabAllocator slab_allocator;
+
+/**
+ * An STL allocator drawing from the slab allocator, e.g. for the nodes
+ * of node-based containers.
+ */
+template<typename T>
+class SlabSTLAllocator {
+public:
+	using value_type = T;
+
+	SlabSTLAllocator() noexcept = default;
+
+	template<typename U>
+	SlabSTLAllocator(const SlabSTLAllocator<U>&) noexcept	{ }
+
+	T* allocate(size_t n)
+		{ return static_cast<T*>(slab_allocator.Allocate(n * sizeof(T))); }
+
+	void deallocate(T* p, size_t n)
+		{ slab_allocator.Free(p, n * sizeof(T)); }
+
+	template<typename U>
+	bool operator==(const SlabSTLAllocator<U>&) const	{ return true; }
+
+	template<typename U>
+	bool operator!=(const SlabSTLAllocator<U>&) const	{ return false; }
+};
+
+/**
+ * Classes derive from this to allocate their instances from the slab
+ * allocator. Derived classes inherit it, with the size of the most
+ * derived class being passed to the allocator on both new and delete.
+ */
+class SlabAllocated {
+public:
+	static void* operator new(size_t size)
+		{ return slab_allocator.Allocate(size); }
+
+	static void operator delete(void* p, size_t size)
+		{ slab_allocator.Free(p, size); }
+};
@@ -10,6 +10,10 @@
 #include "Scope.h"
 #include "DNS_Mgr.h"
 #include "Trigger.h"
+#include "Slab.h"
+#include "BufferBudget.h"
+#include "ScriptOpt.h"
+#include "analyzer/protocol/tcp/TCP_Reassembler.h"
 #include "threading/Manager.h"
 #include "broker/Manager.h"
 #include "input.h"
@@ -163,9 +167,29 @@ void ProfileLogger::Log()
 	file->Write(fmt("%.06f Connections expired due to inactivity: %" PRIu64 "\n",
 		network_time, killed_by_inactivity));
 
+	file->Write(fmt("%.06f FlowCache: hits=%" PRIu64 " misses=%" PRIu64 "\n",
+		network_time, s.flow_cache_hits, s.flow_cache_misses));
+
+	file->Write(fmt("%.06f Bypassed: conns=%" PRIu64 " pkts=%" PRIu64 "\n",
+		network_time, s.cumulative_bypassed_conns, s.bypassed_packets));
+
 	file->Write(fmt("%.06f Total reassembler data: %" PRIu64 "K\n", network_time,
 		Reassembler::TotalMemoryAllocation() / 1024));
 
+	file->Write(fmt("%.06f TCP reassembly: zero-copy=%" PRIu64 "K copied=%" PRIu64 "K\n",
+		network_time, analyzer::tcp::TCP_Reassembler::ZeroCopyBytes() / 1024,
+		analyzer::tcp::TCP_Reassembler::CopiedBytes() / 1024));
+
+	BufferBudget::Stats bs;
+	buffer_budget.GetStats(&bs);
+
+	file->Write(fmt("%.06f Buffers: total=%" PRIu64 "K reassembly=%" PRIu64 "K dpd=%" PRIu64 "K lines=%" PRIu64 "K conns=%" PRIu64 " evictions=%" PRIu64 " evicted=%" PRIu64 "K\n",
+		network_time, bs.bytes / 1024,
+		bs.bytes_by_type[BUFFER_REASSEMBLY] / 1024,
+		bs.bytes_by_type[BUFFER_DPD] / 1024,
+		bs.bytes_by_type[BUFFER_LINES] / 1024,
+		bs.conns, bs.evictions, bs.evicted_bytes / 1024));
+
 	// Signature engine.
 	if ( expensive && rule_matcher )
 		{
@@ -182,6 +206,17 @@ void ProfileLogger::Log()
 		timer_mgr->Size(), timer_mgr->PeakSize(),
 		network_time - timer_mgr->LastTimestamp()));
 
+	const TableVal::ExpireStats& estats = TableVal::GetExpireStats();
+	file->Write(fmt("%.06f TableExpire: scanned=%" PRIu64 " expired=%" PRIu64 "\n",
+		network_time, estats.scanned, estats.expired));
+
+	SlabAllocator::Stats sstats;
+	slab_allocator.GetStats(&sstats);
+	file->Write(fmt("%.06f Slab: chunks=%" PRIu64 " (%" PRIu64 "K) released=%" PRIu64 " objects=%" PRIu64 " used=%" PRIu64 "K\n",
+		network_time, sstats.chunks,
+		sstats.chunks * SlabAllocator::CHUNK_SIZE / 1024, sstats.released,
+		sstats.objects, sstats.bytes / 1024));
+
 	DNS_Mgr::Stats dstats;
 	dns_mgr->GetStats(&dstats);
 
@@ -195,6 +230,14 @@ void ProfileLogger::Log()
 
 	file->Write(fmt("%.06f Triggers: total=%lu pending=%lu\n", network_time, tstats.total, tstats.pending));
 
+	if ( optimize_scripts )
+		{
+		const ScriptOptimizer::Stats& ostats = ScriptOptimizer::GetStats();
+		file->Write(fmt("%.06f ScriptOpt: globals=%" PRIu64 " folded=%" PRIu64 " inlined=%" PRIu64 " branches=%" PRIu64 " bodies=%" PRIu64 "\n",
+			network_time, ostats.globals, ostats.folded, ostats.inlined,
+			ostats.branches, ostats.bodies));
+		}
+
 	unsigned int* current_timers = TimerMgr::CurrentTimers();
 	for ( int i = 0; i < NUM_TIMER_TYPES; ++i )
 		{
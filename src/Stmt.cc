@@ -15,6 +15,7 @@
 #include "Desc.h"
 #include "Debug.h"
 #include "Traverse.h"
+#include "ScriptOpt.h"
 #include "Trigger.h"
 #include "IntrusivePtr.h"
 #include "logging/Manager.h"
@@ -182,6 +183,11 @@ TraversalCode ExprListStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void ExprListStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	l->OptimizeChildren(opt);
+	}
+
 static BroFile* print_stdout = nullptr;
 
 static IntrusivePtr<EnumVal> lookup_enum_val(const char* module_name, const char* name)
@@ -361,6 +367,11 @@ TraversalCode ExprStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void ExprStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	e = opt->Optimize(std::move(e));
+	}
+
 IfStmt::IfStmt(IntrusivePtr<Expr> test,
                IntrusivePtr<Stmt> arg_s1, IntrusivePtr<Stmt> arg_s2)
 	: ExprStmt(STMT_IF, std::move(test)),
@@ -444,6 +455,13 @@ TraversalCode IfStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void IfStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	ExprStmt::OptimizeChildren(opt);
+	s1 = opt->Optimize(std::move(s1));
+	s2 = opt->Optimize(std::move(s2));
+	}
+
 static BroStmtTag get_last_stmt_tag(const Stmt* stmt)
 	{
 	if ( ! stmt )
@@ -572,6 +590,12 @@ TraversalCode Case::Traverse(TraversalCallback* cb) const
 	return TC_CONTINUE;
 	}
 
+void Case::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	// The labels stay, as the switch has hashed them already.
+	s = opt->Optimize(std::move(s));
+	}
+
 static void int_del_func(void* v)
 	{
 	delete (int*) v;
@@ -883,6 +907,14 @@ TraversalCode SwitchStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void SwitchStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	ExprStmt::OptimizeChildren(opt);
+
+	for ( const auto& c : *cases )
+		c->OptimizeChildren(opt);
+	}
+
 AddStmt::AddStmt(IntrusivePtr<Expr> arg_e) : ExprStmt(STMT_ADD, std::move(arg_e))
 	{
 	if ( ! e->CanAdd() )
@@ -982,6 +1014,12 @@ TraversalCode EventStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void EventStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	// e is the event expression, too.
+	event_expr->OptimizeChildren(opt);
+	}
+
 WhileStmt::WhileStmt(IntrusivePtr<Expr> arg_loop_condition,
                      IntrusivePtr<Stmt> arg_body)
 	: loop_condition(std::move(arg_loop_condition)), body(std::move(arg_body))
@@ -1032,6 +1070,12 @@ TraversalCode WhileStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void WhileStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	loop_condition = opt->Optimize(std::move(loop_condition));
+	body = opt->Optimize(std::move(body));
+	}
+
 IntrusivePtr<Val> WhileStmt::Exec(Frame* f, stmt_flow_type& flow) const
 	{
 	RegisterAccess();
@@ -1330,6 +1374,12 @@ TraversalCode ForStmt::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void ForStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	ExprStmt::OptimizeChildren(opt);
+	body = opt->Optimize(std::move(body));
+	}
+
 IntrusivePtr<Val> NextStmt::Exec(Frame* /* f */, stmt_flow_type& flow) const
 	{
 	RegisterAccess();
@@ -1573,6 +1623,16 @@ TraversalCode StmtList::Traverse(TraversalCallback* cb) const
 	HANDLE_TC_STMT_POST(tc);
 	}
 
+void StmtList::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	for ( auto& stmt : stmts )
+		stmt = opt->Optimize({AdoptRef{}, stmt}).release();
+
+	for ( int i = stmts.length() - 1; i >= 0; --i )
+		if ( stmts[i]->Tag() == STMT_NULL )
+			Unref(stmts.remove_nth(i));
+	}
+
 IntrusivePtr<Val> EventBodyList::Exec(Frame* f, stmt_flow_type& flow) const
 	{
 	RegisterAccess();
@@ -1841,3 +1901,10 @@ TraversalCode WhenStmt::Traverse(TraversalCallback* cb) const
 	tc = cb->PostStmt(this);
 	HANDLE_TC_STMT_POST(tc);
 	}
+
+void WhenStmt::OptimizeChildren(ScriptOptimizer* opt)
+	{
+	// The condition stays as written, for the trigger to watch it.
+	s1 = opt->Optimize(std::move(s1));
+	s2 = opt->Optimize(std::move(s2));
+	}
@@ -19,6 +19,7 @@ class EventExpr;
 class ListExpr;
 class ForStmt;
 class Frame;
+class ScriptOptimizer;
 
 class Stmt : public BroObj {
 public:
@@ -68,6 +69,10 @@ public:
 
 	virtual TraversalCode Traverse(TraversalCallback* cb) const = 0;
 
+	// Lets the optimizer replace the statements and expressions that
+	// this one contains. See ScriptOpt.h.
+	virtual void OptimizeChildren(ScriptOptimizer* opt)	{ }
+
 protected:
 	Stmt()	{}
 	explicit Stmt(BroStmtTag arg_tag);
@@ -88,6 +93,7 @@ public:
 	const ListExpr* ExprList() const	{ return l.get(); }
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	ExprListStmt(BroStmtTag t, IntrusivePtr<ListExpr> arg_l);
@@ -125,6 +131,7 @@ public:
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	ExprStmt(BroStmtTag t, IntrusivePtr<Expr> e);
@@ -142,11 +149,14 @@ public:
 	~IfStmt() override;
 
 	const Stmt* TrueBranch() const	{ return s1.get(); }
+	Stmt* TrueBranch()		{ return s1.get(); }
 	const Stmt* FalseBranch() const	{ return s2.get(); }
+	Stmt* FalseBranch()		{ return s2.get(); }
 
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	IntrusivePtr<Val> DoExec(Frame* f, Val* v, stmt_flow_type& flow) const override;
@@ -173,6 +183,7 @@ public:
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const;
+	void OptimizeChildren(ScriptOptimizer* opt);
 
 protected:
 	IntrusivePtr<ListExpr> expr_cases;
@@ -192,6 +203,7 @@ public:
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	IntrusivePtr<Val> DoExec(Frame* f, Val* v, stmt_flow_type& flow) const override;
@@ -250,6 +262,7 @@ public:
 	IntrusivePtr<Val> Exec(Frame* f, stmt_flow_type& flow) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	IntrusivePtr<EventExpr> event_expr;
@@ -263,9 +276,12 @@ public:
 
 	bool IsPure() const override;
 
+	const Expr* Condition() const	{ return loop_condition.get(); }
+
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	IntrusivePtr<Val> Exec(Frame* f, stmt_flow_type& flow) const override;
@@ -292,6 +308,7 @@ public:
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	IntrusivePtr<Val> DoExec(Frame* f, Val* v, stmt_flow_type& flow) const override;
@@ -367,6 +384,7 @@ public:
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	bool IsPure() const override;
@@ -440,6 +458,7 @@ public:
 	void Describe(ODesc* d) const override;
 
 	TraversalCode Traverse(TraversalCallback* cb) const override;
+	void OptimizeChildren(ScriptOptimizer* opt) override;
 
 protected:
 	IntrusivePtr<Expr> cond;
@@ -2,6 +2,8 @@
 
 #include "zeek-config.h"
 
+#include <algorithm>
+
 #include "util.h"
 #include "Timer.h"
 #include "Desc.h"
@@ -187,3 +189,405 @@ double PQ_TimerMgr::GetNextTimeout()
 
 	return -1;
 	}
+
+
+// Width of a tick of the timing wheel, in seconds.
+#define WHEEL_RESOLUTION 0.001
+
+Wheel_TimerMgr::Wheel_TimerMgr() : TimerMgr()
+	{
+	for ( int i = 0; i < NUM_LEVELS; ++i )
+		level_count[i] = 0;
+	}
+
+Wheel_TimerMgr::~Wheel_TimerMgr()
+	{
+	}
+
+uint64_t Wheel_TimerMgr::Tick(double t)
+	{
+	if ( t <= 0 )
+		return 0;
+
+	double ticks = t / WHEEL_RESOLUTION;
+
+	if ( ticks >= 18446744073709551615.0 )
+		return UINT64_MAX;
+
+	return uint64_t(ticks);
+	}
+
+std::vector<Timer*>& Wheel_TimerMgr::Bucket(uint16_t bucket)
+	{
+	if ( bucket == DUE_BUCKET )
+		return due;
+
+	if ( bucket == BATCH_BUCKET )
+		return batch;
+
+	return slots[bucket / SLOTS_PER_LEVEL][bucket % SLOTS_PER_LEVEL];
+	}
+
+void Wheel_TimerMgr::Insert(Timer* timer, uint16_t bucket)
+	{
+	auto& b = Bucket(bucket);
+	timer->SetOffset(b.size());
+	timer->wheel_bucket = bucket;
+	b.push_back(timer);
+	}
+
+void Wheel_TimerMgr::Place(Timer* timer)
+	{
+	uint64_t tick = Tick(timer->Time());
+
+	// Add the timer even if it's already expired - that way, if
+	// multiple already-added timers are added, they'll still
+	// execute in sorted order.
+	if ( tick <= cur_tick )
+		{
+		Insert(timer, DUE_BUCKET);
+		due_added = true;
+		return;
+		}
+
+	// The timer goes onto the level of the highest byte in which its
+	// tick differs from the current one.
+	int level = (63 - __builtin_clzll(tick ^ cur_tick)) / BITS_PER_LEVEL;
+	int slot = (tick >> (level * BITS_PER_LEVEL)) & (SLOTS_PER_LEVEL - 1);
+
+	++level_count[level];
+	Insert(timer, level * SLOTS_PER_LEVEL + slot);
+	}
+
+void Wheel_TimerMgr::Unlink(Timer* timer)
+	{
+	uint16_t bucket = timer->wheel_bucket;
+	auto& b = Bucket(bucket);
+	int offset = timer->Offset();
+
+	if ( offset < 0 || offset >= int(b.size()) || b[offset] != timer )
+		reporter->InternalError("asked to remove a missing timer");
+
+	if ( bucket == BATCH_BUCKET )
+		{
+		// Don't disturb the order of a batch being dispatched.
+		b[offset] = nullptr;
+		return;
+		}
+
+	Timer* last = b.back();
+	b[offset] = last;
+	last->SetOffset(offset);
+	b.pop_back();
+
+	if ( bucket < DUE_BUCKET )
+		--level_count[bucket / SLOTS_PER_LEVEL];
+	}
+
+void Wheel_TimerMgr::Add(Timer* timer)
+	{
+	DBG_LOG(DBG_TM, "Adding timer %s (%p) at %.6f",
+	        timer_type_to_string(timer->Type()), timer, timer->Time());
+
+	Place(timer);
+
+	if ( ++num_timers > peak_num_timers )
+		peak_num_timers = num_timers;
+
+	++cumulative_num;
+	++current_timers[timer->Type()];
+	}
+
+void Wheel_TimerMgr::Remove(Timer* timer)
+	{
+	Unlink(timer);
+
+	--num_timers;
+	--current_timers[timer->Type()];
+	delete timer;
+	}
+
+void Wheel_TimerMgr::Cascade(int level)
+	{
+	int slot = (cur_tick >> (level * BITS_PER_LEVEL)) & (SLOTS_PER_LEVEL - 1);
+
+	std::vector<Timer*> timers;
+	timers.swap(slots[level][slot]);
+	level_count[level] -= timers.size();
+
+	for ( const auto& timer : timers )
+		Place(timer);
+	}
+
+void Wheel_TimerMgr::AdvanceTo(uint64_t tick)
+	{
+	constexpr uint64_t slot_mask = SLOTS_PER_LEVEL - 1;
+
+	while ( cur_tick < tick )
+		{
+		int level = 0;
+
+		while ( level < NUM_LEVELS && level_count[level] == 0 )
+			++level;
+
+		if ( level == NUM_LEVELS )
+			{
+			// Wheel is empty.
+			cur_tick = tick;
+			break;
+			}
+
+		if ( level == 0 )
+			{
+			// Collect the rest of the current revolution of the
+			// lowest level, as far as we're going.
+			uint64_t end = std::min(cur_tick | slot_mask, tick);
+
+			for ( uint64_t t = cur_tick + 1;
+			      t <= end && level_count[0] > 0; ++t )
+				{
+				auto& s = slots[0][t & slot_mask];
+				level_count[0] -= s.size();
+
+				for ( const auto& timer : s )
+					Insert(timer, DUE_BUCKET);
+
+				s.clear();
+				}
+
+			cur_tick = end;
+			}
+		else
+			{
+			// Nothing below this level, so we can skip ahead
+			// to where its current slot ends.
+			uint64_t low_mask =
+				(uint64_t(1) << (level * BITS_PER_LEVEL)) - 1;
+			cur_tick = std::min(cur_tick | low_mask, tick);
+			}
+
+		if ( cur_tick == tick )
+			break;
+
+		// Step into the next revolution of the lowest level.  That
+		// changes the current slot on each level up to the first
+		// one that doesn't wrap around; the timers in those slots
+		// now need to move further down.
+		++cur_tick;
+
+		int top = 1;
+
+		while ( top < NUM_LEVELS - 1 &&
+			((cur_tick >> (top * BITS_PER_LEVEL)) & slot_mask) == 0 )
+			++top;
+
+		for ( int l = top; l > 0; --l )
+			Cascade(l);
+		}
+	}
+
+void Wheel_TimerMgr::SortBatch(size_t start)
+	{
+	batch.erase(std::remove(batch.begin() + start, batch.end(), nullptr),
+	            batch.end());
+
+	std::stable_sort(batch.begin() + start, batch.end(),
+	                 [](const Timer* a, const Timer* b)
+	                 { return a->Time() < b->Time(); });
+
+	for ( size_t i = start; i < batch.size(); ++i )
+		batch[i]->SetOffset(i);
+	}
+
+void Wheel_TimerMgr::MergeDue(size_t start, double t, bool is_expire)
+	{
+	bool merged = false;
+
+	for ( size_t i = 0; i < due.size(); )
+		{
+		Timer* timer = due[i];
+
+		if ( is_expire || timer->Time() <= t )
+			{
+			Unlink(timer);
+			Insert(timer, BATCH_BUCKET);
+			merged = true;
+			}
+		else
+			++i;
+		}
+
+	if ( merged )
+		SortBatch(start);
+	}
+
+int Wheel_TimerMgr::DispatchBatch(double t, bool is_expire, int max_expire)
+	{
+	SortBatch(0);
+	due_added = false;
+
+	int n = 0;
+	size_t i = 0;
+
+	for ( ; i < batch.size(); ++i )
+		{
+		Timer* timer = batch[i];
+
+		if ( ! timer )
+			// Canceled by an earlier one.
+			continue;
+
+		if ( max_expire && n >= max_expire )
+			break;
+
+		// Take it out before dispatching, since the dispatch
+		// can otherwise delete it, and then we won't know
+		// whether we should delete it too.
+		batch[i] = nullptr;
+		--num_timers;
+		--current_timers[timer->Type()];
+
+		if ( ! is_expire )
+			last_timestamp = timer->Time();
+
+		DBG_LOG(DBG_TM, "Dispatching timer %s (%p)",
+		        timer_type_to_string(timer->Type()), timer);
+		timer->Dispatch(t, is_expire);
+		delete timer;
+		++n;
+
+		if ( due_added )
+			{
+			// The dispatch added timers that are due already.
+			// Like PQ_TimerMgr, run them in time order with the
+			// rest of the batch rather than after it.
+			due_added = false;
+			MergeDue(i + 1, t, is_expire);
+			}
+		}
+
+	// Return what we didn't get to.
+	for ( ; i < batch.size(); ++i )
+		if ( batch[i] )
+			Insert(batch[i], DUE_BUCKET);
+
+	batch.clear();
+	return n;
+	}
+
+int Wheel_TimerMgr::DoAdvance(double new_t, int max_expire)
+	{
+	uint64_t tick = Tick(new_t);
+
+	if ( tick > cur_tick )
+		AdvanceTo(tick);
+
+	for ( num_expired = 0; num_expired < max_expire || max_expire == 0; )
+		{
+		// Within the current tick, only some timers may be due yet.
+		for ( size_t i = 0; i < due.size(); )
+			{
+			Timer* timer = due[i];
+
+			if ( timer->Time() <= new_t )
+				{
+				Unlink(timer);
+				Insert(timer, BATCH_BUCKET);
+				}
+			else
+				++i;
+			}
+
+		if ( batch.empty() )
+			break;
+
+		// Dispatching may add further timers that are due already,
+		// hence the loop.
+		num_expired += DispatchBatch(new_t, false,
+		                             max_expire ? max_expire - num_expired : 0);
+		}
+
+	return num_expired;
+	}
+
+void Wheel_TimerMgr::Expire()
+	{
+	for ( ; ; )
+		{
+		for ( int l = 0; l < NUM_LEVELS; ++l )
+			{
+			if ( level_count[l] == 0 )
+				continue;
+
+			for ( auto& s : slots[l] )
+				{
+				for ( const auto& timer : s )
+					Insert(timer, BATCH_BUCKET);
+
+				s.clear();
+				}
+
+			level_count[l] = 0;
+			}
+
+		for ( const auto& timer : due )
+			Insert(timer, BATCH_BUCKET);
+
+		due.clear();
+
+		if ( batch.empty() )
+			break;
+
+		DispatchBatch(t, true, 0);
+		}
+	}
+
+double Wheel_TimerMgr::GetNextTimeout()
+	{
+	if ( ! due.empty() )
+		{
+		double next = due[0]->Time();
+
+		for ( const auto& timer : due )
+			next = std::min(next, timer->Time());
+
+		return std::max(0.0, next - ::network_time);
+		}
+
+	for ( int l = 0; l < NUM_LEVELS; ++l )
+		{
+		if ( level_count[l] == 0 )
+			continue;
+
+		int shift = l * BITS_PER_LEVEL;
+		int cur_slot = (cur_tick >> shift) & (SLOTS_PER_LEVEL - 1);
+
+		for ( int slot = cur_slot + 1; slot < SLOTS_PER_LEVEL; ++slot )
+			{
+			const auto& s = slots[l][slot];
+
+			if ( s.empty() )
+				continue;
+
+			if ( l == 0 )
+				{
+				double next = s[0]->Time();
+
+				for ( const auto& timer : s )
+					next = std::min(next, timer->Time());
+
+				return std::max(0.0, next - ::network_time);
+				}
+
+			// Higher up we only know where the slot starts,
+			// which is good enough for a timeout.
+			uint64_t upper = shift + BITS_PER_LEVEL < 64 ?
+				(cur_tick >> (shift + BITS_PER_LEVEL)) << (shift + BITS_PER_LEVEL) : 0;
+			uint64_t start = upper | (uint64_t(slot) << shift);
+
+			return std::max(0.0, start * WHEEL_RESOLUTION - ::network_time);
+			}
+		}
+
+	return -1;
+	}
@@ -6,6 +6,7 @@
 #include "iosource/IOSource.h"
 
 #include <stdint.h>
+#include <vector>
 
 // If you add a timer here, adjust TimerNames in Timer.cc.
 enum TimerType : uint8_t {
@@ -62,8 +63,14 @@ public:
 	void Describe(ODesc* d) const;
 
 protected:
+	friend class Wheel_TimerMgr;
+
 	Timer()	{}
 	TimerType type;
+
+	// Bucket holding the timer when managed by a Wheel_TimerMgr.
+	// (Fits into the padding after the type.)
+	uint16_t wheel_bucket = 0;
 };
 
 class TimerMgr : public iosource::IOSource {
@@ -167,4 +174,85 @@ protected:
 	PriorityQueue* q;
 };
 
+// A hierarchical timing wheel.  Timers are hashed into buckets by their
+// expiration tick, with a level for each byte of the tick in which the
+// timer's tick differs from the current one.  Adding and canceling timers
+// is O(1); when time moves forward, the buckets that come due are cascaded
+// down a level and eventually collected into a batch, which is then
+// dispatched in time order.
+class Wheel_TimerMgr : public TimerMgr {
+public:
+	Wheel_TimerMgr();
+	~Wheel_TimerMgr() override;
+
+	void Add(Timer* timer) override;
+	void Expire() override;
+
+	int Size() const override { return num_timers; }
+	int PeakSize() const override { return peak_num_timers; }
+	uint64_t CumulativeNum() const override { return cumulative_num; }
+	double GetNextTimeout() override;
+
+protected:
+	int DoAdvance(double t, int max_expire) override;
+	void Remove(Timer* timer) override;
+
+	static constexpr int BITS_PER_LEVEL = 8;
+	static constexpr int SLOTS_PER_LEVEL = 1 << BITS_PER_LEVEL;
+	static constexpr int NUM_LEVELS = 64 / BITS_PER_LEVEL;
+
+	// Bucket IDs beyond the wheel slots.
+	static constexpr uint16_t DUE_BUCKET = NUM_LEVELS * SLOTS_PER_LEVEL;
+	static constexpr uint16_t BATCH_BUCKET = DUE_BUCKET + 1;
+
+	static uint64_t Tick(double t);
+
+	// Puts the timer into the bucket matching its tick, relative to
+	// the current one.
+	void Place(Timer* timer);
+	void Insert(Timer* timer, uint16_t bucket);
+	void Unlink(Timer* timer);
+
+	// Moves the wheel forward to the given tick, moving all timers
+	// that are due by then into the due bucket.
+	void AdvanceTo(uint64_t tick);
+
+	// Re-places the timers of the bucket at the given level matching
+	// the current tick, after the current tick changed at that level.
+	void Cascade(int level);
+
+	// Dispatches the timers currently in the batch, in time order.
+	// Stops after max_expire timers (0 for no limit), returning any
+	// left-overs to the due bucket.
+	int DispatchBatch(double t, bool is_expire, int max_expire);
+
+	// Sorts the batch from the given position on by time, dropping
+	// canceled timers.
+	void SortBatch(size_t start);
+
+	// Moves the due timers expiring by the given time into the batch,
+	// from the given position on.
+	void MergeDue(size_t start, double t, bool is_expire);
+
+	std::vector<Timer*>& Bucket(uint16_t bucket);
+
+	std::vector<Timer*> slots[NUM_LEVELS][SLOTS_PER_LEVEL];
+	int level_count[NUM_LEVELS];
+
+	// Timers whose tick has been reached, though not necessarily
+	// their exact time.
+	std::vector<Timer*> due;
+
+	// Timers being dispatched.  Canceled ones are set to nil.
+	std::vector<Timer*> batch;
+
+	// Whether a timer went into the due bucket since the last check.
+	bool due_added = false;
+
+	uint64_t cur_tick = 0;
+	int num_timers = 0;
+	int peak_num_timers = 0;
+	uint64_t cumulative_num = 0;
+};
+
 extern TimerMgr* timer_mgr;
@@ -731,6 +731,17 @@ int RecordType::FieldOffset(const char* field) const
 	return -1;
 	}
 
+int RecordType::AddNativeSlot(int field)
+	{
+	if ( field >= static_cast<int>(native_slots.size()) )
+		native_slots.resize(field + 1, -1);
+
+	if ( native_slots[field] < 0 )
+		native_slots[field] = num_native_slots++;
+
+	return native_slots[field];
+	}
+
 const char* RecordType::FieldName(int field) const
 	{
 	return FieldDecl(field)->id;
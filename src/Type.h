@@ -13,6 +13,7 @@
 #include <map>
 #include <list>
 #include <optional>
+#include <vector>
 
 // BRO types.
 
@@ -588,11 +589,28 @@ public:
 
 	std::string GetFieldDeprecationWarning(int field, bool has_check) const;
 
+	// RecordVal keeps the values of some scalar fields unboxed, in
+	// slots numbered per type as the fields first get assigned that
+	// way. Returns negative if the field hasn't got a slot.
+	int NativeSlot(int field) const
+		{
+		return field < static_cast<int>(native_slots.size()) ?
+			native_slots[field] : -1;
+		}
+
+	// Returns the field's slot, assigning the next one if needed.
+	int AddNativeSlot(int field);
+
+	int NumNativeSlots() const	{ return num_native_slots; }
+
 protected:
 	RecordType() { types = nullptr; }
 
 	int num_fields;
 	type_decl_list* types;
+
+	std::vector<int> native_slots;
+	int num_native_slots = 0;
 };
 
 class SubNetType final : public BroType {
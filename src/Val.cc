@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cmath>
 #include <set>
 
@@ -34,6 +35,7 @@
 #include "Conn.h"
 #include "Reporter.h"
 #include "IPAddr.h"
+#include "Slab.h"
 #include "Var.h" // for internal_type()
 
 #include "broker/Data.h"
@@ -1388,7 +1390,6 @@ void TableVal::Init(IntrusivePtr<TableType> t)
 	table_type = std::move(t);
 	expire_func = nullptr;
 	expire_time = nullptr;
-	expire_cookie = nullptr;
 	timer = nullptr;
 	def_val = nullptr;
 
@@ -1408,6 +1409,7 @@ TableVal::~TableVal()
 	if ( timer )
 		timer_mgr->Cancel(timer);
 
+	ClearExpirationIndex();
 	delete table_hash;
 	delete AsTable();
 	delete subnets;
@@ -1415,7 +1417,19 @@ TableVal::~TableVal()
 
 void TableVal::RemoveAll()
 	{
-	// Here we take the brute force approach.
+	// Here we take the brute force approach.  If we're in the middle of
+	// expiring (i.e., an &expire_func is clearing the table), the index
+	// is in use, so we only clear its slots.
+	if ( ! in_expire )
+		ClearExpirationIndex();
+	else
+		for ( auto& bucket : expire_index )
+			for ( auto& k : bucket.second )
+				{
+				delete k;
+				k = nullptr;
+				}
+
 	delete AsTable();
 	val.table_val = new PDict<TableEntryVal>;
 	val.table_val->SetDeleteFunc(table_entry_val_delete_func);
@@ -1493,6 +1507,8 @@ void TableVal::CheckExpireAttr(attr_tag at)
 		// we set a timer which fires immediately.
 		timer = new TableValTimer(this, 1);
 		timer_mgr->Add(timer);
+
+		RebuildExpirationIndex();
 		}
 	}
 
@@ -1545,6 +1561,26 @@ bool TableVal::Assign(Val* index, HashKey* k, IntrusivePtr<Val> new_val)
 	if ( old_entry_val && attrs && attrs->FindAttr(ATTR_EXPIRE_CREATE) )
 		new_entry_val->SetExpireAccess(old_entry_val->ExpireAccessTime());
 
+	if ( ExpirationEnabled() )
+		{
+		if ( old_entry_val &&
+		     old_entry_val->expire_bucket <= new_entry_val->expire_access_time )
+			{
+			// The key is already filed no later than where it
+			// belongs now; DoExpire() moves it along if needed.
+			new_entry_val->expire_bucket = old_entry_val->expire_bucket;
+			new_entry_val->expire_slot = old_entry_val->expire_slot;
+			}
+		else
+			{
+			if ( old_entry_val )
+				UnindexForExpiration(old_entry_val);
+
+			IndexForExpiration(new HashKey(k_copy.Key(), k_copy.Size(), k_copy.Hash()),
+			                   new_entry_val, new_entry_val->expire_access_time);
+			}
+		}
+
 	Modified();
 
 	if ( change_func )
@@ -2061,6 +2097,9 @@ IntrusivePtr<Val> TableVal::Delete(const Val* index)
 	if ( subnets && ! subnets->Remove(index) )
 		reporter->InternalWarning("index not in prefix table");
 
+	if ( v )
+		UnindexForExpiration(v);
+
 	delete k;
 	delete v;
 
@@ -2085,6 +2124,9 @@ IntrusivePtr<Val> TableVal::Delete(const HashKey* k)
 			reporter->InternalWarning("index not in prefix table");
 		}
 
+	if ( v )
+		UnindexForExpiration(v);
+
 	delete v;
 
 	Modified();
@@ -2299,6 +2341,49 @@ void TableVal::InitTimer(double delay)
 	timer_mgr->Add(timer);
 	}
 
+void TableVal::IndexForExpiration(HashKey* k, TableEntryVal* v, int bucket)
+	{
+	auto& keys = expire_index[bucket];
+	keys.push_back(k);
+
+	// References into a deque stay valid as it grows or shrinks at
+	// its ends.
+	v->expire_bucket = bucket;
+	v->expire_slot = &keys.back();
+	}
+
+void TableVal::UnindexForExpiration(TableEntryVal* v)
+	{
+	if ( ! v->expire_slot )
+		return;
+
+	delete *v->expire_slot;
+	*v->expire_slot = nullptr;
+	v->expire_slot = nullptr;
+	}
+
+void TableVal::RebuildExpirationIndex()
+	{
+	ClearExpirationIndex();
+
+	const PDict<TableEntryVal>* tbl = AsTable();
+	IterCookie* c = tbl->InitForIteration();
+
+	HashKey* k;
+	TableEntryVal* v;
+	while ( (v = tbl->NextEntry(k, c)) )
+		IndexForExpiration(k, v, v->expire_access_time);
+	}
+
+void TableVal::ClearExpirationIndex()
+	{
+	for ( auto& bucket : expire_index )
+		for ( auto k : bucket.second )
+			delete k;
+
+	expire_index.clear();
+	}
+
 void TableVal::DoExpire(double t)
 	{
 	if ( ! type )
@@ -2313,31 +2398,64 @@ void TableVal::DoExpire(double t)
 		// error, it has been reported already.
 		return;
 
-	if ( ! expire_cookie )
-		{
-		expire_cookie = tbl->InitForIteration();
-		tbl->MakeRobustCookie(expire_cookie);
-		}
-
-	HashKey* k = nullptr;
-	TableEntryVal* v = nullptr;
-	TableEntryVal* v_saved = nullptr;
 	bool modified = false;
+	int scanned = 0;
+	in_expire = true;
+	auto bucket = expire_index.begin();
 
-	for ( int i = 0; i < table_incremental_step &&
-			 (v = tbl->NextEntry(k, expire_cookie)); ++i )
+	while ( bucket != expire_index.end() && scanned < table_incremental_step )
 		{
-		if ( v->ExpireAccessTime() == 0 )
+		double access_time = bro_start_network_time + bucket->first;
+
+		if ( access_time == 0 )
 			{
 			// This happens when we insert val while network_time
 			// hasn't been initialized yet (e.g. in zeek_init()), and
 			// also when bro_start_network_time hasn't been initialized
 			// (e.g. before first packet).  The expire_access_time is
 			// correct, so we just need to wait.
+			++bucket;
+			continue;
 			}
 
-		else if ( v->ExpireAccessTime() + timeout < t )
+		if ( access_time + timeout >= t )
+			// This and all later buckets aren't due yet.
+			break;
+
+		auto& keys = bucket->second;
+
+		while ( ! keys.empty() && scanned < table_incremental_step )
 			{
+			HashKey* k = keys.front();
+			++scanned;
+
+			if ( ! k )
+				{
+				// Deleted since.
+				keys.pop_front();
+				continue;
+				}
+
+			TableEntryVal* v = tbl->Lookup(k);
+
+			if ( ! v || v->expire_slot != &keys.front() )
+				{
+				reporter->InternalWarning("stale key in table expiration index");
+				keys.pop_front();
+				delete k;
+				continue;
+				}
+
+			keys.pop_front();
+			v->expire_slot = nullptr;
+
+			if ( v->expire_access_time > bucket->first )
+				{
+				// Accessed since it was filed.
+				IndexForExpiration(k, v, v->expire_access_time);
+				continue;
+				}
+
 			IntrusivePtr<ListVal> idx = nullptr;
 
 			if ( expire_func )
@@ -2348,12 +2466,11 @@ void TableVal::DoExpire(double t)
 				// It's possible that the user-provided
 				// function modified or deleted the table
 				// value, so look it up again.
-				v_saved = v;
+				tbl = AsNonConstTable();
 				v = tbl->Lookup(k);
 
 				if ( ! v )
 					{ // user-provided function deleted it
-					v = v_saved;
 					delete k;
 					continue;
 					}
@@ -2363,7 +2480,13 @@ void TableVal::DoExpire(double t)
 					// User doesn't want us to expire
 					// this now.
 					v->SetExpireAccess(network_time - timeout + secs);
-					delete k;
+
+					// The function may have re-added it.
+					UnindexForExpiration(v);
+
+					// Don't come back to it during this pass.
+					IndexForExpiration(k, v, std::max(v->expire_access_time,
+					                                  bucket->first + 1));
 					continue;
 					}
 
@@ -2378,6 +2501,8 @@ void TableVal::DoExpire(double t)
 				}
 
 			tbl->RemoveEntry(k);
+			UnindexForExpiration(v);
+
 			if ( change_func )
 				{
 				if ( ! idx )
@@ -2386,20 +2511,26 @@ void TableVal::DoExpire(double t)
 				}
 
 			delete v;
+			delete k;
 			modified = true;
+			++expire_stats.expired;
 			}
 
-		delete k;
+		if ( ! keys.empty() )
+			// Ran out of steps.
+			break;
+
+		bucket = expire_index.erase(bucket);
 		}
 
+	in_expire = false;
+	expire_stats.scanned += scanned;
+
 	if ( modified )
 		Modified();
 
-	if ( ! v )
-		{
-		expire_cookie = nullptr;
+	if ( scanned < table_incremental_step )
 		InitTimer(table_expire_interval);
-		}
 	else
 		InitTimer(table_expire_delay);
 	}
@@ -2525,6 +2656,7 @@ IntrusivePtr<Val> TableVal::DoClone(CloneState* state)
 	if ( expire_time )
 		{
 		tv->expire_time = expire_time;
+		tv->RebuildExpirationIndex();
 
 		// As network_time is not necessarily initialized yet, we set
 		// a timer which fires immediately.
@@ -2556,6 +2688,14 @@ unsigned int TableVal::MemoryAllocation() const
 		size += padded_sizeof(TableEntryVal);
 		}
 
+	for ( const auto& bucket : expire_index )
+		{
+		size += pad_size(bucket.second.size() * sizeof(HashKey*));
+
+		for ( const auto& k : bucket.second )
+			size += k->MemoryAllocation();
+		}
+
 	return size + padded_sizeof(*this) + val.table_val->MemoryAllocation()
 		+ table_hash->MemoryAllocation();
 	}
@@ -2625,6 +2765,8 @@ void TableVal::RebuildTable(ParseTimeTableState ptts)
 
 TableVal::ParseTimeTableStates TableVal::parse_time_table_states;
 
+TableVal::ExpireStats TableVal::expire_stats;
+
 TableVal::TableRecordDependencies TableVal::parse_time_table_record_dependencies;
 
 RecordVal::RecordTypeValMap RecordVal::parse_time_records;
@@ -2682,6 +2824,7 @@ RecordVal::RecordVal(RecordType* t, bool init_fields) : Val(t)
 RecordVal::~RecordVal()
 	{
 	delete_vals(AsNonConstRecord());
+	slab_allocator.Free(native_fields, num_native_fields * sizeof(NativeField));
 	}
 
 IntrusivePtr<Val> RecordVal::SizeVal() const
@@ -2693,6 +2836,15 @@ void RecordVal::Assign(int field, IntrusivePtr<Val> new_val)
 	{
 	Val* old_val = AsNonConstRecord()->replace(field, new_val.release());
 	Unref(old_val);
+
+	if ( num_native_fields )
+		{
+		int slot = Type()->AsRecordType()->NativeSlot(field);
+
+		if ( slot >= 0 && slot < num_native_fields )
+			native_fields[slot].is_set = false;
+		}
+
 	Modified();
 	}
 
@@ -2701,14 +2853,130 @@ void RecordVal::Assign(int field, Val* new_val)
 	Assign(field, {AdoptRef{}, new_val});
 	}
 
+void RecordVal::AssignBool(int field, bool b)
+	{
+	SetNative(field)->int_val = b;
+	Modified();
+	}
+
+void RecordVal::AssignInt(int field, bro_int_t i)
+	{
+	SetNative(field)->int_val = i;
+	Modified();
+	}
+
+void RecordVal::AssignCount(int field, bro_uint_t u)
+	{
+	SetNative(field)->uint_val = u;
+	Modified();
+	}
+
+void RecordVal::AssignDouble(int field, double d)
+	{
+	SetNative(field)->double_val = d;
+	Modified();
+	}
+
+void RecordVal::AssignAddr(int field, const IPAddr& addr)
+	{
+	addr.CopyIPv6(&SetNative(field)->addr_val);
+	Modified();
+	}
+
+RecordVal::NativeField* RecordVal::SetNative(int field)
+	{
+	RecordType* rt = Type()->AsRecordType();
+	int slot = rt->AddNativeSlot(field);
+
+	if ( slot >= num_native_fields )
+		{
+		// Sized after the slots the type has handed out so far, which
+		// only grow while records of it get their first assignments.
+		int n = rt->NumNativeSlots();
+		auto nf = static_cast<NativeField*>(slab_allocator.Allocate(n * sizeof(NativeField)));
+
+		if ( num_native_fields )
+			memcpy(nf, native_fields, num_native_fields * sizeof(NativeField));
+
+		for ( int i = num_native_fields; i < n; ++i )
+			nf[i].is_set = false;
+
+		slab_allocator.Free(native_fields, num_native_fields * sizeof(NativeField));
+		native_fields = nf;
+		num_native_fields = n;
+		}
+
+	Val* old_val = AsNonConstRecord()->replace(field, nullptr);
+	Unref(old_val);
+
+	NativeField* nf = &native_fields[slot];
+	nf->is_set = true;
+	return nf;
+	}
+
 Val* RecordVal::Lookup(int field) const
 	{
-	return (*AsRecord())[field];
+	Val* v = (*AsRecord())[field];
+
+	if ( v || ! num_native_fields )
+		return v;
+
+	return LookupNative(field);
+	}
+
+Val* RecordVal::LookupNative(int field) const
+	{
+	int slot = Type()->AsRecordType()->NativeSlot(field);
+
+	if ( slot < 0 || slot >= num_native_fields )
+		return nullptr;
+
+	const NativeField& nf = native_fields[slot];
+
+	if ( ! nf.is_set )
+		return nullptr;
+
+	TypeTag tag = Type()->AsRecordType()->FieldType(field)->Tag();
+	IntrusivePtr<Val> v;
+
+	switch ( tag ) {
+	case TYPE_BOOL:
+		v = val_mgr->Bool(nf.int_val);
+		break;
+
+	case TYPE_INT:
+		v = val_mgr->Int(nf.int_val);
+		break;
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		v = val_mgr->Count(nf.uint_val);
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		v = make_intrusive<Val>(nf.double_val, tag);
+		break;
+
+	case TYPE_ADDR:
+		v = make_intrusive<AddrVal>(IPAddr(nf.addr_val));
+		break;
+
+	default:
+		reporter->InternalError("bad type in RecordVal::LookupNative");
+	}
+
+	// Keep it around until the field gets assigned again, so that
+	// repeated lookups return the same Val.
+	Val* rval = v.release();
+	val.val_list_val->replace(field, rval);
+	return rval;
 	}
 
 IntrusivePtr<Val> RecordVal::LookupWithDefault(int field) const
 	{
-	Val* val = (*AsRecord())[field];
+	Val* val = Lookup(field);
 
 	if ( val )
 		return {NewRef{}, val};
@@ -2858,7 +3126,7 @@ void RecordVal::Describe(ODesc* d) const
 		if ( ! d->IsBinary() )
 			d->Add("=");
 
-		Val* v = (*vl)[i];
+		Val* v = Lookup(i);
 		if ( v )
 			v->Describe(d);
 		else
@@ -2886,7 +3154,7 @@ void RecordVal::DescribeReST(ODesc* d) const
 		d->Add(record_type->FieldName(i));
 		d->Add("=");
 
-		Val* v = (*vl)[i];
+		Val* v = Lookup(i);
 
 		if ( v )
 			v->Describe(d);
@@ -2915,6 +3183,14 @@ IntrusivePtr<Val> RecordVal::DoClone(CloneState* state)
   		rv->val.val_list_val->push_back(v.release());
 		}
 
+	if ( num_native_fields )
+		{
+		size_t size = num_native_fields * sizeof(NativeField);
+		rv->native_fields = static_cast<NativeField*>(slab_allocator.Allocate(size));
+		rv->num_native_fields = num_native_fields;
+		memcpy(rv->native_fields, native_fields, size);
+		}
+
 	return rv;
 	}
 
@@ -2929,6 +3205,8 @@ unsigned int RecordVal::MemoryAllocation() const
 		    size += v->MemoryAllocation();
 		}
 
+	size += num_native_fields * sizeof(NativeField);
+
 	return size + padded_sizeof(*this) + val.val_list_val->MemoryAllocation();
 	}
 
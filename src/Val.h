@@ -11,6 +11,8 @@
 #include <vector>
 #include <list>
 #include <array>
+#include <deque>
+#include <map>
 #include <unordered_map>
 
 #include <sys/types.h> // for u_char
@@ -693,6 +695,12 @@ protected:
 	// to save a few bytes, as we do not need a high resolution for these
 	// anyway.
 	int expire_access_time;
+
+	// The bucket of the table's expiration index this entry is
+	// currently filed under, and its key's slot in there (nil while
+	// not filed).
+	int expire_bucket = 0;
+	HashKey** expire_slot = nullptr;
 };
 
 class TableValTimer final : public Timer {
@@ -815,6 +823,14 @@ public:
 	void InitTimer(double delay);
 	void DoExpire(double t);
 
+	// Statistics about item expiration, summed up across all tables.
+	struct ExpireStats {
+		uint64_t scanned = 0;	// entries looked at by expiration passes
+		uint64_t expired = 0;	// entries actually expired
+	};
+
+	static const ExpireStats& GetExpireStats()	{ return expire_stats; }
+
 	// If the &default attribute is not a function, or the functon has
 	// already been initialized, this does nothing. Otherwise, evaluates
 	// the function in the frame allowing it to capture its closure.
@@ -866,6 +882,17 @@ protected:
 	// Returns true if item expiration is enabled.
 	bool ExpirationEnabled()	{ return expire_time != nullptr; }
 
+	// Files the key of the given entry in the expiration index, under
+	// the given bucket.  Takes ownership of the key.
+	void IndexForExpiration(HashKey* k, TableEntryVal* v, int bucket);
+
+	// Drops the given entry's key from the expiration index, if filed.
+	void UnindexForExpiration(TableEntryVal* v);
+
+	// Recreates the expiration index from the table's current content.
+	void RebuildExpirationIndex();
+	void ClearExpirationIndex();
+
 	// Returns the expiration time defined by %{create,read,write}_expire
 	// attribute, or -1 for unset/invalid values. In the invalid case, an
 	// error will have been reported.
@@ -888,15 +915,24 @@ protected:
 	IntrusivePtr<Expr> expire_time;
 	IntrusivePtr<Expr> expire_func;
 	TableValTimer* timer;
-	IterCookie* expire_cookie;
 	PrefixTable* subnets;
 	IntrusivePtr<Val> def_val;
 	IntrusivePtr<Expr> change_func;
 	// prevent recursion of change functions
 	bool in_change_func = false;
 
+	// If expiration is enabled, the keys of all entries bucketed by
+	// their expiration access time (the map's key).  An expiration pass
+	// thus only needs to look at buckets that are old enough.  Entries
+	// are filed lazily: a key whose entry has been accessed again since
+	// gets moved along when its bucket comes up.  Deleting an entry
+	// clears its key's slot, which the expiration pass then skips.
+	std::map<int, std::deque<HashKey*>> expire_index;
+	bool in_expire = false;
+
 	static TableRecordDependencies parse_time_table_record_dependencies;
 	static ParseTimeTableStates parse_time_table_states;
+	static ExpireStats expire_stats;
 };
 
 class RecordVal final : public Val, public notifier::Modifiable {
@@ -911,6 +947,22 @@ public:
 	Val* Lookup(int field) const;	// Does not Ref() value.
 	IntrusivePtr<Val> LookupWithDefault(int field) const;
 
+	// Assign scalar values without boxing them. Each is equivalent to
+	// assigning the corresponding Val (e.g., AssignCount(i, n) to
+	// Assign(i, val_mgr->Count(n))), but the value goes into a slot
+	// that the record type assigns to the field, and a Val only gets
+	// created once the field is looked up. This keeps the event
+	// engine's frequent updates of records such as the connection
+	// record cheap.
+	void AssignBool(int field, bool b);
+	void AssignInt(int field, bro_int_t i);
+	void AssignCount(int field, bro_uint_t u);
+
+	// For fields of type double, time, or interval.
+	void AssignDouble(int field, double d);
+
+	void AssignAddr(int field, const IPAddr& addr);
+
 	/**
 	 * Looks up the value of a field by field name.  If the field doesn't
 	 * exist in the record type, it's an internal error: abort.
@@ -962,8 +1014,34 @@ public:
 protected:
 	IntrusivePtr<Val> DoClone(CloneState* state) override;
 
+	// An unboxed field value; which member is used follows from the
+	// field's type.
+	struct NativeField {
+		union {
+			bro_int_t int_val;
+			bro_uint_t uint_val;
+			double double_val;
+			in6_addr addr_val;
+		};
+
+		bool is_set;
+	};
+
+	// Returns the slot for a field, growing the slots to the number
+	// the type has handed out if needed. Any boxed value of the field
+	// gets dropped.
+	NativeField* SetNative(int field);
+
+	// Creates the Val for a field held in a slot, if any, and caches it
+	// in the field's val_list entry.
+	Val* LookupNative(int field) const;
+
 	BroObj* origin;
 
+	// Indexed by RecordType::NativeSlot().
+	NativeField* native_fields = nullptr;
+	int num_native_fields = 0;
+
 	using RecordTypeValMap = std::unordered_map<RecordType*, std::vector<IntrusivePtr<RecordVal>>>;
 	static RecordTypeValMap parse_time_records;
 };
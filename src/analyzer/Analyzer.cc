@@ -9,6 +9,7 @@
 #include "analyzer/protocol/pia/PIA.h"
 #include "../BroString.h"
 #include "../Event.h"
+#include "../Sessions.h"
 
 namespace analyzer {
 
@@ -842,6 +843,11 @@ void Analyzer::Weird(const char* name, const char* addl)
 	conn->Weird(name, addl);
 	}
 
+void Analyzer::BypassConnection()
+	{
+	sessions->Bypass(conn);
+	}
+
 SupportAnalyzer* SupportAnalyzer::Sibling(bool only_active) const
 	{
 	if ( ! only_active )
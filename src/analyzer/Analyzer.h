@@ -15,6 +15,7 @@
 #include "../EventHandler.h"
 #include "../Timer.h"
 #include "../IntrusivePtr.h"
+#include "../Slab.h"
 
 class BroFile;
 class Rule;
@@ -79,7 +80,7 @@ public:
  * When overiding any of the class' methods, always make sure to call the
  * base-class version first.
  */
-class Analyzer {
+class Analyzer : public SlabAllocated {
 public:
 	/**
 	 * Constructor.
@@ -319,6 +320,15 @@ public:
 	 */
 	bool Skipping() const			{ return skip; }
 
+	/**
+	 * Makes the remaining packets of the analyzer's connection bypass
+	 * analysis altogether, for analyzers that know nothing of interest
+	 * will follow. The packets then only update the connection's
+	 * timestamps and its packet and byte counts. See
+	 * NetSessions::Bypass().
+	 */
+	void BypassConnection();
+
 	/**
 	 * Returns true if Done() has been called.
 	 */
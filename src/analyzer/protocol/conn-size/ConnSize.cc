@@ -183,10 +183,12 @@ void ConnSize_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	if ( bytesidx < 0 )
 		reporter->InternalError("'endpoint' record missing 'num_bytes_ip' field");
 
-	orig_endp->Assign(pktidx, val_mgr->Count(orig_pkts));
-	orig_endp->Assign(bytesidx, val_mgr->Count(orig_bytes));
-	resp_endp->Assign(pktidx, val_mgr->Count(resp_pkts));
-	resp_endp->Assign(bytesidx, val_mgr->Count(resp_bytes));
+	// Packets bypassing analysis don't reach us, but still count.
+	Connection* c = Conn();
+	orig_endp->AssignCount(pktidx, orig_pkts + c->BypassedPackets(true));
+	orig_endp->AssignCount(bytesidx, orig_bytes + c->BypassedBytes(true));
+	resp_endp->AssignCount(pktidx, resp_pkts + c->BypassedPackets(false));
+	resp_endp->AssignCount(bytesidx, resp_bytes + c->BypassedBytes(false));
 
 	Analyzer::UpdateConnVal(conn_val);
 	}
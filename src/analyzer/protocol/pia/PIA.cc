@@ -11,7 +11,8 @@
 using namespace analyzer::pia;
 
 PIA::PIA(analyzer::Analyzer* arg_as_analyzer)
-	: state(INIT), as_analyzer(arg_as_analyzer), conn(), current_packet()
+	: BufferHolder(BUFFER_DPD), state(INIT), as_analyzer(arg_as_analyzer),
+	  conn(), current_packet()
 	{
 	}
 
@@ -22,10 +23,15 @@ PIA::~PIA()
 
 void PIA::ClearBuffer(Buffer* buffer)
 	{
+	uint64_t freed = 0;
 	DataBlock* next = nullptr;
 	for ( DataBlock* b = buffer->head; b; b = next )
 		{
 		next = b->next;
+
+		if ( b->data )
+			freed += b->len;
+
 		delete b->ip;
 		delete [] b->data;
 		delete b;
@@ -33,6 +39,16 @@ void PIA::ClearBuffer(Buffer* buffer)
 
 	buffer->head = buffer->tail = nullptr;
 	buffer->size = 0;
+
+	SetBuffered(Buffered() - freed);
+	}
+
+void PIA::EvictBuffer(Buffer* buffer)
+	{
+	ClearBuffer(buffer);
+
+	if ( buffer->state == INIT || buffer->state == BUFFERING )
+		buffer->state = dpd_match_only_beginning ? SKIPPING : MATCHING_ONLY;
 	}
 
 void PIA::AddToBuffer(Buffer* buffer, uint64_t seq, int len, const u_char* data,
@@ -44,6 +60,7 @@ void PIA::AddToBuffer(Buffer* buffer, uint64_t seq, int len, const u_char* data,
 		{
 		tmp = new u_char[len];
 		memcpy(tmp, data, len);
+		SetBuffered(Buffered() + len);
 		}
 
 	DataBlock* b = new DataBlock;
@@ -425,6 +442,12 @@ void PIA_TCP::DeactivateAnalyzer(analyzer::Tag tag)
 	reporter->InternalError("PIA_TCP::Deact not implemented yet");
 	}
 
+void PIA_TCP::EvictBuffers()
+	{
+	PIA::EvictBuffers();
+	EvictBuffer(&stream_buffer);
+	}
+
 void PIA_TCP::ReplayStreamBuffer(analyzer::Analyzer* analyzer)
 	{
 	DBG_LOG(DBG_ANALYZER, "PIA_TCP replaying %d total stream bytes", stream_buffer.size);
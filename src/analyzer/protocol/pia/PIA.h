@@ -5,6 +5,7 @@
 #include "analyzer/Analyzer.h"
 #include "analyzer/protocol/tcp/TCP.h"
 #include "RuleMatcher.h"
+#include "BufferBudget.h"
 
 class RuleEndpointState;
 
@@ -17,7 +18,7 @@ namespace analyzer { namespace pia {
 // also keeps the matching state.  This is because (i) it needs to match
 // itself, and (ii) in case of tunnel-decapsulation we may have multiple
 // PIAs and then each needs its own matching-state.
-class PIA : public RuleMatcherState {
+class PIA : public RuleMatcherState, public BufferHolder {
 public:
 	explicit PIA(analyzer::Analyzer* as_analyzer);
 	virtual ~PIA();
@@ -72,6 +73,13 @@ protected:
 				const u_char* data, bool is_orig, const IP_Hdr* ip = nullptr);
 	void ClearBuffer(Buffer* buffer);
 
+	// Clears a buffer and stops buffering into it, as if it had
+	// exceeded dpd_buffer_size.
+	void EvictBuffer(Buffer* buffer);
+
+	Connection* BufferConn() const override	{ return conn; }
+	void EvictBuffers() override	{ EvictBuffer(&pkt_buffer); }
+
 	DataBlock* CurrentPacket()	{ return &current_packet; }
 
 	void DoMatch(const u_char* data, int len, bool is_orig, bool bol,
@@ -164,6 +172,8 @@ protected:
 					const Rule* rule = nullptr) override;
 	void DeactivateAnalyzer(analyzer::Tag tag) override;
 
+	void EvictBuffers() override;
+
 private:
 	// FIXME: Not sure yet whether we need both pkt_buffer and stream_buffer.
 	// In any case, it's easier this way...
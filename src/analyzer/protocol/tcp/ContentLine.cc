@@ -7,13 +7,15 @@
 using namespace analyzer::tcp;
 
 ContentLine_Analyzer::ContentLine_Analyzer(Connection* conn, bool orig, int max_line_length)
-: TCP_SupportAnalyzer("CONTENTLINE", conn, orig), max_line_length(max_line_length)
+: TCP_SupportAnalyzer("CONTENTLINE", conn, orig), BufferHolder(BUFFER_LINES),
+  max_line_length(max_line_length)
 	{
 	InitState();
 	}
 
 ContentLine_Analyzer::ContentLine_Analyzer(const char* name, Connection* conn, bool orig, int max_line_length)
-: TCP_SupportAnalyzer(name, conn, orig), max_line_length(max_line_length)
+: TCP_SupportAnalyzer(name, conn, orig), BufferHolder(BUFFER_LINES),
+  max_line_length(max_line_length)
 	{
 	InitState();
 	}
@@ -62,6 +64,10 @@ void ContentLine_Analyzer::InitBuffer(int size)
 
 	buf = b;
 	buf_len = size;
+
+	// Only count buffers that have grown, not the small one every
+	// instance has.
+	SetBuffered(buf_len > 128 ? buf_len : 0);
 	}
 
 ContentLine_Analyzer::~ContentLine_Analyzer()
@@ -69,6 +75,24 @@ ContentLine_Analyzer::~ContentLine_Analyzer()
 	delete [] buf;
 	}
 
+void ContentLine_Analyzer::EvictBuffers()
+	{
+	if ( offset > 0 && ! SkipDeliveries() )
+		{
+		if ( offset >= buf_len )
+			// Make room for the NUL.
+			InitBuffer(offset + 1);
+
+		buf[offset] = '\0';
+		seq_delivered_in_lines = seq;
+		ForwardStream(offset, buf, IsOrig());
+		}
+
+	delete [] buf;
+	buf = nullptr;
+	InitBuffer(0);
+	}
+
 bool ContentLine_Analyzer::HasPartialLine() const
 	{
 	return buf && offset > 0;
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "analyzer/protocol/tcp/TCP.h"
+#include "BufferBudget.h"
 
 namespace analyzer { namespace tcp {
 
@@ -12,7 +13,7 @@ namespace analyzer { namespace tcp {
 // Slightly smaller than 16MB so that the buffer is not unnecessarily resized to 32M.
 #define DEFAULT_MAX_LINE_LENGTH 16 * 1024 * 1024 - 100
 
-class ContentLine_Analyzer : public TCP_SupportAnalyzer {
+class ContentLine_Analyzer : public TCP_SupportAnalyzer, public BufferHolder {
 public:
 	ContentLine_Analyzer(Connection* conn, bool orig, int max_line_length=DEFAULT_MAX_LINE_LENGTH);
 	~ContentLine_Analyzer() override;
@@ -68,6 +69,12 @@ protected:
 	void Undelivered(uint64_t seq, int len, bool orig) override;
 	void EndpointEOF(bool is_orig) override;
 
+	Connection* BufferConn() const override	{ return Conn(); }
+
+	// Passes on any partial line as it is and shrinks the buffer
+	// back to its initial size.
+	void EvictBuffers() override;
+
 	class State;
 	void InitState();
 	void InitBuffer(int size);
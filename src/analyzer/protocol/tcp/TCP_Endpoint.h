@@ -3,6 +3,7 @@
 #pragma once
 
 #include "IPAddr.h"
+#include "Slab.h"
 
 class BroFile;
 class Connection;
@@ -25,7 +26,7 @@ typedef enum {
 } EndpointState;
 
 // One endpoint of a TCP connection.
-class TCP_Endpoint {
+class TCP_Endpoint : public SlabAllocated {
 public:
 	TCP_Endpoint(TCP_Analyzer* analyzer, bool is_orig);
 	~TCP_Endpoint();
@@ -19,11 +19,14 @@ const bool DEBUG_tcp_contents = false;
 const bool DEBUG_tcp_connection_close = false;
 const bool DEBUG_tcp_match_undelivered = false;
 
+uint64_t TCP_Reassembler::zero_copy_bytes = 0;
+uint64_t TCP_Reassembler::copied_bytes = 0;
+
 TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
 				TCP_Analyzer* arg_tcp_analyzer,
 				TCP_Reassembler::Type arg_type,
 				TCP_Endpoint* arg_endp)
-	: Reassembler(1, REASSEM_TCP)
+	: Reassembler(1, REASSEM_TCP), BufferHolder(BUFFER_REASSEMBLY)
 	{
 	dst_analyzer = arg_dst_analyzer;
 	tcp_analyzer = arg_tcp_analyzer;
@@ -35,6 +38,8 @@ TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
 	skip_deliveries = false;
 	did_EOF = false;
 	seq_to_skip = 0;
+	direct_seq = 0;
+	hole_time = 0;
 	in_delivery = false;
 
 	if ( tcp_max_old_segments )
@@ -93,6 +98,11 @@ uint64_t TCP_Reassembler::NumUndeliveredBytes() const
 		return 0;
 
 	const auto& last_block = block_list.LastBlock();
+
+	// Blocks may only be held for what's been delivered already.
+	if ( last_block.upper <= last_reassem_seq )
+		return 0;
+
 	return last_block.upper - last_reassem_seq;
 	}
 
@@ -353,7 +363,12 @@ void TCP_Reassembler::RecordToSeq(uint64_t start_seq, uint64_t stop_seq, BroFile
 
 void TCP_Reassembler::RecordBlock(const DataBlock& b, BroFile* f)
 	{
-	if ( f->Write((const char*) b.block, b.Size()) )
+	RecordData(b.block, b.Size(), f);
+	}
+
+void TCP_Reassembler::RecordData(const u_char* data, uint64_t len, BroFile* f)
+	{
+	if ( f->Write((const char*) data, len) )
 		return;
 
 	reporter->Error("TCP_Reassembler contents write failed");
@@ -417,6 +432,49 @@ void TCP_Reassembler::BlockInserted(DataBlockMap::const_iterator it)
 		++it;
 		}
 
+	TrimDelivered();
+
+	// Note: don't make an EOF check here, because then we'd miss it
+	// for FIN packets that don't carry any payload (and thus
+	// endpoint->DataSent is not called).  Instead, do the check in
+	// TCP_Connection::NextPacket.
+	}
+
+bool TCP_Reassembler::DeliverDirect(uint64_t seq, uint64_t len, const u_char* data)
+	{
+	uint64_t upper_seq = seq + len;
+
+	// Only data continuing right where we are, with nothing buffered
+	// that it could fill a hole for or that it must be checked against.
+	if ( seq > last_reassem_seq || upper_seq <= last_reassem_seq ||
+	     trim_seq > last_reassem_seq || ! block_list.Empty() )
+		return false;
+
+	// Detecting inconsistent retransmissions needs the delivered data
+	// held until it's acked.
+	if ( rexmit_inconsistency )
+		return false;
+
+	// Skip what we've delivered before.
+	uint64_t amount_old = last_reassem_seq - seq;
+	data += amount_old;
+	seq += amount_old;
+	len -= amount_old;
+
+	last_reassem_seq += len;
+	direct_seq = last_reassem_seq;
+	zero_copy_bytes += len;
+
+	if ( record_contents_file )
+		RecordData(data, len, record_contents_file);
+
+	DeliverBlock(seq, len, data);
+	TrimDelivered();
+	return true;
+	}
+
+void TCP_Reassembler::TrimDelivered()
+	{
 	TCP_Endpoint* e = endp;
 
 	if ( ! e->peer->HasContents() )
@@ -433,11 +491,6 @@ void TCP_Reassembler::BlockInserted(DataBlockMap::const_iterator it)
 		// don't hang onto the data further, as we may wind up
 		// carrying it all the way until this connection ends.
 		TrimToSeq(last_reassem_seq);
-
-	// Note: don't make an EOF check here, because then we'd miss it
-	// for FIN packets that don't carry any payload (and thus
-	// endpoint->DataSent is not called).  Instead, do the check in
-	// TCP_Connection::NextPacket.
 	}
 
 void TCP_Reassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n)
@@ -503,26 +556,60 @@ bool TCP_Reassembler::DataSent(double t, uint64_t seq, int len,
 		len -= amount_acked;
 		}
 
-	flags = arg_flags;
-	NewBlock(t, seq, len, data);
-	flags = TCP_Flags();
+	if ( seq < direct_seq && direct_seq > trim_seq )
+		{
+		// Part of this went out straight from a packet before, so
+		// there's no block for it. Buffering it now would only
+		// leave a block behind what's been delivered.
+		uint64_t amount_direct = std::min(upper_seq, direct_seq) - seq;
+
+		if ( rexmit_inconsistency )
+			{
+			CheckOverlap(old_block_list, seq, amount_direct, data);
+			CheckOverlap(block_list, seq, amount_direct, data);
+			}
+
+		if ( upper_seq <= direct_seq )
+			return false;
+
+		seq += amount_direct;
+		data += amount_direct;
+		len -= amount_direct;
+		}
+
+	if ( ! DeliverDirect(seq, len, data) )
+		{
+		copied_bytes += len;
+
+		flags = arg_flags;
+		NewBlock(t, seq, len, data);
+		flags = TCP_Flags();
+		}
 
 	if ( Endpoint()->NoDataAcked() && tcp_max_above_hole_without_any_acks &&
 	     NumUndeliveredBytes() > static_cast<uint64_t>(tcp_max_above_hole_without_any_acks) )
 		{
 		tcp_analyzer->Weird("above_hole_data_without_any_acks");
 		ClearBlocks();
+		direct_seq = 0;
 		skip_deliveries = true;
 		}
 
+	// Data delivered directly used to sit in a block until acked as well,
+	// so it counts toward the limit until then.
+	uint64_t unacked_direct = direct_seq > trim_seq ? direct_seq - trim_seq : 0;
+
 	if ( tcp_excessive_data_without_further_acks &&
-	     block_list.DataSize() > static_cast<uint64_t>(tcp_excessive_data_without_further_acks) )
+	     block_list.DataSize() + unacked_direct >
+	     static_cast<uint64_t>(tcp_excessive_data_without_further_acks) )
 		{
 		tcp_analyzer->Weird("excessive_data_without_further_acks");
 		ClearBlocks();
+		direct_seq = 0;
 		skip_deliveries = true;
 		}
 
+	UpdateBuffered();
 	return true;
 	}
 
@@ -542,6 +629,7 @@ void TCP_Reassembler::AckReceived(uint64_t seq)
 				endp->peer->state == TCP_ENDPOINT_ESTABLISHED ) );
 
 	uint64_t num_missing = TrimToSeq(seq);
+	UpdateBuffered();
 
 	if ( test_active )
 		{
@@ -560,6 +648,33 @@ void TCP_Reassembler::AckReceived(uint64_t seq)
 	CheckEOF();
 	}
 
+Connection* TCP_Reassembler::BufferConn() const
+	{
+	return tcp_analyzer->Conn();
+	}
+
+void TCP_Reassembler::EvictBuffers()
+	{
+	if ( ! block_list.Empty() )
+		TrimToSeq(block_list.LastBlock().upper);
+
+	ClearOldBlocks();
+	UpdateBuffered();
+
+	// We may have delivered everything now.
+	CheckEOF();
+	}
+
+void TCP_Reassembler::UpdateBuffered()
+	{
+	if ( NumUndeliveredBytes() == 0 )
+		hole_time = 0;
+	else if ( hole_time == 0 )
+		hole_time = network_time;
+
+	SetBuffered(TotalSize());
+	}
+
 void TCP_Reassembler::CheckEOF()
 	{
 	// It is important that the check on whether we have pending data here
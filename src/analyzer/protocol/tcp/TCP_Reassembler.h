@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Reassem.h"
+#include "BufferBudget.h"
 #include "TCP_Endpoint.h"
 #include "TCP_Flags.h"
 
@@ -15,7 +16,7 @@ namespace tcp {
 
 class TCP_Analyzer;
 
-class TCP_Reassembler final : public Reassembler {
+class TCP_Reassembler final : public Reassembler, public BufferHolder {
 public:
 	enum Type {
 		Direct,		// deliver to destination analyzer itself
@@ -69,7 +70,10 @@ public:
 	// when so.
 	void CheckEOF();
 
-	bool HasUndeliveredData() const	{ return HasBlocks(); }
+	// Includes data delivered straight from packets that hasn't been
+	// acked yet, just like delivered blocks still being held.
+	bool HasUndeliveredData() const
+		{ return HasBlocks() || direct_seq > trim_seq; }
 	bool HadGap() const	{ return had_gap; }
 	bool DataPending() const;
 	uint64_t DataSeq() const		{ return LastReassemSeq(); }
@@ -85,14 +89,42 @@ public:
 	bool IsSkippedContents(uint64_t seq, int length) const
 		{ return seq + length <= seq_to_skip; }
 
+	// Payload bytes delivered straight from packets, and ones copied
+	// into blocks first, summed over all TCP reassemblers.
+	static uint64_t ZeroCopyBytes()	{ return zero_copy_bytes; }
+	static uint64_t CopiedBytes()	{ return copied_bytes; }
+
+	// While there's a hole, returns since when it has been there.
+	double BufferedSince() const override
+		{ return hole_time ? hole_time : BufferHolder::BufferedSince(); }
+
+protected:
+	Connection* BufferConn() const override;
+
+	// Skips any holes, delivering what's above them, and drops all
+	// data held.
+	void EvictBuffers() override;
+
 private:
-	TCP_Reassembler()	{ }
+	TCP_Reassembler() : BufferHolder(BUFFER_REASSEMBLY)	{ }
 
 	void Undelivered(uint64_t up_to_seq) override;
 	void Gap(uint64_t seq, uint64_t len);
 
+	// Delivers in-order data without copying it into a block first,
+	// if that's possible. Returns false if it has to go through
+	// NewBlock() instead.
+	bool DeliverDirect(uint64_t seq, uint64_t len, const u_char* data);
+
+	// Drops delivered data early if we don't expect acks for it.
+	void TrimDelivered();
+
+	// Reports the data held to the buffer budget.
+	void UpdateBuffered();
+
 	void RecordToSeq(uint64_t start_seq, uint64_t stop_seq, BroFile* f);
 	void RecordBlock(const DataBlock& b, BroFile* f);
+	void RecordData(const u_char* data, uint64_t len, BroFile* f);
 	void RecordGap(uint64_t start_seq, uint64_t upper_seq, BroFile* f);
 
 	void BlockInserted(DataBlockMap::const_iterator it) override;
@@ -106,6 +138,8 @@ private:
 	bool skip_deliveries;
 
 	uint64_t seq_to_skip;
+	uint64_t direct_seq;	// upper end of data delivered without a block
+	double hole_time;	// when the current hole appeared, or 0 if none
 
 	bool in_delivery;
 	analyzer::tcp::TCP_Flags flags;
@@ -116,6 +150,9 @@ private:
 	TCP_Analyzer* tcp_analyzer;
 
 	Type type;
+
+	static uint64_t zero_copy_bytes;
+	static uint64_t copied_bytes;
 };
 
 } } // namespace analyzer::*
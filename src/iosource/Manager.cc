@@ -166,8 +166,10 @@ void Manager::FindReadySources(std::vector<IOSource*>* ready)
 					}
 				else
 					{
-					if ( ! pseudo_realtime )
-						// A pcap file is always ready to process unless it's suspended
+					if ( ! pseudo_realtime && next <= 0 )
+						// A pcap file is always ready to process unless it's suspended,
+						// or the source asks for a timeout while waiting for a file
+						// to grow.
 						ready->push_back(pkt_src);
 					}
 				}
@@ -4,11 +4,13 @@
 #include "PktSrc.h"
 
 #include <sys/stat.h>
+#include <signal.h>
 
 #include "util.h"
 #include "Hash.h"
 #include "Net.h"
 #include "Sessions.h"
+#include "Var.h"
 #include "broker/Manager.h"
 #include "iosource/Manager.h"
 #include "BPF_Program.h"
@@ -193,28 +195,44 @@ void PktSrc::Done()
 
 void PktSrc::Process()
 	{
-	if ( ! IsOpen() )
-		return;
+	// Process up to a batch of packets at a time, so that the main loop
+	// doesn't need to go through its source selection for every single
+	// one.  In pseudo-realtime mode, each packet has its own time to be
+	// processed, so there we stick with one.
+	bro_uint_t batch_size = pseudo_realtime ? 1 : BifConst::Pcap::packet_batch_size;
 
-	if ( ! ExtractNextPacketInternal() )
-		return;
+	if ( batch_size == 0 )
+		batch_size = 1;
 
-	if ( current_packet.Layer2Valid() )
+	for ( bro_uint_t i = 0; i < batch_size; ++i )
 		{
-		if ( pseudo_realtime )
+		if ( ! IsOpen() )
+			return;
+
+		if ( ! ExtractNextPacketInternal() )
+			return;
+
+		if ( current_packet.Layer2Valid() )
 			{
-			current_pseudo = CheckPseudoTime();
-			net_packet_dispatch(current_pseudo, &current_packet, this);
-			if ( ! first_wallclock )
-				first_wallclock = current_time(true);
+			if ( pseudo_realtime )
+				{
+				current_pseudo = CheckPseudoTime();
+				net_packet_dispatch(current_pseudo, &current_packet, this);
+				if ( ! first_wallclock )
+					first_wallclock = current_time(true);
+				}
+
+			else
+				net_packet_dispatch(current_packet.time, &current_packet, this);
 			}
 
-		else
-			net_packet_dispatch(current_packet.time, &current_packet, this);
-		}
+		have_packet = false;
+		DoneWithPacket();
 
-	have_packet = false;
-	DoneWithPacket();
+		// Leave it to the main loop to act on these.
+		if ( terminating || signal_val == SIGTERM || signal_val == SIGINT )
+			return;
+		}
 	}
 
 const char* PktSrc::Tag()
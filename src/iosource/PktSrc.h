@@ -6,10 +6,12 @@
 
 #include "IOSource.h"
 #include "Packet.h"
+#include "net_util.h"
 
 #include <sys/types.h> // for u_char
 
 struct pcap_pkthdr;
+struct ConnID;
 class BPF_Program;
 
 namespace iosource {
@@ -207,6 +209,24 @@ public:
 	 */
 	virtual void Statistics(Stats* stats) = 0;
 
+	/**
+	 * Asks the source to stop delivering the packets of a flow, for
+	 * sources that can drop them before they reach Zeek, such as in
+	 * capture hardware or a kernel filter. Called when a connection's
+	 * packets start bypassing analysis; see NetSessions::Bypass().
+	 *
+	 * Derived classes may override this; the default does nothing.
+	 *
+	 * @param id The flow, with the ports in network byte order. Packets
+	 * in either direction belong to it.
+	 *
+	 * @param proto The flow's transport protocol.
+	 *
+	 * @return True if the source will drop the flow's packets.
+	 */
+	virtual bool BypassFlow(const ConnID& id, TransportProto proto)
+		{ return false; }
+
 	/**
 	 * Return the next timeout value for this source. This should be
 	 * overridden by source classes where they have a timeout value
@@ -0,0 +1,24 @@
+// See the file  in the main distribution directory for copyright.
+
+#include "Source.h"
+#include "plugin/Plugin.h"
+#include "iosource/Component.h"
+
+namespace plugin {
+namespace Zeek_MmapPcap {
+
+class Plugin : public plugin::Plugin {
+public:
+	plugin::Configuration Configure() override
+		{
+		AddComponent(new ::iosource::PktSrcComponent("MmapPcapReader", "mmap", ::iosource::PktSrcComponent::TRACE, ::iosource::mmap_pcap::MmapSource::Instantiate));
+
+		plugin::Configuration config;
+		config.name = "Zeek::MmapPcap";
+		config.description = "Memory-mapped reading of pcap and pcapng trace files";
+		return config;
+		}
+} plugin;
+
+}
+}
@@ -0,0 +1,639 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "Source.h"
+#include "iosource/Packet.h"
+#include "iosource/BPF_Program.h"
+
+#include "Event.h"
+#include "Net.h"
+
+#include "mmap.bif.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace iosource::mmap_pcap;
+
+// Magic numbers of classic pcap files, in our byte order.
+static const uint32_t PCAP_MAGIC_USEC = 0xa1b2c3d4;
+static const uint32_t PCAP_MAGIC_NSEC = 0xa1b23c4d;
+
+// pcapng block types.
+static const uint32_t PCAPNG_SECTION_HEADER = 0x0a0d0d0a;
+static const uint32_t PCAPNG_INTERFACE_DESCRIPTION = 0x00000001;
+static const uint32_t PCAPNG_PACKET = 0x00000002;	// obsolete
+static const uint32_t PCAPNG_SIMPLE_PACKET = 0x00000003;
+static const uint32_t PCAPNG_ENHANCED_PACKET = 0x00000006;
+static const uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+static const uint16_t PCAPNG_OPT_ENDOFOPT = 0;
+static const uint16_t PCAPNG_OPT_IF_TSRESOL = 9;
+
+// How much consumed data to accumulate before handing the pages back.
+static const size_t RELEASE_CHUNK = 64 * 1024 * 1024;
+
+// How often to check whether a followed trace has grown, in seconds.
+static const double FOLLOW_CHECK_INTERVAL = 0.01;
+
+// Trace files store LINKTYPE_* values, which are mostly, but not
+// entirely, identical to the DLT_* values used at run-time.
+static int linktype_to_dlt(uint32_t linktype)
+	{
+	// The upper bits may carry FCS information.
+	linktype &= 0x03ffffff;
+
+	switch ( linktype ) {
+	case 101:
+		return DLT_RAW;
+
+	case 108:
+		return DLT_LOOP;
+
+	default:
+		return linktype;
+	}
+	}
+
+static inline uint32_t swap32(uint32_t x)
+	{
+	return __builtin_bswap32(x);
+	}
+
+static inline uint16_t swap16(uint16_t x)
+	{
+	return __builtin_bswap16(x);
+	}
+
+MmapSource::~MmapSource()
+	{
+	Close();
+	}
+
+MmapSource::MmapSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	fd = -1;
+	base = nullptr;
+	mapped = offset = released = 0;
+	pcapng = swapped = false;
+	ts_units = 1000000;
+	filter_index = -1;
+	last_growth = last_check = 0;
+	waiting = false;
+	memset(&current_hdr, 0, sizeof(current_hdr));
+	}
+
+void MmapSource::Open()
+	{
+	fd = ::open(props.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if ( fd < 0 )
+		{
+		Error(fmt("%s: %s", props.path.c_str(), strerror(errno)));
+		return;
+		}
+
+	Map();
+
+	if ( ! ParseHeader() )
+		{
+		Unmap();
+		::close(fd);
+		fd = -1;
+		return;
+		}
+
+	last_growth = current_time(true);
+
+	props.selectable_fd = fd;
+	props.is_live = false;
+
+	Opened(props);
+	}
+
+void MmapSource::Close()
+	{
+	if ( fd < 0 )
+		return;
+
+	Unmap();
+	::close(fd);
+	fd = -1;
+
+	Closed();
+
+	if ( Pcap::file_done )
+		mgr.Enqueue(Pcap::file_done, make_intrusive<StringVal>(props.path));
+	}
+
+bool MmapSource::Map()
+	{
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || size_t(st.st_size) <= mapped )
+		return false;
+
+	// Map the whole file again at its new size.  We don't touch the
+	// part we've released to the kernel again, so it doesn't get paged
+	// back in; "released" and "offset" remain valid as they are.
+	Unmap();
+
+	size_t size = st.st_size;
+	void* m = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if ( m == MAP_FAILED )
+		{
+		Error(fmt("mmap %s: %s", props.path.c_str(), strerror(errno)));
+		return false;
+		}
+
+	base = static_cast<const u_char*>(m);
+	mapped = size;
+
+	// We read the file front to back, so let the kernel read ahead
+	// aggressively.
+	madvise(m, size, MADV_SEQUENTIAL);
+
+	return true;
+	}
+
+void MmapSource::Unmap()
+	{
+	if ( base )
+		munmap(const_cast<u_char*>(base), mapped);
+
+	base = nullptr;
+	mapped = 0;
+	}
+
+void MmapSource::ReleaseConsumed()
+	{
+	if ( offset - released < RELEASE_CHUNK )
+		return;
+
+	// Stay a page short of where we are, the current packet may
+	// still be in use.
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t end = (offset / page) * page;
+
+	if ( end <= released + page )
+		return;
+
+	end -= page;
+	madvise(const_cast<u_char*>(base) + released, end - released, MADV_DONTNEED);
+	released = end;
+	}
+
+uint16_t MmapSource::Get16(const u_char* p) const
+	{
+	uint16_t x;
+	memcpy(&x, p, sizeof(x));
+	return swapped ? swap16(x) : x;
+	}
+
+uint32_t MmapSource::Get32(const u_char* p) const
+	{
+	uint32_t x;
+	memcpy(&x, p, sizeof(x));
+	return swapped ? swap32(x) : x;
+	}
+
+bool MmapSource::ParseHeader()
+	{
+	if ( mapped < 24 )
+		{
+		Error(fmt("%s: truncated trace file header", props.path.c_str()));
+		return false;
+		}
+
+	uint32_t magic;
+	memcpy(&magic, base, sizeof(magic));
+
+	if ( magic == PCAPNG_SECTION_HEADER )
+		{
+		pcapng = true;
+
+		// The section header tells us the byte order; the rest
+		// of the parsing happens along with the packets.
+		uint32_t bom;
+		memcpy(&bom, base + 8, sizeof(bom));
+
+		if ( bom != PCAPNG_BYTE_ORDER_MAGIC && swap32(bom) != PCAPNG_BYTE_ORDER_MAGIC )
+			{
+			Error(fmt("%s: bad pcapng byte order magic", props.path.c_str()));
+			return false;
+			}
+
+		swapped = (bom != PCAPNG_BYTE_ORDER_MAGIC);
+
+		// We need the first interface's link type for opening.
+		// Parse the leading blocks without consuming any packets.
+		while ( interfaces.empty() )
+			{
+			if ( offset + 12 > mapped )
+				{
+				Error(fmt("%s: no interface description in pcapng file", props.path.c_str()));
+				return false;
+				}
+
+			uint32_t type = Get32(base + offset);
+			uint32_t len = BlockLength(base + offset);
+
+			if ( len < 12 || len % 4 || offset + len > mapped )
+				{
+				Error(fmt("%s: bad pcapng block", props.path.c_str()));
+				return false;
+				}
+
+			if ( type == PCAPNG_SECTION_HEADER )
+				{
+				if ( ! ParseSectionHeader(base + offset, len) )
+					return false;
+				}
+
+			else if ( type == PCAPNG_INTERFACE_DESCRIPTION )
+				{
+				if ( ! ParseInterfaceDescription(base + offset, len) )
+					return false;
+				}
+
+			else if ( type == PCAPNG_PACKET || type == PCAPNG_SIMPLE_PACKET ||
+				  type == PCAPNG_ENHANCED_PACKET )
+				{
+				Error(fmt("%s: pcapng packet before interface description", props.path.c_str()));
+				return false;
+				}
+
+			offset += len;
+			}
+
+		props.link_type = interfaces[0].link_type;
+		return true;
+		}
+
+	if ( magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC )
+		swapped = false;
+
+	else if ( swap32(magic) == PCAP_MAGIC_USEC || swap32(magic) == PCAP_MAGIC_NSEC )
+		{
+		swapped = true;
+		magic = swap32(magic);
+		}
+
+	else
+		{
+		Error(fmt("%s: unknown trace file format", props.path.c_str()));
+		return false;
+		}
+
+	ts_units = (magic == PCAP_MAGIC_NSEC ? 1000000000 : 1000000);
+	props.link_type = linktype_to_dlt(Get32(base + 20));
+	offset = 24;
+
+	return true;
+	}
+
+uint32_t MmapSource::BlockLength(const u_char* block) const
+	{
+	uint32_t type;
+	uint32_t len;
+	memcpy(&type, block, sizeof(type));
+	memcpy(&len, block + 4, sizeof(len));
+
+	if ( type == PCAPNG_SECTION_HEADER )
+		{
+		// This one's length is in the new section's byte order,
+		// which may differ from the previous one's.
+		uint32_t bom;
+		memcpy(&bom, block + 8, sizeof(bom));
+		return bom == PCAPNG_BYTE_ORDER_MAGIC ? len : swap32(len);
+		}
+
+	return swapped ? swap32(len) : len;
+	}
+
+bool MmapSource::ParseSectionHeader(const u_char* block, uint32_t len)
+	{
+	if ( len < 28 )
+		{
+		Error(fmt("%s: bad pcapng section header", props.path.c_str()));
+		return false;
+		}
+
+	uint32_t bom;
+	memcpy(&bom, block + 8, sizeof(bom));
+
+	if ( bom != PCAPNG_BYTE_ORDER_MAGIC && swap32(bom) != PCAPNG_BYTE_ORDER_MAGIC )
+		{
+		Error(fmt("%s: bad pcapng byte order magic", props.path.c_str()));
+		return false;
+		}
+
+	// A new section starts over with its own byte order and interfaces.
+	swapped = (bom != PCAPNG_BYTE_ORDER_MAGIC);
+	interfaces.clear();
+
+	return true;
+	}
+
+bool MmapSource::ParseInterfaceDescription(const u_char* block, uint32_t len)
+	{
+	if ( len < 20 )
+		{
+		Error(fmt("%s: bad pcapng interface description", props.path.c_str()));
+		return false;
+		}
+
+	Interface iface;
+	iface.link_type = linktype_to_dlt(Get16(block + 8));
+	iface.ts_units = 1000000;
+
+	// Look for the timestamp resolution among the options.
+	const u_char* opt = block + 16;
+	const u_char* end = block + len - 4;
+
+	while ( opt + 4 <= end )
+		{
+		uint16_t code = Get16(opt);
+		uint16_t opt_len = Get16(opt + 2);
+
+		if ( code == PCAPNG_OPT_ENDOFOPT || opt + 4 + opt_len > end )
+			break;
+
+		if ( code == PCAPNG_OPT_IF_TSRESOL && opt_len == 1 )
+			{
+			uint8_t resol = opt[4];
+			uint8_t exp = resol & 0x7f;
+
+			if ( (resol & 0x80) ? exp > 63 : exp > 19 )
+				{
+				Error(fmt("%s: unsupported pcapng timestamp resolution", props.path.c_str()));
+				return false;
+				}
+
+			uint64_t units = 1;
+
+			for ( int i = 0; i < exp; ++i )
+				units *= (resol & 0x80) ? 2 : 10;
+
+			iface.ts_units = units;
+			}
+
+		opt += 4 + ((opt_len + 3) & ~3);
+		}
+
+	interfaces.push_back(iface);
+	return true;
+	}
+
+void MmapSource::SetPacket(Packet* pkt, int link_type, uint64_t ts, uint64_t units,
+                           uint32_t caplen, uint32_t len, const u_char* data)
+	{
+	current_hdr.ts.tv_sec = ts / units;
+	uint64_t frac = ts % units;
+
+	if ( units == 1000000 )
+		current_hdr.ts.tv_usec = frac;
+	else
+		current_hdr.ts.tv_usec = double(frac) * 1000000 / units;
+
+	current_hdr.caplen = caplen;
+	current_hdr.len = len;
+
+	pkt->Init(link_type, &current_hdr.ts, caplen, len, data);
+	}
+
+int MmapSource::NextPcapRecord(Packet* pkt)
+	{
+	if ( offset + 16 > mapped )
+		return 0;
+
+	const u_char* rec = base + offset;
+	uint32_t sec = Get32(rec);
+	uint32_t frac = Get32(rec + 4);
+	uint32_t caplen = Get32(rec + 8);
+	uint32_t len = Get32(rec + 12);
+
+	if ( caplen > 0x10000000 )
+		{
+		Error(fmt("%s: bogus packet length %" PRIu32, props.path.c_str(), caplen));
+		return -1;
+		}
+
+	if ( offset + 16 + caplen > mapped )
+		return 0;
+
+	SetPacket(pkt, props.link_type, uint64_t(sec) * ts_units + frac, ts_units,
+	          caplen, len, rec + 16);
+	offset += 16 + caplen;
+
+	return 1;
+	}
+
+int MmapSource::NextPcapngBlock(Packet* pkt)
+	{
+	for ( ; ; )
+		{
+		if ( offset + 12 > mapped )
+			return 0;
+
+		const u_char* block = base + offset;
+		uint32_t type = Get32(block);
+		uint32_t len = BlockLength(block);
+
+		if ( len < 12 || len % 4 )
+			{
+			Error(fmt("%s: bad pcapng block", props.path.c_str()));
+			return -1;
+			}
+
+		if ( offset + len > mapped )
+			return 0;
+
+		offset += len;
+
+		switch ( type ) {
+		case PCAPNG_SECTION_HEADER:
+			if ( ! ParseSectionHeader(block, len) )
+				return -1;
+
+			continue;
+
+		case PCAPNG_INTERFACE_DESCRIPTION:
+			if ( ! ParseInterfaceDescription(block, len) )
+				return -1;
+
+			continue;
+
+		case PCAPNG_ENHANCED_PACKET:
+		case PCAPNG_PACKET:
+			{
+			if ( len < 32 )
+				break;
+
+			uint32_t id = (type == PCAPNG_PACKET) ? Get16(block + 8) : Get32(block + 8);
+			uint64_t ts = (uint64_t(Get32(block + 12)) << 32) | Get32(block + 16);
+			uint32_t caplen = Get32(block + 20);
+			uint32_t plen = Get32(block + 24);
+
+			if ( id >= interfaces.size() || caplen > len - 32 )
+				break;
+
+			const Interface& iface = interfaces[id];
+			SetPacket(pkt, iface.link_type, ts, iface.ts_units, caplen, plen, block + 28);
+			return 1;
+			}
+
+		case PCAPNG_SIMPLE_PACKET:
+			{
+			if ( len < 16 || interfaces.empty() )
+				break;
+
+			// No timestamp; Zeek needs one, so the packet gets the
+			// previous packet's.
+			uint32_t plen = Get32(block + 8);
+			uint32_t caplen = std::min(plen, len - 16);
+			uint64_t ts = uint64_t(current_hdr.ts.tv_sec) * 1000000 + current_hdr.ts.tv_usec;
+			SetPacket(pkt, interfaces[0].link_type, ts, 1000000, caplen, plen, block + 12);
+			return 1;
+			}
+
+		default:
+			// Some other block we don't care about.
+			continue;
+		}
+
+		Error(fmt("%s: malformed pcapng packet block", props.path.c_str()));
+		return -1;
+		}
+	}
+
+bool MmapSource::CheckForMore()
+	{
+	double follow = BifConst::MmapPcap::follow_timeout;
+	double now = current_time(true);
+
+	// While following, the main loop keeps coming back to us; don't
+	// stat the file every time.
+	if ( follow > 0 && now - last_check < FOLLOW_CHECK_INTERVAL )
+		return true;
+
+	last_check = now;
+
+	if ( Map() )
+		{
+		last_growth = now;
+		return true;
+		}
+
+	return follow > 0 && now - last_growth <= follow;
+	}
+
+bool MmapSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( fd < 0 )
+		return false;
+
+	for ( ; ; )
+		{
+		int rc = pcapng ? NextPcapngBlock(pkt) : NextPcapRecord(pkt);
+
+		if ( rc < 0 )
+			{
+			Close();
+			return false;
+			}
+
+		if ( rc == 0 )
+			{
+			// Out of data. If the file is still growing, we'll
+			// get to the rest on one of the main loop's next
+			// rounds; we never block it here.
+			size_t old_mapped = mapped;
+
+			if ( ! CheckForMore() )
+				{
+				if ( offset < mapped )
+					Weird("truncated_trace_file", nullptr);
+
+				Close();
+				return false;
+				}
+
+			if ( mapped > old_mapped )
+				continue;
+
+			waiting = true;
+			return false;
+			}
+
+		waiting = false;
+
+		if ( current_hdr.len == 0 || current_hdr.caplen == 0 )
+			{
+			Weird("empty_pcap_header", pkt);
+			return false;
+			}
+
+		if ( filter_index >= 0 && ! ApplyBPFFilter(filter_index, &current_hdr, pkt->data) )
+			continue;
+
+		++stats.received;
+		stats.bytes_received += current_hdr.len;
+
+		return true;
+		}
+	}
+
+double MmapSource::GetNextTimeout()
+	{
+	// At the end of a trace we're following, there's nothing to do
+	// until it's time to check for growth again.  The file is always
+	// readable, so the main loop would spin otherwise.
+	if ( ! waiting || net_is_processing_suspended() )
+		return PktSrc::GetNextTimeout();
+
+	return std::max(0.0, last_check + FOLLOW_CHECK_INTERVAL - current_time(true));
+	}
+
+void MmapSource::DoneWithPacket()
+	{
+	ReleaseConsumed();
+	}
+
+bool MmapSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	return PktSrc::PrecompileBPFFilter(index, filter);
+	}
+
+bool MmapSource::SetFilter(int index)
+	{
+	if ( ! GetBPFFilter(index) )
+		{
+		Error(fmt("No precompiled pcap filter for index %d", index));
+		return false;
+		}
+
+	filter_index = index;
+	return true;
+	}
+
+void MmapSource::Statistics(Stats* s)
+	{
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->dropped = s->link = 0;
+	}
+
+iosource::PktSrc* MmapSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new MmapSource(path, is_live);
+	}
@@ -0,0 +1,113 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include "../PktSrc.h"
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include <vector>
+
+#include <sys/types.h> // for u_char
+
+namespace iosource {
+namespace mmap_pcap {
+
+/**
+ * A packet source reading pcap and pcapng trace files through a memory
+ * mapping. Packets handed out point directly into the mapping, so the
+ * only copying left is the kernel paging the file in.
+ *
+ * With MmapPcap::follow_timeout set, the source keeps waiting for more
+ * packets at the end of the file, so that it can process traces that are
+ * still being written.
+ */
+class MmapSource : public iosource::PktSrc {
+public:
+	MmapSource(const std::string& path, bool is_live);
+	~MmapSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+	// IOSource interface.
+	double GetNextTimeout() override;
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	// Per-interface state for pcapng.
+	struct Interface {
+		int link_type;
+		// Timestamp units per second.
+		uint64_t ts_units;
+	};
+
+	// (Re-)maps the file to cover its current size. Returns true if
+	// the mapping grew.
+	bool Map();
+	void Unmap();
+
+	// Parses the file header; returns false on error.
+	bool ParseHeader();
+
+	// Attempts to parse the next packet at the current offset. Returns
+	// 1 on success, 0 if more data is needed, and -1 on error. Blocks that
+	// don't carry packets are skipped.
+	int NextPcapRecord(Packet* pkt);
+	int NextPcapngBlock(Packet* pkt);
+
+	// Parses a pcapng section or interface description block.
+	bool ParseSectionHeader(const u_char* block, uint32_t len);
+
+	// Returns the total length of the pcapng block.
+	uint32_t BlockLength(const u_char* block) const;
+	bool ParseInterfaceDescription(const u_char* block, uint32_t len);
+
+	// Checks whether the file has grown, if we're following it.
+	// Returns false if we've reached its end for good. Never blocks.
+	bool CheckForMore();
+
+	// Releases mapped pages we're done with.
+	void ReleaseConsumed();
+
+	uint16_t Get16(const u_char* p) const;
+	uint32_t Get32(const u_char* p) const;
+
+	// Stores the current packet's headers and initializes the packet.
+	void SetPacket(Packet* pkt, int link_type, uint64_t ts, uint64_t units,
+	               uint32_t caplen, uint32_t len, const u_char* data);
+
+	Properties props;
+	Stats stats;
+
+	int fd;
+	const u_char* base;	// Start of the mapping.
+	size_t mapped;	// Size of the mapping.
+	size_t offset;	// Where the next record starts.
+	size_t released;	// Bytes at the start we've given back already.
+
+	bool pcapng;
+	bool swapped;	// Byte order differs from ours.
+	uint64_t ts_units;	// Classic pcap: timestamp units per second.
+	std::vector<Interface> interfaces;	// pcapng
+
+	int filter_index;
+	double last_growth;	// Wall-clock time the file last grew.
+	double last_check;	// Wall-clock time we last checked for growth.
+	bool waiting;	// At the end of a followed file, for more data.
+
+	struct pcap_pkthdr current_hdr;
+};
+
+}
+}
@@ -0,0 +1,239 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ColumnBatch.h"
+
+#include <algorithm>
+
+#include "IPAddr.h"
+#include "Reporter.h"
+
+#include "3rdparty/doctest.h"
+
+using threading::Value;
+using threading::Field;
+
+using namespace logging;
+
+ColumnBatch::ColumnBatch(int num_fields, const Field* const* fields, int arg_capacity)
+	: columns(num_fields)
+	{
+	num_entries = 0;
+	capacity = arg_capacity;
+
+	for ( int i = 0; i < num_fields; ++i )
+		columns[i].type = fields[i]->type;
+
+	Reserve(std::min(capacity, INITIAL_ENTRIES));
+	}
+
+ColumnBatch::~ColumnBatch()
+	{
+	for ( auto& c : columns )
+		{
+		if ( c.type != TYPE_TABLE && c.type != TYPE_VECTOR )
+			continue;
+
+		for ( int j = 0; j < num_entries; ++j )
+			delete c.cells[j].boxed;
+		}
+	}
+
+void ColumnBatch::Reserve(int n)
+	{
+	// New cells start out zeroed, so sets and vectors not set are nil.
+	for ( auto& c : columns )
+		{
+		c.cells.resize(n);
+		c.nulls.resize((n + 63) / 64);
+		}
+	}
+
+void ColumnBatch::FinishEntry()
+	{
+	++num_entries;
+
+	if ( num_entries < capacity && ! columns.empty() &&
+	     num_entries == int(columns[0].cells.size()) )
+		Reserve(std::min(capacity, 2 * num_entries));
+	}
+
+void ColumnBatch::SetNull(int field)
+	{
+	columns[field].nulls[num_entries / 64] |= uint64_t(1) << (num_entries % 64);
+	}
+
+void ColumnBatch::SetPort(int field, bro_uint_t port, TransportProto proto)
+	{
+	Cell& c = Next(field);
+	c.port_val.port = port;
+	c.port_val.proto = proto;
+	}
+
+void ColumnBatch::SetAddr(int field, const IPAddr& a)
+	{
+	a.ConvertToThreadingValue(&Next(field).addr_val);
+	}
+
+void ColumnBatch::SetSubNet(int field, const IPPrefix& p)
+	{
+	p.ConvertToThreadingValue(&Next(field).subnet_val);
+	}
+
+void ColumnBatch::SetString(int field, const char* data, int len)
+	{
+	Cell& c = Next(field);
+	c.string_val.offset = arena.size();
+	c.string_val.length = len;
+	arena.append(data, len);
+	}
+
+const char* ColumnBatch::String(int entry, int field, int* len) const
+	{
+	const Cell& c = columns[field].cells[entry];
+	*len = c.string_val.length;
+	return arena.data() + c.string_val.offset;
+	}
+
+Value** ColumnBatch::TakeEntry(int entry)
+	{
+	int num_fields = columns.size();
+	Value** vals = new Value*[num_fields];
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		Column& c = columns[i];
+
+		if ( IsNull(entry, i) )
+			{
+			vals[i] = new Value(c.type, false);
+			continue;
+			}
+
+		Value* v = new Value(c.type);
+		Cell& cell = c.cells[entry];
+
+		switch ( c.type ) {
+		case TYPE_BOOL:
+		case TYPE_INT:
+			v->val.int_val = cell.int_val;
+			break;
+
+		case TYPE_COUNT:
+		case TYPE_COUNTER:
+			v->val.uint_val = cell.uint_val;
+			break;
+
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			v->val.double_val = cell.double_val;
+			break;
+
+		case TYPE_PORT:
+			v->val.port_val = cell.port_val;
+			break;
+
+		case TYPE_ADDR:
+			v->val.addr_val = cell.addr_val;
+			break;
+
+		case TYPE_SUBNET:
+			v->val.subnet_val = cell.subnet_val;
+			break;
+
+		case TYPE_ENUM:
+		case TYPE_STRING:
+		case TYPE_FILE:
+		case TYPE_FUNC:
+			{
+			int len;
+			const char* data = String(entry, i, &len);
+			char* buf = new char[len + 1];
+			memcpy(buf, data, len);
+			buf[len] = '\0';
+
+			v->val.string_val.data = buf;
+			v->val.string_val.length = len;
+			break;
+			}
+
+		case TYPE_TABLE:
+		case TYPE_VECTOR:
+			// Hand over the value itself.
+			delete v;
+			v = cell.boxed;
+			cell.boxed = nullptr;
+			break;
+
+		default:
+			reporter->InternalError("unsupported type %s in log batch", type_name(c.type));
+		}
+
+		vals[i] = v;
+		}
+
+	return vals;
+	}
+
+TEST_CASE("column batch")
+	{
+	Field f_count("c", nullptr, TYPE_COUNT, TYPE_VOID, false);
+	Field f_string("s", nullptr, TYPE_STRING, TYPE_VOID, true);
+	Field f_vector("v", nullptr, TYPE_VECTOR, TYPE_COUNT, true);
+	const Field* fields[] = { &f_count, &f_string, &f_vector };
+
+	ColumnBatch b(3, fields, 100);
+	CHECK(b.NumFields() == 3);
+	CHECK(b.Capacity() == 100);
+
+	for ( int j = 0; j < 100; ++j )
+		{
+		b.SetCount(0, j);
+
+		if ( j % 2 )
+			b.SetString(1, "odd", 3);
+		else
+			b.SetNull(1);
+
+		auto v = new Value(TYPE_VECTOR, TYPE_COUNT);
+		v->val.vector_val.size = 0;
+		v->val.vector_val.vals = new Value*[0];
+		b.SetBoxed(2, v);
+
+		b.FinishEntry();
+		}
+
+	CHECK(b.Full());
+	CHECK(b.NumEntries() == 100);
+
+	CHECK(b.Get(70, 0).uint_val == 70);
+	CHECK(b.IsNull(70, 1));
+	CHECK(! b.IsNull(71, 1));
+	CHECK(! b.IsNull(71, 0));
+
+	int len;
+	const char* s = b.String(71, 1, &len);
+	CHECK(std::string(s, len) == "odd");
+
+	Value** vals = b.TakeEntry(99);
+	CHECK(vals[0]->val.uint_val == 99);
+	CHECK(vals[1]->present);
+	CHECK(std::string(vals[1]->val.string_val.data) == "odd");
+	CHECK(vals[2]->type == TYPE_VECTOR);
+	CHECK(b.Get(99, 2).boxed == nullptr);
+
+	for ( int i = 0; i < 3; ++i )
+		delete vals[i];
+
+	delete [] vals;
+
+	vals = b.TakeEntry(0);
+	CHECK(! vals[1]->present);
+
+	for ( int i = 0; i < 3; ++i )
+		delete vals[i];
+
+	delete [] vals;
+	}
@@ -0,0 +1,151 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "threading/SerialTypes.h"
+
+class IPAddr;
+class IPPrefix;
+
+namespace logging  {
+
+/**
+ * A batch of log entries stored column by column, as the logging::Manager
+ * passes them from a WriterFrontend to its WriterBackend.
+ *
+ * Each log field gets a column of fixed-size cells, one per entry, plus a
+ * bitmap marking the entries that don't have the field set. Strings (and
+ * enums, files and functions, which get logged as strings) live in an
+ * arena shared by all columns, so that filling a batch doesn't allocate
+ * per value. Only sets and vectors keep their per-entry threading::Value.
+ *
+ * The main thread fills a batch one entry at a time: it sets each field
+ * of the entry exactly once, with the setter matching the field's type,
+ * and then calls FinishEntry(). Once the batch is full or gets flushed,
+ * ownership passes to the writer thread.
+ */
+class ColumnBatch {
+public:
+	/**
+	 * The value of a field in one entry.
+	 */
+	union Cell {
+		bro_int_t int_val;	// bool, int
+		bro_uint_t uint_val;	// count, counter
+		double double_val;	// double, time, interval
+		threading::Value::port_t port_val;
+		threading::Value::addr_t addr_val;
+		threading::Value::subnet_t subnet_val;
+
+		// String, enum, file, func: a range of the arena.
+		struct {
+			uint32_t offset;
+			uint32_t length;
+		} string_val;
+
+		threading::Value* boxed;	// set, vector
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param num_fields The number of log fields.
+	 *
+	 * @param fields The log fields, which the batch only looks at to
+	 * get their types.
+	 *
+	 * @param capacity The maximum number of entries.
+	 */
+	ColumnBatch(int num_fields, const threading::Field* const* fields, int capacity);
+
+	/**
+	 * Destructor. Deletes any sets and vectors left.
+	 */
+	~ColumnBatch();
+
+	int NumFields() const	{ return columns.size(); }
+	int NumEntries() const	{ return num_entries; }
+	int Capacity() const	{ return capacity; }
+	bool Full() const	{ return num_entries >= capacity; }
+
+	/**
+	 * Returns the type of a field's values.
+	 */
+	TypeTag Type(int field) const	{ return columns[field].type; }
+
+	// Setters for the values of the entry currently being filled.
+
+	void SetNull(int field);
+	void SetInt(int field, bro_int_t v)	{ Next(field).int_val = v; }
+	void SetCount(int field, bro_uint_t v)	{ Next(field).uint_val = v; }
+	void SetDouble(int field, double v)	{ Next(field).double_val = v; }
+	void SetPort(int field, bro_uint_t port, TransportProto proto);
+	void SetAddr(int field, const IPAddr& a);
+	void SetSubNet(int field, const IPPrefix& p);
+	void SetString(int field, const char* data, int len);
+
+	/**
+	 * Sets the value of a set or vector field. Takes ownership of \a v.
+	 */
+	void SetBoxed(int field, threading::Value* v)	{ Next(field).boxed = v; }
+
+	/**
+	 * Concludes filling the current entry.
+	 */
+	void FinishEntry();
+
+	// Accessors for the writer thread.
+
+	/**
+	 * Returns true if a field isn't set in an entry.
+	 */
+	bool IsNull(int entry, int field) const
+		{ return columns[field].nulls[entry / 64] & (uint64_t(1) << (entry % 64)); }
+
+	/**
+	 * Returns a field's value in an entry. For strings, use String()
+	 * to get at the data.
+	 */
+	const Cell& Get(int entry, int field) const
+		{ return columns[field].cells[entry]; }
+
+	/**
+	 * Returns a string field's value in an entry. The result isn't
+	 * NUL-terminated and remains valid as long as the batch does.
+	 */
+	const char* String(int entry, int field, int* len) const;
+
+	/**
+	 * Returns an entry as the array of values that WriterBackend::DoWrite()
+	 * expects. The caller takes ownership of the result, including any
+	 * sets and vectors, which the batch forgets about. Hence this may be
+	 * called only once per entry.
+	 */
+	threading::Value** TakeEntry(int entry);
+
+private:
+	struct Column {
+		TypeTag type;
+		std::vector<Cell> cells;
+		std::vector<uint64_t> nulls;	// One bit per entry.
+	};
+
+	Cell& Next(int field)	{ return columns[field].cells[num_entries]; }
+
+	// Makes room for the given number of entries.
+	void Reserve(int n);
+
+	// Entries to make room for at first. Batches often get flushed
+	// long before filling up.
+	static const int INITIAL_ENTRIES = 16;
+
+	std::vector<Column> columns;
+	std::string arena;
+	int num_entries;
+	int capacity;
+};
+
+}
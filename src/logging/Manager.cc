@@ -20,6 +20,7 @@
 #include "Desc.h"
 #include "WriterFrontend.h"
 #include "WriterBackend.h"
+#include "ColumnBatch.h"
 #include "logging.bif.h"
 #include "plugin/Plugin.h"
 #include "plugin/Manager.h"
@@ -888,27 +889,40 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 
 		// Alright, can do the write now.
 
-		threading::Value** vals = RecordToFilterVals(stream, filter, columns.get());
+		assert(writer);
 
-		if ( ! PLUGIN_HOOK_WITH_RESULT(HOOK_LOG_WRITE,
-		                               HookLogWrite(filter->writer->Type()->AsEnumType()->Lookup(filter->writer->InternalInt()),
-		                                            filter->name, *info,
-		                                            filter->num_fields,
-		                                            filter->fields, vals),
-		                               true) )
+		if ( writer->WantsBatches() &&
+		     ! plugin_mgr->HavePluginForHook(plugin::HOOK_LOG_WRITE) )
 			{
-			DeleteVals(filter->num_fields, vals);
+			// Fill in the writer's columns directly, rather than
+			// creating values for all fields.
+			RecordToBatch(stream, filter, columns.get(), writer->Batch());
+			writer->FinishBatchEntry();
+			}
+
+		else
+			{
+			threading::Value** vals = RecordToFilterVals(stream, filter, columns.get());
+
+			if ( ! PLUGIN_HOOK_WITH_RESULT(HOOK_LOG_WRITE,
+			                               HookLogWrite(filter->writer->Type()->AsEnumType()->Lookup(filter->writer->InternalInt()),
+			                                            filter->name, *info,
+			                                            filter->num_fields,
+			                                            filter->fields, vals),
+			                               true) )
+				{
+				DeleteVals(filter->num_fields, vals);
 
 #ifdef DEBUG
-			DBG_LOG(DBG_LOGGING, "Hook prevented writing to filter '%s' on stream '%s'",
-				filter->name.c_str(), stream->name.c_str());
+				DBG_LOG(DBG_LOGGING, "Hook prevented writing to filter '%s' on stream '%s'",
+					filter->name.c_str(), stream->name.c_str());
 #endif
-			return true;
-			}
+				return true;
+				}
 
-		// Write takes ownership of vals.
-		assert(writer);
-		writer->Write(filter->num_fields, vals);
+			// Write takes ownership of vals.
+			writer->Write(filter->num_fields, vals);
+			}
 
 #ifdef DEBUG
 		DBG_LOG(DBG_LOGGING, "Wrote record to filter '%s' on stream '%s'",
@@ -1052,59 +1066,164 @@ threading::Value* Manager::ValToLogVal(Val* val, BroType* ty)
 	return lval;
 	}
 
+IntrusivePtr<RecordVal> Manager::FilterExtensions(Filter* filter)
+	{
+	if ( filter->num_ext_fields == 0 )
+		return nullptr;
+
+	auto res = filter->ext_func->Call(IntrusivePtr{NewRef{}, filter->path_val});
+
+	if ( ! res )
+		return nullptr;
+
+	return {AdoptRef{}, res.release()->AsRecordVal()};
+	}
+
+Val* Manager::FilterFieldVal(Filter* filter, int field, RecordVal* columns,
+                             RecordVal* ext_rec)
+	{
+	Val* val = columns;
+
+	if ( field < filter->num_ext_fields )
+		{
+		if ( ! ext_rec )
+			// Executing function did not return record.
+			return nullptr;
+
+		val = ext_rec;
+		}
+
+	// Find the right value, which can potentially be nested inside other
+	// records.
+	for ( auto idx : filter->indices[field] )
+		{
+		val = val->AsRecordVal()->Lookup(idx);
+
+		if ( ! val )
+			// Value, or any of its parents, is not set.
+			return nullptr;
+		}
+
+	return val;
+	}
+
 threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
                                                RecordVal* columns)
 	{
-	IntrusivePtr<RecordVal> ext_rec;
+	auto ext_rec = FilterExtensions(filter);
 
-	if ( filter->num_ext_fields > 0 )
+	threading::Value** vals = new threading::Value*[filter->num_fields];
+
+	for ( int i = 0; i < filter->num_fields; ++i )
 		{
-		auto res = filter->ext_func->Call(IntrusivePtr{NewRef{}, filter->path_val});
+		Val* val = FilterFieldVal(filter, i, columns, ext_rec.get());
 
-		if ( res )
-			ext_rec = {AdoptRef{}, res.release()->AsRecordVal()};
+		if ( val )
+			vals[i] = ValToLogVal(val);
+		else
+			vals[i] = new threading::Value(filter->fields[i]->type, false);
 		}
 
-	threading::Value** vals = new threading::Value*[filter->num_fields];
+	return vals;
+	}
+
+void Manager::RecordToBatch(Stream* stream, Filter* filter, RecordVal* columns,
+                            ColumnBatch* batch)
+	{
+	auto ext_rec = FilterExtensions(filter);
 
 	for ( int i = 0; i < filter->num_fields; ++i )
 		{
-		Val* val;
-		if ( i < filter->num_ext_fields )
-			{
-			if ( ! ext_rec )
-				{
-				// executing function did not return record. Send empty for all vals.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
-				continue;
-				}
+		Val* val = FilterFieldVal(filter, i, columns, ext_rec.get());
 
-			val = ext_rec.get();
-			}
+		if ( val )
+			ValToBatch(val, batch, i);
 		else
-			val = columns;
+			batch->SetNull(i);
+		}
 
-		// For each field, first find the right value, which can
-		// potentially be nested inside other records.
-		list<int>& indices = filter->indices[i];
+	batch->FinishEntry();
+	}
 
-		for ( list<int>::iterator j = indices.begin(); j != indices.end(); ++j )
-			{
-			val = val->AsRecordVal()->Lookup(*j);
+void Manager::ValToBatch(Val* val, ColumnBatch* batch, int field)
+	{
+	// Note this mirrors ValToLogVal().
+	switch ( batch->Type(field) ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+		batch->SetInt(field, val->InternalInt());
+		break;
 
-			if ( ! val )
-				{
-				// Value, or any of its parents, is not set.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
-				break;
-				}
+	case TYPE_ENUM:
+		{
+		const char* s =
+			val->Type()->AsEnumType()->Lookup(val->InternalInt());
+
+		if ( ! s )
+			{
+			val->Type()->Error("enum type does not contain value", val);
+			s = "";
 			}
 
-		if ( val )
-			vals[i] = ValToLogVal(val);
+		batch->SetString(field, s, strlen(s));
+		break;
 		}
 
-	return vals;
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		batch->SetCount(field, val->InternalUnsigned());
+		break;
+
+	case TYPE_PORT:
+		batch->SetPort(field, val->AsPortVal()->Port(),
+		               val->AsPortVal()->PortType());
+		break;
+
+	case TYPE_SUBNET:
+		batch->SetSubNet(field, val->AsSubNet());
+		break;
+
+	case TYPE_ADDR:
+		batch->SetAddr(field, val->AsAddr());
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		batch->SetDouble(field, val->InternalDouble());
+		break;
+
+	case TYPE_STRING:
+		{
+		const BroString* s = val->AsString();
+		batch->SetString(field, (const char*) s->Bytes(), s->Len());
+		break;
+		}
+
+	case TYPE_FILE:
+		{
+		string s = val->AsFile()->Name();
+		batch->SetString(field, s.data(), s.size());
+		break;
+		}
+
+	case TYPE_FUNC:
+		{
+		ODesc d;
+		val->AsFunc()->Describe(&d);
+		const char* s = d.Description();
+		batch->SetString(field, s, strlen(s));
+		break;
+		}
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		batch->SetBoxed(field, ValToLogVal(val));
+		break;
+
+	default:
+		reporter->InternalError("unsupported type %s for log_write", type_name(batch->Type(field)));
+	}
 	}
 
 bool Manager::CreateWriterForRemoteLog(EnumVal* id, EnumVal* writer, WriterBackend::WriterInfo* info,
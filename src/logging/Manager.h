@@ -19,6 +19,7 @@ class RotationTimer;
 namespace logging {
 
 class WriterFrontend;
+class ColumnBatch;
 class RotationFinishedMessage;
 
 /**
@@ -261,6 +262,21 @@ private:
 	threading::Value** RecordToFilterVals(Stream* stream, Filter* filter,
 				    RecordVal* columns);
 
+	// Fills in a log entry's values for a filter's fields in a batch.
+	void RecordToBatch(Stream* stream, Filter* filter, RecordVal* columns,
+			   ColumnBatch* batch);
+
+	// Returns the extension record to log with a filter's entries, or
+	// nil if there's none.
+	IntrusivePtr<RecordVal> FilterExtensions(Filter* filter);
+
+	// Returns the value of a filter's field in a log entry, or nil if
+	// it isn't set.
+	Val* FilterFieldVal(Filter* filter, int field, RecordVal* columns,
+			    RecordVal* ext_rec);
+
+	void ValToBatch(Val* val, ColumnBatch* batch, int field);
+
 	threading::Value* ValToLogVal(Val* val, BroType* ty = nullptr);
 	Stream* FindStream(EnumVal* id);
 	void RemoveDisabledWriters(Stream* stream);
@@ -8,6 +8,7 @@
 #include "Manager.h"
 #include "WriterBackend.h"
 #include "WriterFrontend.h"
+#include "ColumnBatch.h"
 
 // Messages sent from backend to frontend (i.e., "OutputMessages").
 
@@ -123,6 +124,7 @@ WriterBackend::WriterBackend(WriterFrontend* arg_frontend) : MsgThread()
 	num_fields = 0;
 	fields = nullptr;
 	buffering = true;
+	batches = false;
 	frontend = arg_frontend;
 	info = new WriterInfo(frontend->Info());
 	rotation_counter = 0;
@@ -253,6 +255,56 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 	return success;
 	}
 
+bool WriterBackend::WriteBatch(ColumnBatch* batch)
+	{
+	// Double-check that the columns match.
+	bool match = (batch->NumFields() == num_fields);
+
+	for ( int i = 0; match && i < num_fields; ++i )
+		match = (batch->Type(i) == fields[i]->type);
+
+	if ( ! match )
+		{
+#ifdef DEBUG
+		Debug(DBG_LOGGING, "Columns don't match in WriterBackend::WriteBatch()");
+#endif
+		delete batch;
+		DisableFrontend();
+		return false;
+		}
+
+	bool success = true;
+
+	if ( ! Failed() )
+		success = DoWriteBatch(batch);
+
+	delete batch;
+
+	if ( ! success )
+		DisableFrontend();
+
+	return success;
+	}
+
+bool WriterBackend::DoWriteBatch(ColumnBatch* batch)
+	{
+	for ( int j = 0; j < batch->NumEntries(); j++ )
+		{
+		Value** vals = batch->TakeEntry(j);
+		bool success = DoWrite(num_fields, fields, vals);
+
+		for ( int i = 0; i < num_fields; i++ )
+			delete vals[i];
+
+		delete [] vals;
+
+		if ( ! success )
+			return false;
+		}
+
+	return true;
+	}
+
 bool WriterBackend::SetBuf(bool enabled)
 	{
 	if ( enabled == buffering )
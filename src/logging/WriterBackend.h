@@ -13,6 +13,7 @@ namespace broker { class data; }
 namespace logging  {
 
 class WriterFrontend;
+class ColumnBatch;
 
 /**
  * Base class for writer implementation. When the logging::Manager creates a
@@ -149,6 +150,22 @@ public:
 	 */
 	bool Write(int num_fields, int num_writes, threading::Value*** vals);
 
+	/**
+	 * Writes a batch of log entries.
+	 * @param batch The entries, with columns matching the fields passed
+	 * to Init(). The method takes ownership of \a batch.
+	 * @return False if an error occured.
+	 */
+	bool WriteBatch(ColumnBatch* batch);
+
+	/**
+	 * Returns true if the writer prefers getting log entries passed in
+	 * as batches (see DoWriteBatch()). This method is safe to call from
+	 * the main thread, as the result doesn't change once the backend is
+	 * constructed.
+	 */
+	bool WantsBatches() const	{ return batches; }
+
 	/**
 	 * Sets the buffering status for the writer, assuming the writer
 	 * supports that. (If not, it will be ignored).
@@ -280,6 +297,24 @@ protected:
 	virtual bool DoWrite(int num_fields, const threading::Field* const*  fields,
 			     threading::Value** vals) = 0;
 
+	/**
+	 * Writer-specific output method implementing recording of a batch of
+	 * log entries. It only gets called if the writer has called
+	 * EnableBatches(); otherwise, entries come in through DoWrite().
+	 * The default implementation passes each entry on to DoWrite(), which
+	 * still saves the main thread from preparing entries individually.
+	 * A writer implementation can override this method to work on the
+	 * batch's columns directly. The same rules as for DoWrite() apply to
+	 * the return value.
+	 */
+	virtual bool DoWriteBatch(ColumnBatch* batch);
+
+	/**
+	 * Signals that the writer wants to get log entries passed in as
+	 * batches. Must be called from the writer's constructor, if at all.
+	 */
+	void EnableBatches()	{ batches = true; }
+
 	/**
 	 * Writer-specific method implementing a change of fthe buffering
 	 * state.  If buffering is disabled, the writer should attempt to
@@ -383,6 +418,7 @@ private:
 	int num_fields;	// Number of log fields.
 	const threading::Field* const*  fields;	// Log fields.
 	bool buffering;	// True if buffering is enabled.
+	bool batches;	// True if entries get passed in as batches.
 
 	int rotation_counter; // Tracks FinishedRotation() calls.
 };
@@ -6,6 +6,7 @@
 #include "Manager.h"
 #include "WriterFrontend.h"
 #include "WriterBackend.h"
+#include "ColumnBatch.h"
 
 using threading::Value;
 using threading::Field;
@@ -67,6 +68,19 @@ private:
 	Value ***vals;
 };
 
+class WriteBatchMessage final : public threading::InputMessage<WriterBackend>
+{
+public:
+	WriteBatchMessage(WriterBackend* backend, ColumnBatch* batch)
+		: threading::InputMessage<WriterBackend>("WriteBatch", backend),
+		batch(batch)	{}
+
+	bool Process() override { return Object()->WriteBatch(batch); }
+
+private:
+	ColumnBatch* batch;
+};
+
 class SetBufMessage final : public threading::InputMessage<WriterBackend>
 {
 public:
@@ -111,6 +125,7 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
 	remote = arg_remote;
 	write_buffer = nullptr;
 	write_buffer_pos = 0;
+	batch = nullptr;
 	info = new WriterBackend::WriterInfo(arg_info);
 
 	num_fields = 0;
@@ -129,6 +144,9 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
 
 	else
 		backend = nullptr;
+
+	// Remote clients need the entries as individual values.
+	batches = backend && backend->WantsBatches() && ! remote;
 	}
 
 WriterFrontend::~WriterFrontend()
@@ -137,6 +155,7 @@ WriterFrontend::~WriterFrontend()
 		delete fields[i];
 
 	delete [] fields;
+	delete batch;
 
 	Unref(stream);
 	Unref(writer);
@@ -220,6 +239,10 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 		return;
 		}
 
+	if ( batch )
+		// Keep the order of entries.
+		FlushWriteBuffer();
+
 	if ( ! write_buffer )
 		{
 		// Need new buffer.
@@ -235,18 +258,53 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 
 	}
 
+ColumnBatch* WriterFrontend::Batch()
+	{
+	if ( write_buffer_pos )
+		// Keep the order of entries.
+		FlushWriteBuffer();
+
+	if ( ! batch )
+		batch = new ColumnBatch(num_fields, fields, WRITER_BUFFER_SIZE);
+
+	return batch;
+	}
+
+void WriterFrontend::FinishBatchEntry()
+	{
+	if ( batch->Full() || ! buf || terminating )
+		// Batch full (or no buffering desired or terminating).
+		FlushWriteBuffer();
+	}
+
 void WriterFrontend::FlushWriteBuffer()
 	{
-	if ( ! write_buffer_pos )
-		// Nothing to do.
-		return;
+	// Whatever we have goes to the child in one go.
+	std::vector<threading::BasicInputMessage*> msgs;
 
-	if ( backend )
-		backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer));
+	if ( write_buffer_pos )
+		{
+		if ( backend )
+			msgs.push_back(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer));
 
-	// Clear buffer (no delete, we pass ownership to child thread.)
-	write_buffer = nullptr;
-	write_buffer_pos = 0;
+		// Clear buffer (no delete, we pass ownership to child thread.)
+		write_buffer = nullptr;
+		write_buffer_pos = 0;
+		}
+
+	if ( batch )
+		{
+		if ( backend )
+			// Passes ownership to child thread.
+			msgs.push_back(new WriteBatchMessage(backend, batch));
+		else
+			delete batch;
+
+		batch = nullptr;
+		}
+
+	if ( ! msgs.empty() )
+		backend->SendIn(msgs);
 	}
 
 void WriterFrontend::SetBuf(bool enabled)
@@ -7,6 +7,7 @@
 namespace logging  {
 
 class Manager;
+class ColumnBatch;
 
 /**
  * Bridge class between the logging::Manager and backend writer threads. The
@@ -92,6 +93,36 @@ public:
 	 */
 	void Write(int num_fields, threading::Value** vals);
 
+	/**
+	 * Returns true if log entries are to be passed in through Batch()
+	 * rather than Write(). That's the case if the backend works with
+	 * batches (see WriterBackend::WantsBatches()) and the entries don't
+	 * need to be sent to remote clients as well.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	bool WantsBatches() const	{ return batches && ! disabled; }
+
+	/**
+	 * Returns the batch to fill in the next log entry with. Once done
+	 * with the entry (see ColumnBatch::FinishEntry()), the caller must
+	 * call FinishBatchEntry().
+	 *
+	 * As with Write(), the entries get buffered until the batch is full,
+	 * or FlushWriteBuffer() sends them over to the backend.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	ColumnBatch* Batch();
+
+	/**
+	 * Signals that the next log entry has been filled in. Flushes the
+	 * batch if it's full, or if buffering is disabled.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	void FinishBatchEntry();
+
 	/**
 	 * Sets the buffering state.
 	 *
@@ -196,6 +227,7 @@ protected:
 	bool buf;	// True if buffering is enabled (default).
 	bool local;	// True if logging locally.
 	bool remote;	// True if loggin remotely.
+	bool batches;	// True if passing entries in batches.
 
 	const char* name;	// Descriptive name of the
 	WriterBackend::WriterInfo* info;	// The writer information.
@@ -206,6 +238,7 @@ protected:
 	static const int WRITER_BUFFER_SIZE = 1000;
 	int write_buffer_pos;	// Position of next write in buffer.
 	threading::Value*** write_buffer;	// Buffer of size WRITER_BUFFER_SIZE.
+	ColumnBatch* batch;	// Batch being filled, holding up to WRITER_BUFFER_SIZE entries.
 };
 
 }
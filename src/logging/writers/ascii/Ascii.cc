@@ -8,6 +8,7 @@
 #include "threading/SerialTypes.h"
 
 #include "Ascii.h"
+#include "ParallelGzip.h"
 #include "ascii.bif.h"
 
 using namespace std;
@@ -27,10 +28,17 @@ Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend)
 	enable_utf_8 = false;
 	formatter = nullptr;
 	gzip_level = 0;
+	gzip_threads = 0;
+	gzip_block_size = 0;
 	gzfile = nullptr;
+	pgz = nullptr;
 
 	InitConfigOptions();
 	init_options = InitFilterOptions();
+
+	// Turning batches back into entries here takes that work off the
+	// main thread.
+	EnableBatches();
 	}
 
 void Ascii::InitConfigOptions()
@@ -40,6 +48,8 @@ void Ascii::InitConfigOptions()
 	use_json = BifConst::LogAscii::use_json;
 	enable_utf_8 = BifConst::LogAscii::enable_utf_8;
 	gzip_level = BifConst::LogAscii::gzip_level;
+	gzip_threads = BifConst::LogAscii::gzip_threads;
+	gzip_block_size = BifConst::LogAscii::gzip_block_size;
 
 	separator.assign(
 			(const char*) BifConst::LogAscii::separator->Bytes(),
@@ -110,6 +120,28 @@ bool Ascii::InitFilterOptions()
 				return false;
 				}
 			}
+		else if ( strcmp(i->first, "gzip_threads") == 0 )
+			{
+			gzip_threads = atoi(i->second);
+
+			if ( gzip_threads < 0 )
+				{
+				Error("invalid value for 'gzip_threads', must not be negative.");
+				return false;
+				}
+			}
+
+		else if ( strcmp(i->first, "gzip_block_size") == 0 )
+			{
+			gzip_block_size = atoi(i->second);
+
+			if ( gzip_block_size <= 0 )
+				{
+				Error("invalid value for 'gzip_block_size', must be a positive number.");
+				return false;
+				}
+			}
+
 		else if ( strcmp(i->first, "use_json") == 0 )
 			{
 			if ( strcmp(i->second, "T") == 0 )
@@ -287,17 +319,33 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const Field* const *
 			return false;
 			}
 
-		char mode[4];
-		snprintf(mode, sizeof(mode), "wb%d", gzip_level);
-		errno = 0; // errno will only be set under certain circumstances by gzdopen.
-		gzfile = gzdopen(fd, mode);
-
-		if ( gzfile == nullptr )
+		if ( gzip_block_size <= 0 )
 			{
-			Error(Fmt("cannot gzip %s: %s", fname.c_str(),
-			                                Strerror(errno)));
+			Error("invalid value for 'gzip_block_size', must be a positive number.");
 			return false;
 			}
+
+		if ( gzip_threads > 1 )
+			{
+			// Compress blocks in parallel rather than one stream.
+			pgz = new ParallelGzip(fd, gzip_level, gzip_threads, gzip_block_size);
+			gzfile = nullptr;
+			}
+
+		else
+			{
+			char mode[4];
+			snprintf(mode, sizeof(mode), "wb%d", gzip_level);
+			errno = 0; // errno will only be set under certain circumstances by gzdopen.
+			gzfile = gzdopen(fd, mode);
+
+			if ( gzfile == nullptr )
+				{
+				Error(Fmt("cannot gzip %s: %s", fname.c_str(),
+				                                Strerror(errno)));
+				return false;
+				}
+			}
 		}
 	else
 		{
@@ -367,6 +415,12 @@ bool Ascii::WriteHeader(const string& path)
 
 bool Ascii::DoFlush(double network_time)
 	{
+	if ( pgz && ! pgz->Flush() )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), pgz->Error().c_str()));
+		return false;
+		}
+
 	fsync(fd);
 	return true;
 	}
@@ -421,7 +475,12 @@ bool Ascii::DoWrite(int num_fields, const Field* const * fields,
 		goto write_error;
 
         if ( ! IsBuf() )
+		{
+		if ( pgz && ! pgz->Flush() )
+			goto write_error;
+
 		fsync(fd);
+		}
 
 	return true;
 
@@ -516,6 +575,15 @@ string Ascii::Timestamp(double t)
 
 bool Ascii::InternalWrite(int fd, const char* data, int len)
 	{
+	if ( pgz )
+		{
+		if ( pgz->Write(data, len) )
+			return true;
+
+		Error(Fmt("Ascii::InternalWrite error: %s\n", pgz->Error().c_str()));
+		return false;
+		}
+
 	if ( ! gzfile )
 		return safe_write(fd, data, len);
 
@@ -539,6 +607,19 @@ bool Ascii::InternalWrite(int fd, const char* data, int len)
 
 bool Ascii::InternalClose(int fd)
 	{
+	if ( pgz )
+		{
+		bool ok = pgz->Close();
+
+		if ( ! ok )
+			Error(Fmt("Ascii::InternalClose error: %s\n", pgz->Error().c_str()));
+
+		delete pgz;
+		pgz = nullptr;
+		safe_close(fd);
+		return ok;
+		}
+
 	if ( ! gzfile )
 		{
 		safe_close(fd);
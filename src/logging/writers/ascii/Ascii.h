@@ -12,6 +12,8 @@
 
 namespace logging { namespace writer {
 
+class ParallelGzip;
+
 class Ascii : public WriterBackend {
 public:
 	explicit Ascii(WriterFrontend* frontend);
@@ -48,6 +50,7 @@ private:
 
 	int fd;
 	gzFile gzfile;
+	ParallelGzip* pgz;	// Used instead of gzfile with multiple threads.
 	std::string fname;
 	ODesc desc;
 	bool ascii_done;
@@ -64,6 +67,8 @@ private:
 	std::string meta_prefix;
 
 	int gzip_level; // level > 0 enables gzip compression
+	int gzip_threads; // threads > 1 compress blocks in parallel
+	int gzip_block_size;
 	std::string gzip_file_extension;
 	bool use_json;
 	bool enable_utf_8;
@@ -0,0 +1,252 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek-config.h"
+
+#include "ParallelGzip.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "zlib.h"
+#include "util.h"
+
+#include "3rdparty/doctest.h"
+
+using namespace logging::writer;
+
+ParallelGzip::ParallelGzip(int arg_fd, int arg_level, int num_threads, size_t arg_block_size)
+	{
+	fd = arg_fd;
+	level = arg_level;
+	block_size = arg_block_size;
+	stopping = false;
+
+	for ( int i = 0; i < num_threads; ++i )
+		workers.emplace_back(&ParallelGzip::Work, this);
+	}
+
+ParallelGzip::~ParallelGzip()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		}
+
+	work_cond.notify_all();
+
+	for ( auto& w : workers )
+		w.join();
+
+	for ( auto b : pending )
+		delete b;
+	}
+
+bool ParallelGzip::Write(const char* data, int len)
+	{
+	current.append(data, len);
+
+	if ( current.size() < block_size )
+		return true;
+
+	Submit(false);
+
+	// Bound the memory held by blocks in flight.
+	return WriteFinished(2 * workers.size());
+	}
+
+bool ParallelGzip::Flush()
+	{
+	Submit(true);
+	return WriteFinished(0);
+	}
+
+bool ParallelGzip::Close()
+	{
+	return Flush();
+	}
+
+void ParallelGzip::Submit(bool all)
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size_t n = 0;
+
+	while ( current.size() - n >= (all ? 1 : block_size) )
+		{
+		auto b = new Block;
+		b->in = current.substr(n, block_size);
+		b->done = b->ok = false;
+		n += b->in.size();
+
+		pending.push_back(b);
+		queue.push_back(b);
+		}
+
+	current.erase(0, n);
+	work_cond.notify_all();
+	}
+
+bool ParallelGzip::WriteFinished(size_t max_pending)
+	{
+	bool ok = true;
+
+	while ( true )
+		{
+		Block* b;
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if ( pending.empty() )
+				break;
+
+			b = pending.front();
+
+			if ( ! b->done )
+				{
+				if ( pending.size() <= max_pending )
+					break;
+
+				done_cond.wait(lock, [b] { return b->done; });
+				}
+
+			pending.pop_front();
+			}
+
+		// Keep the file consistent up to the first failure.
+		if ( ok && ! b->ok )
+			{
+			error = "compression failed";
+			ok = false;
+			}
+
+		if ( ok && ! safe_write(fd, b->out.data(), b->out.size()) )
+			{
+			char buf[256];
+			bro_strerror_r(errno, buf, sizeof(buf));
+			error = buf;
+			ok = false;
+			}
+
+		delete b;
+		}
+
+	return ok;
+	}
+
+void ParallelGzip::Work()
+	{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( true )
+		{
+		work_cond.wait(lock, [this] { return stopping || ! queue.empty(); });
+
+		if ( stopping )
+			return;
+
+		Block* b = queue.front();
+		queue.pop_front();
+
+		lock.unlock();
+		bool ok = Compress(b->in, &b->out, level);
+		lock.lock();
+
+		b->in.clear();
+		b->ok = ok;
+		b->done = true;
+		done_cond.notify_all();
+		}
+	}
+
+bool ParallelGzip::Compress(const std::string& in, std::string* out, int level)
+	{
+	z_stream zs;
+	zs.zalloc = Z_NULL;
+	zs.zfree = Z_NULL;
+	zs.opaque = Z_NULL;
+
+	// A window size of 15 plus 16 gets a gzip header and trailer.
+	if ( deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+		return false;
+
+	out->resize(deflateBound(&zs, in.size()));
+
+	zs.next_in = (Bytef*) in.data();
+	zs.avail_in = in.size();
+	zs.next_out = (Bytef*) &(*out)[0];
+	zs.avail_out = out->size();
+
+	int res = deflate(&zs, Z_FINISH);
+	out->resize(zs.total_out);
+	deflateEnd(&zs);
+
+	return res == Z_STREAM_END;
+	}
+
+TEST_CASE("parallel gzip")
+	{
+	FILE* f = tmpfile();
+	REQUIRE(f);
+	int fd = fileno(f);
+
+	std::string data;
+
+	for ( int i = 0; i < 5000; ++i )
+		data += "line " + std::to_string(i) + "\n";
+
+	ParallelGzip gz(fd, 6, 3, 1000);
+
+	for ( size_t n = 0; n < data.size(); n += 700 )
+		CHECK(gz.Write(data.data() + n, std::min<size_t>(700, data.size() - n)));
+
+	CHECK(gz.Close());
+
+	std::string compressed;
+	char buf[4096];
+	ssize_t n;
+	lseek(fd, 0, SEEK_SET);
+
+	while ( (n = read(fd, buf, sizeof(buf))) > 0 )
+		compressed.append(buf, n);
+
+	fclose(f);
+
+	// Inflate member after member.
+	std::string result;
+	size_t pos = 0;
+	int members = 0;
+
+	while ( pos < compressed.size() )
+		{
+		z_stream zs;
+		zs.zalloc = Z_NULL;
+		zs.zfree = Z_NULL;
+		zs.opaque = Z_NULL;
+		zs.next_in = (Bytef*) compressed.data() + pos;
+		zs.avail_in = compressed.size() - pos;
+		REQUIRE(inflateInit2(&zs, 15 + 16) == Z_OK);
+
+		int res;
+
+		do
+			{
+			zs.next_out = (Bytef*) buf;
+			zs.avail_out = sizeof(buf);
+			res = inflate(&zs, Z_NO_FLUSH);
+			result.append(buf, sizeof(buf) - zs.avail_out);
+			} while ( res == Z_OK );
+
+		CHECK(res == Z_STREAM_END);
+		pos += zs.total_in;
+		inflateEnd(&zs);
+		++members;
+
+		if ( res != Z_STREAM_END )
+			break;
+		}
+
+	CHECK(members > 1);
+	CHECK(result == data);
+	}
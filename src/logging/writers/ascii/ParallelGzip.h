@@ -0,0 +1,108 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace logging { namespace writer {
+
+/**
+ * Compresses data into a gzip file with a pool of threads. The data gets
+ * split into blocks, each of which a worker compresses into a gzip member
+ * of its own. Standard decompressors treat a sequence of members as one
+ * stream (see RFC 1952), so that the result reads like a single gzip file,
+ * at the cost of a slightly worse compression ratio.
+ *
+ * All methods must be called from the same thread.
+ */
+class ParallelGzip {
+public:
+	/**
+	 * Constructor. Starts the workers.
+	 *
+	 * @param fd The file to write to. The caller keeps ownership.
+	 *
+	 * @param level The compression level, between 1 and 9.
+	 *
+	 * @param num_threads The number of workers.
+	 *
+	 * @param block_size The number of bytes to compress into each
+	 * member.
+	 */
+	ParallelGzip(int fd, int level, int num_threads, size_t block_size);
+
+	/**
+	 * Destructor. Stops the workers, discarding any data not written
+	 * yet; use Close() to finish the file first.
+	 */
+	~ParallelGzip();
+
+	/**
+	 * Adds data to the file. Blocks only if the workers fall behind by
+	 * more than a couple of blocks.
+	 *
+	 * @return False if writing to the file failed; see Error().
+	 */
+	bool Write(const char* data, int len);
+
+	/**
+	 * Compresses all data added so far and writes it out.
+	 *
+	 * @return False if writing to the file failed; see Error().
+	 */
+	bool Flush();
+
+	/**
+	 * Flushes and stops the workers. Doesn't close the file.
+	 *
+	 * @return False if writing to the file failed; see Error().
+	 */
+	bool Close();
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& Error() const	{ return error; }
+
+private:
+	struct Block {
+		std::string in;
+		std::string out;
+		bool done;
+		bool ok;
+	};
+
+	// Hands the data added so far to the workers, in blocks of the
+	// block size. Keeps any rest smaller than that unless asked for all.
+	void Submit(bool all);
+
+	// Writes out finished blocks in order, waiting for any not finished
+	// yet if there are more pending than the given number.
+	bool WriteFinished(size_t max_pending);
+
+	void Work();
+
+	static bool Compress(const std::string& in, std::string* out, int level);
+
+	int fd;
+	int level;
+	size_t block_size;
+	std::string current;	// Data not yet submitted.
+	std::string error;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_cond;	// Signals new work, or stopping.
+	std::condition_variable done_cond;	// Signals finished blocks.
+	std::deque<Block*> pending;	// Submitted, in order; guarded by mutex.
+	std::deque<Block*> queue;	// Not picked up yet; guarded by mutex.
+	bool stopping;	// Guarded by mutex.
+};
+
+}
+}
@@ -0,0 +1,665 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <string>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "threading/SerialTypes.h"
+#include "logging/ColumnBatch.h"
+
+#include "Columnar.h"
+#include "columnar.bif.h"
+
+#include "3rdparty/doctest.h"
+
+using namespace std;
+using namespace logging;
+using namespace logging::writer;
+using threading::Value;
+using threading::Field;
+
+static const char* FILE_EXT = "zcol";
+static const char FILE_MAGIC[] = { 'Z', 'C', 'O', 'L' };
+static const uint8_t FILE_VERSION = 1;
+
+static const uint8_t ENC_PLAIN = 0;
+static const uint8_t ENC_DELTA = 1;
+static const uint8_t ENC_DICT = 2;
+static const uint8_t ENC_NULLS = 0x80;
+
+static void put_varint(string* out, uint64_t v)
+	{
+	while ( v >= 0x80 )
+		{
+		out->push_back(static_cast<char>((v & 0x7f) | 0x80));
+		v >>= 7;
+		}
+
+	out->push_back(static_cast<char>(v));
+	}
+
+static void put_zigzag(string* out, int64_t v)
+	{
+	put_varint(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+	}
+
+static void put_double(string* out, double d)
+	{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+
+	for ( int i = 0; i < 8; ++i )
+		out->push_back(static_cast<char>(bits >> (8 * i)));
+	}
+
+static void put_bytes(string* out, const char* data, int len)
+	{
+	put_varint(out, len);
+	out->append(data, len);
+	}
+
+static void put_addr(string* out, const Value::addr_t& a)
+	{
+	if ( a.family == IPv4 )
+		{
+		out->push_back(4);
+		out->append(reinterpret_cast<const char*>(&a.in.in4), 4);
+		}
+	else
+		{
+		out->push_back(6);
+		out->append(reinterpret_cast<const char*>(&a.in.in6), 16);
+		}
+	}
+
+static void put_subnet(string* out, const Value::subnet_t& s)
+	{
+	put_addr(out, s.prefix);
+
+	// The logging framework's lengths always refer to IPv6 addresses.
+	out->push_back(s.prefix.family == IPv4 ? s.length - 96 : s.length);
+	}
+
+// Appends the plain encoding of a value that's set.
+static void put_plain(string* out, const Value* v)
+	{
+	switch ( v->type ) {
+	case TYPE_BOOL:
+		out->push_back(v->val.int_val ? 1 : 0);
+		break;
+
+	case TYPE_INT:
+		put_zigzag(out, v->val.int_val);
+		break;
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		put_varint(out, v->val.uint_val);
+		break;
+
+	case TYPE_PORT:
+		put_varint(out, v->val.port_val.port);
+		out->push_back(v->val.port_val.proto);
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		put_double(out, v->val.double_val);
+		break;
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		put_bytes(out, v->val.string_val.data, v->val.string_val.length);
+		break;
+
+	case TYPE_ADDR:
+		put_addr(out, v->val.addr_val);
+		break;
+
+	case TYPE_SUBNET:
+		put_subnet(out, v->val.subnet_val);
+		break;
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		{
+		const Value::set_t& s = (v->type == TYPE_TABLE ?
+		                         v->val.set_val : v->val.vector_val);
+		put_varint(out, s.size);
+
+		for ( int i = 0; i < s.size; ++i )
+			{
+			out->push_back(s.vals[i]->present ? 1 : 0);
+
+			if ( s.vals[i]->present )
+				put_plain(out, s.vals[i]);
+			}
+
+		break;
+		}
+
+	default:
+		// Not loggable.
+		break;
+	}
+	}
+
+Columnar::Columnar(WriterFrontend* frontend) : WriterBackend(frontend)
+	{
+	fd = 0;
+	done = false;
+	num_rows = 0;
+	total_rows = 0;
+
+	row_group_size = BifConst::LogColumnar::row_group_size;
+	dict_max_size = BifConst::LogColumnar::dict_max_size;
+
+	EnableBatches();
+	}
+
+Columnar::~Columnar()
+	{
+	if ( ! done )
+		// In case of errors aborting the logging altogether,
+		// DoFinish() may not have been called.
+		CloseFile();
+	}
+
+bool Columnar::InitFilterOptions()
+	{
+	const WriterInfo& info = Info();
+
+	// Set per-filter configuration options.
+	for ( WriterInfo::config_map::const_iterator i = info.config.begin();
+	      i != info.config.end(); ++i )
+		{
+		if ( strcmp(i->first, "row_group_size") == 0 )
+			row_group_size = atoi(i->second);
+
+		else if ( strcmp(i->first, "dict_max_size") == 0 )
+			dict_max_size = atoi(i->second);
+		}
+
+	if ( row_group_size <= 0 )
+		{
+		Error("invalid value for 'row_group_size', must be a positive number");
+		return false;
+		}
+
+	if ( dict_max_size < 0 )
+		{
+		Error("invalid value for 'dict_max_size', must not be negative");
+		return false;
+		}
+
+	return true;
+	}
+
+bool Columnar::DoInit(const WriterInfo& info, int num_fields, const Field* const * fields)
+	{
+	if ( ! InitFilterOptions() )
+		return false;
+
+	columns.resize(num_fields);
+
+	for ( int i = 0; i < num_fields; ++i )
+		columns[i].type = fields[i]->type;
+
+	return OpenFile();
+	}
+
+bool Columnar::OpenFile()
+	{
+	assert(! fd);
+
+	fname = string(Info().path) + "." + FILE_EXT;
+	fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if ( fd < 0 )
+		{
+		Error(Fmt("cannot open %s: %s", fname.c_str(), Strerror(errno)));
+		fd = 0;
+		return false;
+		}
+
+	total_rows = 0;
+
+	string header(FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.push_back(FILE_VERSION);
+	put_varint(&header, NumFields());
+
+	for ( int i = 0; i < NumFields(); ++i )
+		{
+		const Field* f = Fields()[i];
+		put_bytes(&header, f->name, strlen(f->name));
+		header.push_back(f->type);
+		header.push_back(f->subtype);
+		header.push_back(f->optional ? 1 : 0);
+		}
+
+	if ( ! safe_write(fd, header.data(), header.size()) )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+		return false;
+		}
+
+	return true;
+	}
+
+bool Columnar::CloseFile()
+	{
+	if ( ! fd )
+		return true;
+
+	bool ok = WriteGroup();
+
+	string trailer(1, 'E');
+	put_varint(&trailer, total_rows);
+
+	if ( ok && ! safe_write(fd, trailer.data(), trailer.size()) )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+		ok = false;
+		}
+
+	safe_close(fd);
+	fd = 0;
+
+	return ok;
+	}
+
+void Columnar::EncodeColumn(const Column& c, string* out) const
+	{
+	uint8_t encoding = ENC_PLAIN;
+	string payload;
+
+	for ( auto null : c.nulls )
+		{
+		if ( ! null )
+			continue;
+
+		// Bitmap of the rows not having the field set.
+		encoding |= ENC_NULLS;
+		payload.assign((c.nulls.size() + 7) / 8, '\0');
+
+		for ( size_t j = 0; j < c.nulls.size(); ++j )
+			if ( c.nulls[j] )
+				payload[j / 8] |= 1 << (j % 8);
+
+		break;
+		}
+
+	switch ( c.type ) {
+	case TYPE_BOOL:
+		for ( auto v : c.ints )
+			payload.push_back(v ? 1 : 0);
+		break;
+
+	case TYPE_INT:
+		for ( auto v : c.ints )
+			put_zigzag(&payload, static_cast<int64_t>(v));
+		break;
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		for ( auto v : c.ints )
+			put_varint(&payload, v);
+		break;
+
+	case TYPE_PORT:
+		for ( auto v : c.ints )
+			{
+			put_varint(&payload, v >> 8);
+			payload.push_back(v & 0xff);
+			}
+		break;
+
+	case TYPE_TIME:
+		{
+		encoding |= ENC_DELTA;
+		int64_t prev = 0;
+
+		for ( auto v : c.doubles )
+			{
+			int64_t usecs = llround(v * 1e6);
+			put_zigzag(&payload, usecs - prev);
+			prev = usecs;
+			}
+
+		break;
+		}
+
+	case TYPE_DOUBLE:
+	case TYPE_INTERVAL:
+		for ( auto v : c.doubles )
+			put_double(&payload, v);
+		break;
+
+	default:
+		{
+		// Look for few enough distinct values to make a dictionary
+		// worth it.
+		unordered_map<string, uint64_t> dict;
+		vector<const string*> entries;
+		bool use_dict = true;
+
+		for ( const auto& v : c.plain )
+			{
+			auto it = dict.emplace(v, entries.size());
+
+			if ( ! it.second )
+				continue;
+
+			entries.push_back(&it.first->first);
+
+			if ( entries.size() > static_cast<size_t>(dict_max_size) ||
+			     entries.size() * 2 > c.plain.size() )
+				{
+				use_dict = false;
+				break;
+				}
+			}
+
+		if ( ! use_dict )
+			{
+			for ( const auto& v : c.plain )
+				payload.append(v);
+
+			break;
+			}
+
+		encoding |= ENC_DICT;
+		put_varint(&payload, entries.size());
+
+		for ( auto e : entries )
+			payload.append(*e);
+
+		for ( const auto& v : c.plain )
+			put_varint(&payload, dict[v]);
+
+		break;
+		}
+	}
+
+	out->push_back(encoding);
+	put_varint(out, payload.size());
+	out->append(payload);
+	}
+
+bool Columnar::WriteGroup()
+	{
+	if ( ! num_rows )
+		return true;
+
+	string group(1, 'G');
+	put_varint(&group, num_rows);
+
+	for ( auto& c : columns )
+		{
+		EncodeColumn(c, &group);
+
+		c.nulls.clear();
+		c.ints.clear();
+		c.doubles.clear();
+		c.plain.clear();
+		}
+
+	total_rows += num_rows;
+	num_rows = 0;
+
+	if ( ! safe_write(fd, group.data(), group.size()) )
+		{
+		Error(Fmt("error writing to %s: %s", fname.c_str(), Strerror(errno)));
+		return false;
+		}
+
+	return true;
+	}
+
+void Columnar::AddValue(Column* c, const Value* v)
+	{
+	c->nulls.push_back(! v->present);
+
+	if ( ! v->present )
+		return;
+
+	switch ( c->type ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+		c->ints.push_back(v->val.int_val);
+		break;
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		c->ints.push_back(v->val.uint_val);
+		break;
+
+	case TYPE_PORT:
+		c->ints.push_back((v->val.port_val.port << 8) | v->val.port_val.proto);
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		c->doubles.push_back(v->val.double_val);
+		break;
+
+	default:
+		c->plain.emplace_back();
+		put_plain(&c->plain.back(), v);
+		break;
+	}
+	}
+
+void Columnar::AddBatchValue(Column* c, const ColumnBatch* batch, int entry, int field)
+	{
+	bool null = batch->IsNull(entry, field);
+	c->nulls.push_back(null);
+
+	if ( null )
+		return;
+
+	const ColumnBatch::Cell& cell = batch->Get(entry, field);
+
+	switch ( c->type ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+		c->ints.push_back(cell.int_val);
+		break;
+
+	case TYPE_COUNT:
+	case TYPE_COUNTER:
+		c->ints.push_back(cell.uint_val);
+		break;
+
+	case TYPE_PORT:
+		c->ints.push_back((cell.port_val.port << 8) | cell.port_val.proto);
+		break;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		c->doubles.push_back(cell.double_val);
+		break;
+
+	case TYPE_ENUM:
+	case TYPE_STRING:
+	case TYPE_FILE:
+	case TYPE_FUNC:
+		{
+		int len;
+		const char* data = batch->String(entry, field, &len);
+		c->plain.emplace_back();
+		put_bytes(&c->plain.back(), data, len);
+		break;
+		}
+
+	case TYPE_ADDR:
+		c->plain.emplace_back();
+		put_addr(&c->plain.back(), cell.addr_val);
+		break;
+
+	case TYPE_SUBNET:
+		c->plain.emplace_back();
+		put_subnet(&c->plain.back(), cell.subnet_val);
+		break;
+
+	case TYPE_TABLE:
+	case TYPE_VECTOR:
+		c->plain.emplace_back();
+		put_plain(&c->plain.back(), cell.boxed);
+		break;
+
+	default:
+		c->plain.emplace_back();
+		break;
+	}
+	}
+
+bool Columnar::FinishRows(int n)
+	{
+	num_rows += n;
+
+	if ( num_rows >= row_group_size || ! IsBuf() )
+		return WriteGroup();
+
+	return true;
+	}
+
+bool Columnar::DoWrite(int num_fields, const Field* const * fields, Value** vals)
+	{
+	if ( ! fd && ! OpenFile() )
+		return false;
+
+	for ( int i = 0; i < num_fields; ++i )
+		AddValue(&columns[i], vals[i]);
+
+	return FinishRows(1);
+	}
+
+bool Columnar::DoWriteBatch(ColumnBatch* batch)
+	{
+	if ( ! fd && ! OpenFile() )
+		return false;
+
+	int n = batch->NumEntries();
+
+	for ( int j = 0; j < n; )
+		{
+		// Fill up the current row group, one column at a time.
+		int k = std::min(n - j, row_group_size - num_rows);
+
+		for ( int i = 0; i < NumFields(); ++i )
+			for ( int e = j; e < j + k; ++e )
+				AddBatchValue(&columns[i], batch, e, i);
+
+		if ( ! FinishRows(k) )
+			return false;
+
+		j += k;
+		}
+
+	return true;
+	}
+
+bool Columnar::DoSetBuf(bool enabled)
+	{
+	// Without buffering, each write makes up a row group.
+	if ( ! enabled )
+		return WriteGroup();
+
+	return true;
+	}
+
+bool Columnar::DoFlush(double network_time)
+	{
+	return WriteGroup();
+	}
+
+bool Columnar::DoFinish(double network_time)
+	{
+	if ( done )
+		{
+		fprintf(stderr, "internal error: duplicate finish\n");
+		abort();
+		}
+
+	done = true;
+	return CloseFile();
+	}
+
+bool Columnar::DoRotate(const char* rotated_path, double open, double close, bool terminating)
+	{
+	// Don't rotate if there's not a file currently open.
+	if ( ! fd )
+		{
+		FinishedRotation();
+		return true;
+		}
+
+	if ( ! CloseFile() )
+		{
+		FinishedRotation();
+		return false;
+		}
+
+	string nname = string(rotated_path) + "." + FILE_EXT;
+
+	if ( rename(fname.c_str(), nname.c_str()) != 0 )
+		{
+		char buf[256];
+		bro_strerror_r(errno, buf, sizeof(buf));
+		Error(Fmt("failed to rename %s to %s: %s", fname.c_str(),
+		          nname.c_str(), buf));
+		FinishedRotation();
+		return false;
+		}
+
+	if ( ! FinishedRotation(nname.c_str(), fname.c_str(), open, close, terminating) )
+		{
+		Error(Fmt("error rotating %s to %s", fname.c_str(), nname.c_str()));
+		return false;
+		}
+
+	return true;
+	}
+
+bool Columnar::DoHeartbeat(double network_time, double current_time)
+	{
+	return true;
+	}
+
+TEST_CASE("columnar writer encodings")
+	{
+	string s;
+	put_varint(&s, 300);
+	CHECK(s == "\xac\x02");
+
+	s.clear();
+	put_zigzag(&s, -1);
+	put_zigzag(&s, 1);
+	put_zigzag(&s, -64);
+	CHECK(s == string("\x01\x02\x7f", 3));
+
+	s.clear();
+	put_double(&s, 1.0);
+	CHECK(s == string("\0\0\0\0\0\0\xf0\x3f", 8));
+
+	Value v(TYPE_VECTOR, TYPE_COUNT);
+	v.val.vector_val.size = 2;
+	v.val.vector_val.vals = new Value*[2];
+	v.val.vector_val.vals[0] = new Value(TYPE_COUNT);
+	v.val.vector_val.vals[0]->val.uint_val = 5;
+	v.val.vector_val.vals[1] = new Value(TYPE_COUNT, false);
+
+	s.clear();
+	put_plain(&s, &v);
+	CHECK(s == string("\x02\x01\x05\x00", 4));
+	}
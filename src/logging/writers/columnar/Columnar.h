@@ -0,0 +1,113 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Log writer for a compact binary columnar format.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "logging/WriterBackend.h"
+
+namespace logging { namespace writer {
+
+/**
+ * Writes logs into files that store entries in row groups, field by field,
+ * so that tools can read just the columns they need. A file looks like
+ * this:
+ *
+ *     file    = "ZCOL" version:u8 num_fields:varint field* group* trailer
+ *     field   = name:bytes type:u8 subtype:u8 optional:u8
+ *     group   = 'G' num_rows:varint column*
+ *     column  = encoding:u8 size:varint payload
+ *     trailer = 'E' total_rows:varint
+ *
+ * Varints are unsigned LEB128, bytes are a varint length followed by the
+ * data, and types are the values of Zeek's TypeTag. The version is 1.
+ * Each group has one column per field, in order, with the column's
+ * payload of the given size in bytes.
+ *
+ * If the encoding has bit 0x80 set, the payload starts with a bitmap of
+ * (num_rows + 7) / 8 bytes, in which bit i % 8 of byte i / 8 marks that
+ * the field isn't set in row i. The payload then continues with the
+ * values of the rows that do have the field set, encoded as given by the
+ * remaining bits:
+ *
+ *   - 0, plain: the values one after the other. Bools take a u8, ints a
+ *     zigzag varint, counts a varint, and ports a varint followed by the
+ *     transport protocol as u8 (0 unknown, 1 TCP, 2 UDP, 3 ICMP). Doubles,
+ *     times and intervals take 8 bytes, an IEEE 754 double in little
+ *     endian. Strings, and enums, files and functions as their names, are
+ *     bytes. Addresses take a u8 of 4 or 6 followed by the address's 4 or
+ *     16 bytes in network order; subnets take an address followed by the
+ *     prefix length as u8. Sets and vectors are a varint count followed
+ *     for each element by a u8 of 1 if the element is set, and if so the
+ *     element in plain encoding.
+ *
+ *   - 1, delta (times): the time as microseconds since the epoch for the
+ *     first value, and then the difference to the previous value, all as
+ *     zigzag varints.
+ *
+ *   - 2, dictionary (anything but bools, numbers and times): a varint
+ *     count of entries, the entries in plain encoding, and then for each
+ *     value the index of its entry as a varint.
+ *
+ * The writer picks dictionary encoding for columns with few distinct
+ * values in a group, and delta encoding for all times. Rotation closes
+ * the file, with its trailer, and renames it like the ASCII writer does.
+ */
+class Columnar : public WriterBackend {
+public:
+	explicit Columnar(WriterFrontend* frontend);
+	~Columnar() override;
+
+	static WriterBackend* Instantiate(WriterFrontend* frontend)
+		{ return new Columnar(frontend); }
+
+protected:
+	bool DoInit(const WriterInfo& info, int num_fields,
+			    const threading::Field* const* fields) override;
+	bool DoWrite(int num_fields, const threading::Field* const* fields,
+			     threading::Value** vals) override;
+	bool DoWriteBatch(ColumnBatch* batch) override;
+	bool DoSetBuf(bool enabled) override;
+	bool DoRotate(const char* rotated_path, double open,
+			      double close, bool terminating) override;
+	bool DoFlush(double network_time) override;
+	bool DoFinish(double network_time) override;
+	bool DoHeartbeat(double network_time, double current_time) override;
+
+private:
+	// The values of one field in the current row group.
+	struct Column {
+		TypeTag type;
+		std::vector<bool> nulls;	// One per row.
+		std::vector<uint64_t> ints;	// Bools, ints, counts, ports.
+		std::vector<double> doubles;	// Doubles, times, intervals.
+		std::vector<std::string> plain;	// Anything else, encoded plainly.
+	};
+
+	bool InitFilterOptions();
+	bool OpenFile();
+	bool CloseFile();
+	bool WriteGroup();
+	void EncodeColumn(const Column& c, std::string* out) const;
+	void AddValue(Column* c, const threading::Value* v);
+	void AddBatchValue(Column* c, const ColumnBatch* batch, int entry, int field);
+	bool FinishRows(int n);
+
+	int fd;
+	std::string fname;
+	bool done;
+
+	std::vector<Column> columns;
+	int num_rows;	// In the current row group.
+	uint64_t total_rows;	// In the current file.
+
+	// Options set from the script-level.
+	int row_group_size;
+	int dict_max_size;
+};
+
+}
+}
@@ -10,7 +10,7 @@ namespace logging { namespace writer {
 
 class None : public WriterBackend {
 public:
-	explicit None(WriterFrontend* frontend) : WriterBackend(frontend)	{}
+	explicit None(WriterFrontend* frontend) : WriterBackend(frontend)	{ EnableBatches(); }
 	~None() override {};
 
 	static WriterBackend* Instantiate(WriterFrontend* frontend)
@@ -21,6 +21,7 @@ protected:
 			    const threading::Field* const * fields) override;
 	bool DoWrite(int num_fields, const threading::Field* const* fields,
 			     threading::Value** vals) override { return true; }
+	bool DoWriteBatch(ColumnBatch* batch) override { return true; }
 	bool DoSetBuf(bool enabled) override { return true; }
 	bool DoRotate(const char* rotated_path, double open,
 			      double close, bool terminating) override;
@@ -36,6 +36,8 @@ extern "C" {
 #include "Desc.h"
 #include "Debug.h"
 #include "DFA.h"
+#include "ByteCode.h"
+#include "ScriptOpt.h"
 #include "RuleMatcher.h"
 #include "Anon.h"
 #include "EventRegistry.h"
@@ -554,7 +556,17 @@ int main(int argc, char** argv)
 	createCurrentDoc("1.0");		// Set a global XML document
 #endif
 
-	timer_mgr = new PQ_TimerMgr();
+	if ( options.use_timer_wheel )
+		timer_mgr = new Wheel_TimerMgr();
+	else
+		timer_mgr = new PQ_TimerMgr();
+
+	dfa_precompile_states = options.dfa_precompile_states;
+	dfa_cache_dir = options.dfa_cache_dir.value_or("");
+
+	// The debugger steps through the AST.
+	compile_scripts = options.compile_scripts && ! options.debug_scripts;
+	optimize_scripts = options.optimize_scripts && ! options.debug_scripts;
 
 	auto zeekygen_cfg = options.zeekygen_config_file.value_or("");
 	zeekygen_mgr = new zeekygen::Manager(zeekygen_cfg, bro_argv[0]);
@@ -810,6 +822,12 @@ int main(int argc, char** argv)
 		exit(0);
 		}
 
+	if ( optimize_scripts )
+		{
+		ScriptOptimizer optimizer;
+		optimizer.Run();
+		}
+
 	if ( profiling_interval > 0 )
 		{
 		profiling_logger = new ProfileLogger(profiling_file->AsFile(),
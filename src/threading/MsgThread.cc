@@ -10,6 +10,10 @@
 
 using namespace threading;
 
+// Maximum number of input messages a child thread takes off its queue at
+// once.
+static const size_t MAX_INPUT_BATCH = 64;
+
 namespace threading  {
 
 ////// Messages.
@@ -347,6 +351,22 @@ void MsgThread::SendIn(BasicInputMessage* msg, bool force)
 	++cnt_sent_in;
 	}
 
+void MsgThread::SendIn(const std::vector<BasicInputMessage*>& msgs)
+	{
+	if ( Terminating() )
+		{
+		for ( auto msg : msgs )
+			delete msg;
+
+		return;
+		}
+
+	for ( auto msg : msgs )
+		DBG_LOG(DBG_THREADING, "Sending '%s' to %s ...", msg->Name(), Name());
+
+	queue_in.PutMany(msgs);
+	cnt_sent_in += msgs.size();
+	}
 
 void MsgThread::SendOut(BasicOutputMessage* msg, bool force)
 	{
@@ -356,11 +376,14 @@ void MsgThread::SendOut(BasicOutputMessage* msg, bool force)
 		return;
 		}
 
-	queue_out.Put(msg);
+	bool was_empty = queue_out.Put(msg);
 
 	++cnt_sent_out;
 
-	flare.Fire();
+	// If there was something queued already, the main thread hasn't
+	// drained the queue yet and will see this message as well.
+	if ( was_empty )
+		flare.Fire();
 	}
 
 BasicOutputMessage* MsgThread::RetrieveOut()
@@ -391,28 +414,55 @@ BasicInputMessage* MsgThread::RetrieveIn()
 
 void MsgThread::Run()
 	{
+	std::vector<BasicInputMessage*> batch;
+
 	while ( ! (child_finished || Killed() ) )
 		{
-		BasicInputMessage* msg = RetrieveIn();
+		// Take everything that has queued up in one go, and only
+		// block if there's nothing.
+		if ( ! queue_in.GetMany(&batch, MAX_INPUT_BATCH) )
+			{
+			BasicInputMessage* msg = RetrieveIn();
 
-		if ( ! msg )
-			continue;
+			if ( ! msg )
+				continue;
 
-		bool result = msg->Process();
+			batch.push_back(msg);
+			}
 
-		delete msg;
+		size_t i = 0;
 
-		if ( ! result )
+		for ( ; i < batch.size() && ! (child_finished || Killed()); ++i )
 			{
-			Error("terminating thread");
-
-			// This will eventually kill this thread, but only
-			// after all other outgoing messages (in particular
-			// error messages have been processed by then main
-			// thread).
-			SendOut(new KillMeMessage(this));
-			failed = true;
+			BasicInputMessage* msg = batch[i];
+
+#ifdef DEBUG
+			std::string s = Fmt("Processing '%s' in %s",  msg->Name(), Name());
+			Debug(DBG_THREADING, s.c_str());
+#endif
+
+			bool result = msg->Process();
+
+			delete msg;
+
+			if ( ! result )
+				{
+				Error("terminating thread");
+
+				// This will eventually kill this thread, but only
+				// after all other outgoing messages (in particular
+				// error messages have been processed by then main
+				// thread).
+				SendOut(new KillMeMessage(this));
+				failed = true;
+				}
 			}
+
+		// We're done; drop what we didn't get to.
+		for ( ; i < batch.size(); ++i )
+			delete batch[i];
+
+		batch.clear();
 		}
 
 	// In case we haven't sent the finish method yet, do it now. Reading
@@ -51,6 +51,16 @@ public:
 	 */
 	void SendIn(BasicInputMessage* msg)	{ return SendIn(msg, false); }
 
+	/**
+	 * Sends a number of messages to the child thread at once, in order.
+	 * That's cheaper than sending them one by one.
+	 *
+	 * Only the main thread may call this method.
+	 *
+	 * @param msgs The messages.
+	 */
+	void SendIn(const std::vector<BasicInputMessage*>& msgs);
+
 	/**
 	 * Sends a message from the child thread to the main thread.
 	 *
@@ -0,0 +1,144 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include <thread>
+
+#include "3rdparty/doctest.h"
+
+#include "Queue.h"
+
+using namespace threading;
+
+TEST_SUITE_BEGIN("Queue");
+
+static int* item(intptr_t i)
+	{
+	return reinterpret_cast<int*>(i);
+	}
+
+TEST_CASE("queue empty")
+	{
+	Queue<int*> q(nullptr, nullptr);
+	std::vector<int*> out;
+
+	CHECK(! q.Ready());
+	CHECK(! q.MaybeReady());
+	CHECK(q.Size() == 0);
+	CHECK(q.GetMany(&out) == 0);
+	CHECK(out.empty());
+
+	// The first element into an empty queue says so, later ones don't.
+	CHECK(q.Put(item(1)));
+	CHECK(! q.Put(item(2)));
+	CHECK(q.Ready());
+	CHECK(q.Size() == 2);
+
+	CHECK(q.Get() == item(1));
+	CHECK(q.Get() == item(2));
+	CHECK(! q.Ready());
+	CHECK(q.Size() == 0);
+
+	// Drained, so it counts as empty again.
+	CHECK(q.Put(item(3)));
+	CHECK(q.Get() == item(3));
+
+	// Same for several elements at once.
+	CHECK(! q.PutMany({}));
+	CHECK(q.PutMany({item(4), item(5)}));
+	CHECK(! q.PutMany({item(6)}));
+	CHECK(q.Size() == 3);
+	CHECK(q.GetMany(&out) == 3);
+	CHECK(out.size() == 3);
+	CHECK(out[0] == item(4));
+	CHECK(out[2] == item(6));
+
+	Queue<int*>::Stats stats;
+	q.GetStats(&stats);
+	CHECK(stats.num_reads == 6);
+	CHECK(stats.num_writes == 6);
+	}
+
+TEST_CASE("queue block wraparound")
+	{
+	Queue<int*> q(nullptr, nullptr);
+	std::vector<int*> out;
+	intptr_t next_put = 1;
+	intptr_t next_get = 1;
+
+	// Fill and drain by varying amounts so that both sides cross
+	// block boundaries at all kinds of offsets.
+	for ( int round = 0; round < 50; ++round )
+		{
+		int n = 1 + (round * 37) % 700;
+
+		for ( int i = 0; i < n; ++i )
+			q.Put(item(next_put++));
+
+		CHECK(q.Size() == uint64_t(next_put - next_get));
+
+		if ( round % 2 )
+			{
+			while ( q.Ready() )
+				CHECK(q.Get() == item(next_get++));
+			}
+		else
+			{
+			out.clear();
+			size_t max = n / 2 + 1;
+			CHECK(q.GetMany(&out, max) == std::min(max, size_t(next_put - next_get)));
+
+			for ( auto i : out )
+				CHECK(i == item(next_get++));
+			}
+		}
+
+	out.clear();
+	q.GetMany(&out);
+
+	for ( auto i : out )
+		CHECK(i == item(next_get++));
+
+	CHECK(next_get == next_put);
+	CHECK(! q.Ready());
+	CHECK(q.GetMany(&out) == 0);
+	}
+
+TEST_CASE("queue threads")
+	{
+	Queue<int*> q(nullptr, nullptr);
+	const intptr_t count = 100000;
+
+	std::thread writer([&q, count]()
+		{
+		for ( intptr_t i = 1; i <= count; ++i )
+			q.Put(item(i));
+		});
+
+	intptr_t expected = 1;
+	bool in_order = true;
+	std::vector<int*> out;
+
+	while ( expected <= count )
+		{
+		out.clear();
+
+		if ( ! q.GetMany(&out, 100) )
+			{
+			int* i = q.Get();
+
+			if ( i )
+				out.push_back(i);
+			}
+
+		for ( auto i : out )
+			if ( i != item(expected++) )
+				in_order = false;
+		}
+
+	writer.join();
+
+	CHECK(in_order);
+	CHECK(! q.Ready());
+	CHECK(q.Size() == 0);
+	}
+
+TEST_SUITE_END();
@@ -1,9 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
-#include <deque>
+#include <vector>
 #include <stdint.h>
 #include <sys/time.h>
 
@@ -17,13 +17,17 @@ namespace threading {
 /**
  * A thread-safe single-reader single-writer queue.
  *
- * The implementation uses multiple queues and reads/writes in rotary fashion
- * in an attempt to limit contention.
+ * The implementation is lock-free for both sides: messages go into a
+ * chain of fixed-size ring blocks that the writer appends to and the
+ * reader consumes from, with the two sides synchronizing only through
+ * a pair of atomic counters. A mutex and condition variable are used
+ * solely to put a reader to sleep that's blocking in Get() on an empty
+ * queue; writers only touch them if a reader is actually waiting.
  *
- * All Queue instances must be instantiated by Bro's main thread.
+ * Exactly one thread may write to a Queue, and exactly one thread may
+ * read from it.
  *
- * TODO: Unclear how critical performance is for this qeueue. We could likely
- * optimize it further if helpful.
+ * All Queue instances must be instantiated by Bro's main thread.
  */
 template<typename T>
 class Queue
@@ -50,10 +54,34 @@ public:
 	 */
 	T Get();
 
+	/**
+	 * Retrieves all currently queued elements, up to a maximum, without
+	 * blocking.
+	 *
+	 * @param out A vector the elements are appended to, in order.
+	 *
+	 * @param max The maximum number of elements to retrieve.
+	 *
+	 * @return The number of elements retrieved.
+	 */
+	size_t GetMany(std::vector<T>* out, size_t max = SIZE_MAX);
+
 	/**
 	 * Queues one element.
+	 *
+	 * @return True if the queue was empty before, i.e., if the reader
+	 * may have gone idle and needs to be notified through other means
+	 * (such as a flare) if it's not blocking in Get().
+	 */
+	bool Put(T data);
+
+	/**
+	 * Queues a number of elements at once, making them visible to the
+	 * reader together.
+	 *
+	 * @return True if the queue was empty before, as with Put().
 	 */
-	void Put(T data);
+	bool PutMany(const std::vector<T>& data);
 
 	/**
 	 * Returns true if the next Get() operation will succeed.
@@ -66,10 +94,13 @@ public:
 	 * state, but won't do so very often. Note that this means that it can
 	 * consistently return false even if there is something in the Queue.
 	 * You have to check real queue status from time to time to be sure that
-	 * it is empty. In other words, this method helps to avoid locking the queue
-	 * frequently, but doesn't allow you to forgo it completely.
+	 * it is empty.
 	 */
-	bool MaybeReady() { return (num_reads != num_writes); }
+	bool MaybeReady()
+		{
+		return num_reads.load(std::memory_order_relaxed) !=
+		       num_writes.load(std::memory_order_relaxed);
+		}
 
 	/**
 	 * Wake up the reader if it's currently blocked for input. This is
@@ -100,23 +131,50 @@ public:
 	void GetStats(Stats* stats);
 
 private:
-	static const int NUM_QUEUES = 8;
+	static const int BLOCK_SIZE = 256;
+
+	struct Block {
+		T items[BLOCK_SIZE];
+		std::atomic<Block*> next;
+
+		Block() : next(nullptr)	{ }
+	};
+
+	// Appends an element without publishing it to the reader.
+	void Append(T data);
+
+	// Publishes all elements appended since the last call. Returns true
+	// if the queue was empty before.
+	bool Publish();
+
+	// Removes the next element, which must be available.
+	T Remove();
 
-	std::vector<std::unique_lock<std::mutex>> LocksForAllQueues();
+	// Waits for data to become available, for up to a few seconds.
+	void Wait();
 
-	std::mutex mutex[NUM_QUEUES];	// Mutex protected shared accesses.
-	std::condition_variable has_data[NUM_QUEUES];	// Signals when data becomes available
-	std::queue<T> messages[NUM_QUEUES];	// Actually holds the queued messages
+	// Reader side, touched only by the reader.
+	Block* read_block;
+	int read_pos;
 
-	int read_ptr;	// Where the next operation will read from
-	int write_ptr;	// Where the next operation will write to
+	// Writer side, touched only by the writer.
+	Block* write_block;
+	int write_pos;
+	uint64_t pending_writes;
+
+	// The counters are what synchronizes the two sides: an element
+	// becomes visible to the reader once num_writes covers it, and its
+	// slot (and block) may be recycled once num_reads does.
+	alignas(64) std::atomic<uint64_t> num_reads;
+	alignas(64) std::atomic<uint64_t> num_writes;
+
+	// For blocking the reader in Get().
+	std::mutex mutex;
+	std::condition_variable has_data;
+	std::atomic<bool> reader_waiting;
 
 	BasicThread* reader;
 	BasicThread* writer;
-
-	// Statistics.
-	uint64_t num_reads;
-	uint64_t num_writes;
 };
 
 inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
@@ -135,10 +193,11 @@ inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
 
 template<typename T>
 inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer)
+	: num_reads(0), num_writes(0), reader_waiting(false)
 	{
-	read_ptr = 0;
-	write_ptr = 0;
-	num_reads = num_writes = 0;
+	read_block = write_block = new Block;
+	read_pos = write_pos = 0;
+	pending_writes = 0;
 	reader = arg_reader;
 	writer = arg_writer;
 	}
@@ -146,119 +205,163 @@ inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer)
 template<typename T>
 inline Queue<T>::~Queue()
 	{
+	while ( read_block )
+		{
+		Block* next = read_block->next.load(std::memory_order_relaxed);
+		delete read_block;
+		read_block = next;
+		}
 	}
 
 template<typename T>
-inline T Queue<T>::Get()
+inline void Queue<T>::Append(T data)
 	{
-	auto lock = acquire_lock(mutex[read_ptr]);
+	if ( write_pos == BLOCK_SIZE )
+		{
+		// The reader won't look at the new block before the
+		// element in it gets published.
+		Block* b = new Block;
+		write_block->next.store(b, std::memory_order_relaxed);
+		write_block = b;
+		write_pos = 0;
+		}
 
-	int old_read_ptr = read_ptr;
+	write_block->items[write_pos++] = data;
+	++pending_writes;
+	}
 
-	if ( messages[read_ptr].empty() && ! ((reader && reader->Killed()) || (writer && writer->Killed())) )
+template<typename T>
+inline bool Queue<T>::Publish()
+	{
+	uint64_t before = num_writes.load(std::memory_order_relaxed);
+	num_writes.store(before + pending_writes, std::memory_order_seq_cst);
+	pending_writes = 0;
+
+	// Pairs with the reader storing num_reads and then checking
+	// num_writes: either we see that it has caught up with everything
+	// we had published before, or it will see the new elements.
+	bool was_empty = (num_reads.load(std::memory_order_seq_cst) == before);
+
+	if ( reader_waiting.load(std::memory_order_seq_cst) )
 		{
-		if ( has_data[read_ptr].wait_for(lock, std::chrono::seconds(5)) == std::cv_status::timeout )
-			return nullptr;
+		// Taking the lock makes sure the reader is either not yet
+		// checking for data or already blocked in wait_for().
+		auto lock = acquire_lock(mutex);
+		lock.unlock();
+		has_data.notify_one();
 		}
 
-	if ( messages[read_ptr].empty() )
-		return nullptr;
-
-	T data = messages[read_ptr].front();
-	messages[read_ptr].pop();
+	return was_empty;
+	}
 
-	read_ptr = (read_ptr + 1) % NUM_QUEUES;
-	++num_reads;
+template<typename T>
+inline T Queue<T>::Remove()
+	{
+	if ( read_pos == BLOCK_SIZE )
+		{
+		Block* next = read_block->next.load(std::memory_order_relaxed);
+		delete read_block;
+		read_block = next;
+		read_pos = 0;
+		}
 
+	T data = read_block->items[read_pos++];
 	return data;
 	}
 
 template<typename T>
-inline void Queue<T>::Put(T data)
+inline void Queue<T>::Wait()
 	{
-	auto lock = acquire_lock(mutex[write_ptr]);
+	auto lock = acquire_lock(mutex);
+	reader_waiting.store(true, std::memory_order_seq_cst);
 
-	int old_write_ptr = write_ptr;
+	// Check again, now that any writer will notice us waiting.
+	if ( ! Ready() )
+		has_data.wait_for(lock, std::chrono::seconds(5));
 
-	bool need_signal = messages[write_ptr].empty();
+	reader_waiting.store(false, std::memory_order_relaxed);
+	}
 
-	messages[write_ptr].push(data);
+template<typename T>
+inline T Queue<T>::Get()
+	{
+	if ( ! Ready() && ! ((reader && reader->Killed()) || (writer && writer->Killed())) )
+		Wait();
 
-	write_ptr = (write_ptr + 1) % NUM_QUEUES;
-	++num_writes;
+	if ( ! Ready() )
+		return nullptr;
 
-	if ( need_signal )
-		{
-		lock.unlock();
-		has_data[old_write_ptr].notify_one();
-		}
-	}
+	T data = Remove();
+	num_reads.store(num_reads.load(std::memory_order_relaxed) + 1,
+	                std::memory_order_seq_cst);
 
+	return data;
+	}
 
 template<typename T>
-inline bool Queue<T>::Ready()
+inline size_t Queue<T>::GetMany(std::vector<T>* out, size_t max)
 	{
-	auto lock = acquire_lock(mutex[read_ptr]);
+	uint64_t reads = num_reads.load(std::memory_order_relaxed);
+	uint64_t n = num_writes.load(std::memory_order_acquire) - reads;
+
+	if ( n > max )
+		n = max;
 
-	bool ret = (messages[read_ptr].size());
+	for ( uint64_t i = 0; i < n; ++i )
+		out->push_back(Remove());
 
-	return ret;
+	if ( n )
+		num_reads.store(reads + n, std::memory_order_seq_cst);
+
+	return n;
 	}
 
 template<typename T>
-inline std::vector<std::unique_lock<std::mutex>> Queue<T>::LocksForAllQueues()
+inline bool Queue<T>::Put(T data)
 	{
-	std::vector<std::unique_lock<std::mutex>> locks;
+	Append(data);
+	return Publish();
+	}
 
-	try
-		{
-		for ( int i = 0; i < NUM_QUEUES; i++ )
-			locks.emplace_back(std::unique_lock<std::mutex>(mutex[i]));
-		}
+template<typename T>
+inline bool Queue<T>::PutMany(const std::vector<T>& data)
+	{
+	if ( data.empty() )
+		return false;
 
-	catch ( const std::system_error& e )
-		{
-		reporter->FatalErrorWithCore("cannot lock all mutexes: %s", e.what());
-		// Never gets here.
-		throw std::exception();
-		}
+	for ( const auto& d : data )
+		Append(d);
 
-	return locks;
+	return Publish();
 	}
 
 template<typename T>
-inline uint64_t Queue<T>::Size()
+inline bool Queue<T>::Ready()
 	{
-	// Need to lock all queues.
-	auto locks = LocksForAllQueues();
-
-	uint64_t size = 0;
-
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		size += messages[i].size();
+	return num_reads.load(std::memory_order_relaxed) !=
+	       num_writes.load(std::memory_order_seq_cst);
+	}
 
-	return size;
+template<typename T>
+inline uint64_t Queue<T>::Size()
+	{
+	// Read num_reads first so that we never underflow.
+	uint64_t reads = num_reads.load(std::memory_order_acquire);
+	return num_writes.load(std::memory_order_acquire) - reads;
 	}
 
 template<typename T>
 inline void Queue<T>::GetStats(Stats* stats)
 	{
-	// To be safe, we look all queues. That's probably unneccessary, but
-	// doesn't really hurt.
-	auto locks = LocksForAllQueues();
-
-	stats->num_reads = num_reads;
-	stats->num_writes = num_writes;
+	stats->num_reads = num_reads.load(std::memory_order_relaxed);
+	stats->num_writes = num_writes.load(std::memory_order_relaxed);
 	}
 
 template<typename T>
 inline void Queue<T>::WakeUp()
 	{
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		{
-		auto lock = acquire_lock(mutex[i]);
-		has_data[i].notify_all();
-		}
+	auto lock = acquire_lock(mutex);
+	has_data.notify_all();
 	}
 
 }